@@ -0,0 +1,125 @@
+ /*
+    Copyright (C) 2011  Andrew Richards
+
+    Part of home automation suite
+
+    Contains HA_arena methods
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HA_arena.h"
+
+#if defined(__AVR__)
+extern char *__brkval;																// avr-libc malloc - top of the heap, 0 until first used
+#endif
+
+
+HA_arena::HA_arena() {
+	_top = 0;
+	_highWater = 0;
+	_refused = 0;
+	_heapSize = 0;
+	_sealed = false;
+}
+
+void *HA_arena::alloc(unsigned int size) {
+	unsigned int start = (_top + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	if (_sealed) {
+		Serial.print("arena: sealed ");
+		Serial.println(size);
+		_refused += size;
+		return NULL;
+	}
+	if (size > HA_ARENA_SIZE || start > HA_ARENA_SIZE - size) {
+		Serial.print("arena: full ");
+		Serial.println(size);
+		_refused += size;
+		return NULL;
+	}
+
+	_top = start + size;
+	if (_top > _highWater) _highWater = _top;
+	memset(_block + start, 0, size);							// Space may have been given back by release()
+	return _block + start;
+}
+
+unsigned int HA_arena::mark() {
+	return _top;
+}
+
+void HA_arena::release(unsigned int mark) {
+	if (!_sealed && mark < _top) _top = mark;
+}
+
+void HA_arena::seal() {
+	_sealed = true;
+#if defined(__AVR__)
+	// Freeze the heap HA_HEAP_RESERVE above its current top.  malloc can still hand out blocks on its free list and from
+	// the reserve, but growing past that would mean __brkval reaching __malloc_heap_end, so it returns NULL
+	char *top = (__brkval != NULL) ? __brkval : __malloc_heap_start;
+	_heapSize = top - __malloc_heap_start;
+	__malloc_heap_end = top + HA_HEAP_RESERVE;
+#endif
+}
+
+boolean HA_arena::sealed() {
+	return _sealed;
+}
+
+unsigned int HA_arena::size() {
+	return HA_ARENA_SIZE;
+}
+
+unsigned int HA_arena::used() {
+	return _top;
+}
+
+unsigned int HA_arena::highWater() {
+	return _highWater;
+}
+
+unsigned int HA_arena::refused() {
+	return _refused;
+}
+
+void HA_arena::refuse(unsigned int size) {
+	Serial.print("heap: sealed ");
+	Serial.println(size);
+	_refused += size;
+}
+
+boolean HA_arena::heapShort(unsigned int size) {
+	void *probe = malloc(size);
+
+	if (probe) {
+		free(probe);
+		return false;
+	}
+	refuse(size);
+	return true;
+}
+
+unsigned int HA_arena::heapSize() {
+	return _heapSize;
+}
+
+void HA_arena::report(char *buffer, int maxLen) {
+	snprintf(buffer, maxLen, "arena used=%u high=%u of %u refused=%u%s heap=%u",
+		_top, _highWater, HA_ARENA_SIZE, _refused, _sealed ? " sealed" : "", _heapSize);
+}
+
+
+HA_arena arena;
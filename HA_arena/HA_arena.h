@@ -0,0 +1,90 @@
+ /*
+    Copyright (C) 2011  Andrew Richards
+
+    Part of home automation suite
+
+    Contains the HA_arena class - one static block from which all configuration-time structures are allocated
+
+    Entity, evaluation, arg list and channel arrays, RFID buffers, long arg lists and channel alert structures are
+    all sized once in setup() and live for ever.  Taking each from malloc scattered them through the heap, leaving
+    holes that the web server and syslog later fell into.  Instead they are carved in turn from one block of
+    HA_ARENA_SIZE bytes (per controller, HA_globals.h), which sits in .bss so the heap starts clean above it.
+
+    - alloc() returns zeroed space, or NULL (with a message) if the block is full or sealed
+    - mark() and release() let a creator give back what it took if a later step fails.  There is no other free
+    - seal() at the end of setup() - any later allocation is refused and reported, so nothing sneaks in at run time.
+    On the AVR the heap is frozen at the same moment, HA_HEAP_RESERVE bytes above its top: malloc (and so new, String
+    and BITSTRING::create) can still reuse blocks already freed and take from the reserve, but can grow no further
+    towards the stack, so it returns NULL instead.  The reserve is for SD, whose File mallocs an SdFile on every open
+    (SD_FILE_HEAP) - HA_web::serveFile and HA_image::saveSD open files at run time.  HA callers that get NULL after
+    seal() count it with refuse(), or heapShort() after a failed open; the heap size when sealed is in the report
+    - highWater() is the exact peak; refused() is what did not fit, so HA_ARENA_SIZE can be set from the report
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HA_arena_h
+#define HA_arena_h
+
+#include "HA_globals.h"
+
+#ifndef HA_ARENA_SIZE
+#define HA_ARENA_SIZE 1536
+#endif
+
+#ifndef HA_HEAP_RESERVE
+#define HA_HEAP_RESERVE 96											// Left above the heap by seal() - two open files, and slack
+#endif
+
+const static byte SD_FILE_HEAP = 31;								// SD's File mallocs an SdFile, with malloc's header, per open file
+
+#if defined(__AVR__)
+#define ARENA_ALIGN 1													// No alignment needed on the AVR, so none wasted
+#else
+#define ARENA_ALIGN sizeof(void*)							// Host builds
+#endif
+
+class HA_arena {
+	public:
+		HA_arena();
+
+		void *alloc(unsigned int size);					// Zeroed space, or NULL if full or sealed
+		unsigned int mark();										// Current top, for release()
+		void release(unsigned int mark);				// Give back everything allocated since mark
+
+		void seal();														// End of setup() - refuse all further allocation, and (AVR) heap growth past the reserve
+		boolean sealed();
+
+		unsigned int size();
+		unsigned int used();
+		unsigned int highWater();								// Peak of used(), release() notwithstanding
+		unsigned int refused();									// Bytes asked for that did not fit, here or from a sealed heap
+		void refuse(unsigned int size);					// Count a malloc that returned NULL after seal()
+		boolean heapShort(unsigned int size);		// After a failed open - true, and refused, if malloc can't give size now
+		unsigned int heapSize();								// Heap in use when sealed - 0 before, and on host builds
+
+		void report(char *buffer, int maxLen);
+
+	private:
+		byte _block[HA_ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+		unsigned int _top;
+		unsigned int _highWater;
+		unsigned int _refused;
+		unsigned int _heapSize;
+		boolean _sealed;
+};
+
+extern HA_arena arena;
+
+#endif
@@ -22,6 +22,7 @@
 #include "Arduino.h"
 #include "HA_channels.h"
 #include "HA_root.h"
+#include "HA_arena.h"
 #include "HA_switcher.h"
 #include "SPI.h"
 
@@ -76,11 +77,15 @@ boolean HA_channel::initChanAccess(byte accessType, byte latchPin, byte dataPin,
 		  return true;
 		case CHAN_ACCESS_POWER:	
 			// Get some space for bitstring control structures
-			pinStates = (BITSTRING*)malloc(sizeof(BITSTRING));				
+			pinStates = (BITSTRING*)arena.alloc(sizeof(BITSTRING));				
 			if (pinStates == NULL) return false;
 			
 			// Set up bitstring to hold pin states - round up to a whole shift register
-			pinStates->create(((_maxPin / 8) + 1) * 8);
+			{
+				byte *pinBuf = (byte*)arena.alloc((_maxPin / 8) + 1);
+				if (pinBuf == NULL) return false;
+				pinStates->init(pinBuf, ((_maxPin / 8) + 1) * 8);
+			}
 			pinStates->clearAll();
 			
 			_numShifts = (_maxPin / 8) + 1;															// Each SR has 8 pins
@@ -99,7 +104,7 @@ boolean HA_channel::initChanAlert(byte alertType, byte chanNum, byte intNum, byt
 	_chanType |= alertType;
 	
 	if (get(VAL_CHAN_ALERT) == CHAN_ALERT_INT) {
-		chan_alert_int = (structINT*)malloc(sizeof(structINT));			// Get some space for data needed to call the appropriate device			
+		chan_alert_int = (structINT*)arena.alloc(sizeof(structINT));			// Get some space for data needed to call the appropriate device			
 		if (chan_alert_int == NULL) return false;										// If no space then quit
 
 		// Establish this channel as the one to invoke on interrupt intNum and attach the relevant ISR
@@ -121,7 +126,7 @@ boolean HA_channel::initChanAlert(byte alertType, byte chanNum, byte intNum, byt
 	_chanType |= alertType;
 	
 	if (get(VAL_CHAN_ALERT) == CHAN_ALERT_SINT) {										// Up to 16 interrupts from single MCP23s17
-		chan_alert_sint = (structSINT*)malloc(sizeof(structSINT));	// Get some space for data needed to interface to the MCP23S17 and to call the appropriate device(s)			
+		chan_alert_sint = (structSINT*)arena.alloc(sizeof(structSINT));	// Get some space for data needed to interface to the MCP23S17 and to call the appropriate device(s)			
 		if (chan_alert_sint == NULL) return false;									// If no space then quit		
 		
 		// Clear the interrupt ranges for this channel
@@ -168,7 +173,7 @@ boolean HA_channel::initChanAlert(byte alertType, byte chanNum, byte intNum, byt
 	_chanType |= alertType;
 	
 	if (get(VAL_CHAN_ALERT) == CHAN_ALERT_MINT) {									// Up to 256 interrupts from two level cascade of MCP23s17s
-		chan_alert_mint = (structMINT*)malloc(sizeof(structMINT));	// Get some space for data needed to interface to the MCP23S17 and to call the appropriate device(s)			
+		chan_alert_mint = (structMINT*)arena.alloc(sizeof(structMINT));	// Get some space for data needed to interface to the MCP23S17 and to call the appropriate device(s)			
 		if (chan_alert_mint == NULL) return false;									// If no space then quit			
 		
 		// Clear the interrupt ranges for this channel
@@ -486,7 +491,7 @@ void HA_channel::chanISR() {								// Called by ISRn in receipt of physical int
 	}
 }
 
-void HA_channel::chanDaemon(byte dummy) {							// Woken every 100ms as a normal interruptable process to complete the work of chanISR
+void HA_channel::chanDaemon(unsigned int dummy) {							// Woken every 100ms as a normal interruptable process to complete the work of chanISR
 	unsigned int alertingPin;
 	
 	switch (get(VAL_CHAN_ALERT)) {
@@ -528,17 +533,18 @@ void HA_channel::chanDaemon(byte dummy) {							// Woken every 100ms as a normal
 
 void HA_channel::startDaemon() {					// Setup chanDaemon to run in the background to follow-through on chanISR
 	int contextNum;
+	wakeHandle daemon;
 
 	// Set 'this' as the object instance and chanDaemon as the member function to be put on queue
-	HA_channelMemPtr fPtr = &HA_channel::chanDaemon;
-	if ((contextNum = saveContext(this, fPtr, NULL, REPEATED)) < 0) {
+	if ((contextNum = saveContext(this, MEMBER_THUNK(HA_channel, chanDaemon))) < 0) {
 	 	Serial.println("out of stack - chan");
 	 	return;
  	}
  	
-	if (!wakeup.wakeMeAfter(switcherChan, DAEMON_FREQUENCY, (void*)contextNum, TREAT_AS_NORMAL | REPEAT_COUNT)) { 			// Add to queue for activation every 100ms, outside ISR
+	if ((daemon = wakeContextAfter(contextNum, DAEMON_FREQUENCY, TREAT_AS_NORMAL | REPEAT_COUNT, DAEMON_SLACK)) == NO_WAKEUP) { 			// Add to queue for activation every 100ms, outside ISR
 		Serial.println("Queue full");
 	}
+	else wakeup.setPriority(daemon, PRIORITY_HIGH);			// Interrupt follow-through goes ahead of web and serial work
 }
 
 void HA_channel::invokeDevInt(byte alertingPin) {					// Work out which device to interrupt, based on alerting pin, and then raise an interrupt
@@ -582,45 +588,6 @@ void HA_channel::invokeDevInt(byte alertingPin) {					// Work out which device t
 
 // ************ Non-class methods **************
 
-// ***********  Switcher support  *************
-
-int saveContext(HA_channel *objPtr, HA_channelMemPtr fPtr, byte arg, byte repeated) {	
-	noInterrupts();	
-	
-	// If space, then find slot
-	if (_numContexts < MAXSLEEPERS) {
-		int i = 0;
-		while (i < MAXSLEEPERS && wakeupContext[i].objType != DEV_TYPE_NULL) i++;
-
-		if (i < MAXSLEEPERS) {
-			_numContexts++;
-			wakeupContext[i].objType = OBJ_TYPE_CHANNEL;
-			wakeupContext[i].HA_channel.objPtr = objPtr;
-			wakeupContext[i].HA_channel.fPtr = fPtr;
-			wakeupContext[i].arg = (arg & 0x7F) | repeated;
-		}
-		
-		interrupts();
-
-		return i;
-	}
-	else {
-		interrupts();
-		return -1;
-	}
-}
-
-void switcherChan(void* context) {
-	byte contextNum = (unsigned int)context & 0x00ff;
-	byte arg = wakeupContext[contextNum].arg & 0x7f;
-	byte repeated = wakeupContext[contextNum].arg >> 7;
-	byte objType = wakeupContext[contextNum].objType;
-	
-	if (!repeated) freeContext(contextNum);
-		
-  callMem(*(wakeupContext[contextNum].HA_channel.objPtr), wakeupContext[contextNum].HA_channel.fPtr)(arg);
-}
-
 // ************ Interrupt registration and ISRs ***********************
 
 void registerChanISR(byte intNum, byte chanNum, byte intMode) {
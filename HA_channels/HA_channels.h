@@ -425,6 +425,7 @@ static const byte SPI_MOSI             	= 51; 				//arduino   <->   SPI Master O
 static const byte SPI_CLOCK            	= 52; 				//arduino   <->   SPI Slave Clock Input     -> SCK (Pin 12 on MCP23S17 DIP) 
 
 static const int DAEMON_FREQUENCY				= 100;				// Wakeup every 100ms to check if any interrupts received
+static const int DAEMON_SLACK						= 20;					// ms chanDaemon can be late by, to share a timerISR with other sleepers
 	
 static const byte NUM_INTERRUPT_RANGES_SINT	= 4;			// Number of segments into which single interrupt channel can be divided
 static const byte NUM_INTERRUPT_RANGES_MINT	= 4;			// Number of segments into which multi-interrupt channel can be divided
@@ -451,7 +452,7 @@ class HA_channel {
 		boolean intEnable(byte intPin);
 		boolean intMode(byte intPin, byte mode);
 		void chanISR();
-		void chanDaemon(byte arg);
+		void chanDaemon(unsigned int arg);
 	
 		boolean lock();
 		boolean unlock();	
@@ -515,7 +516,7 @@ class HA_channel {
 			volatile unsigned int flagBits[NUM_MINT_SLAVES];		// Holds 16 bits corresponding to the interrupt status (1 = interrupt) of each of the lines on each slave
 		};
 		
-		union {											// Ptr to malloced data appropriate to channel alert type (if interrupt driven)
+		union {											// Ptr to data (from the arena) appropriate to channel alert type (if interrupt driven)
 			structINT *chan_alert_int;
 			structSINT *chan_alert_sint;
 			structMINT *chan_alert_mint;
@@ -530,9 +531,7 @@ class HA_channel {
 };
 
 
-typedef void (HA_channel::*HA_channelMemPtr)(byte);
-int saveContext(HA_channel *object, HA_channelMemPtr fPtr, byte arg = 0, byte repeated = 0);
-void switcherChan(void *context);
+typedef void (HA_channel::*HA_channelMemPtr)(unsigned int);
 
 // *********** Interrupt handling methods ******************
 
@@ -126,7 +126,6 @@ void HA_devHeat::readDev() {
 	int contextNum;
 	unsigned int tConv;  
 	HA_channel *chanPtr = root.getChanObj(channel);		
-	HA_devHeatMemPtr fPtr = &HA_devHeat::getReading;					
 	
 	if (status != STATUS_READY && status != STATUS_STABLE) {Serial.println("Bad status1"); return;}
 	
@@ -158,13 +157,13 @@ void HA_devHeat::readDev() {
 			// Go to sleep whilst temp conversion takes place
 	
 		  // Set 'this' as the object instance and getReading as the member function 
-			if ((contextNum = saveContext(this, fPtr)) < 0) {
+			if ((contextNum = saveContext(this, MEMBER_THUNK(HA_devHeat, getReading))) < 0) {
 			 	Serial.println("out of stack");
 			  put(VAL_STATUS, STATUS_UNAVAILABLE);
 			 	return;
 		 	}
 		 	
-	  	if (wakeup.wakeMeAfter(switcher, tConv, (void*)contextNum, TREAT_AS_NORMAL)) {  	// Queue wakeup call
+	  	if (wakeContextAfter(contextNum, tConv, TREAT_AS_NORMAL) != NO_WAKEUP) {  	// Queue wakeup call.  Context freed once getReading has run
 	  		put(VAL_STATUS, STATUS_PENDING);																						// Success; set flag to indicate waiting
   		}
   		else {
@@ -179,7 +178,7 @@ void HA_devHeat::readDev() {
 
 // ******** Follow-up complement to readDev - woken after a sleep while Dallas device converts temp
 
-void HA_devHeat::getReading(byte arg) {
+void HA_devHeat::getReading(unsigned int arg) {
 	byte pin = get(VAL_PIN);
 	byte channel = get(VAL_CHANNEL);
 	HA_channel *chanPtr = root.getChanObj(channel);
@@ -46,7 +46,7 @@ class HA_devHeat : public HA_dev2Byte {
 		void initDev(byte devNum, byte channel, byte pin = 0, byte handler = 0);
 		void resetDev();
 		void readDev();
-		void getReading(byte arg);
+		void getReading(unsigned int arg);
 		
 	private:
 		
@@ -102,7 +102,7 @@ class HA_devHeat : public HA_dev2Byte {
 		byte _buffer[9];			// Buffer used for both address and data to save space
 };
 
-typedef void (HA_devHeat::*HA_devHeatMemPtr)(byte arg);
+typedef void (HA_devHeat::*HA_devHeatMemPtr)(unsigned int arg);
 
 
 
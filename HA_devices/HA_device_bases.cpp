@@ -28,6 +28,7 @@
 #include "HA_device_bases.h"
 #include "HA_channels.h"
 #include "HA_root.h"
+#include "HA_arena.h"
 #include "HA_syslog.h"
 
 /*
@@ -54,6 +55,10 @@ void HA_device::put(byte type, unsigned int value) {
 	  _devNum = value;
 	  return;
   }
+  if (type == VAL_DEVTYPE) {
+	  _devType = value;
+	  return;
+  }
   
   switch (type) {
     case VAL_REGION:     		mask = MASK_REGION; offset = OFFSET_REGION; value = strchr(REGIONCODES, (char)value) - REGIONCODES; break;   
@@ -78,6 +83,13 @@ unsigned int HA_device::get(byte type) {
   byte offset;
   
 	if (type == VAL_DEVIDX) return _devNum;
+	if (type == VAL_DEVTYPE) return _devType;
+#ifdef HA_COLUMNS
+	if (type == VAL_STATE && root.colKind(_devType) == COL_BIT) {			// On/off state is in the columns, not the map
+		byte bit = _BV(_devNum & 7);
+		return ((root.currBits(_devType)[_devNum >> 3] & bit) ? 2 : 0) | ((root.prevBits(_devType)[_devNum >> 3] & bit) ? 1 : 0);
+	}
+#endif
   
   switch (type) {
     case VAL_REGION:     		return REGIONCODES[(_deviceMap[deviceMapIdx] & MASK_REGION) >> OFFSET_REGION]; break;
@@ -154,7 +166,7 @@ void HA_device::getRef(char *device, byte devType) { // Convert bitstring device
   device[5] = '.';
   
   // Get device type
-  strcpy(device + 6, DEVICETYPES[devType]);
+  getDevTypeChar(devType, device + 6);
   
   // Add device number if needed (if zero then don't use, unless xO)
   byte devNum = get(VAL_DEVNUM);
@@ -222,6 +234,15 @@ void HA_devBit::put(byte valType, unsigned int val) {
 			char oldSREG = SREG;                               
 		  cli();                                    // Disable interrupts whilst accessing map
 		    
+#ifdef HA_COLUMNS
+			byte *curr = root.currBits(_devType) + (_devNum >> 3), *prev = root.prevBits(_devType) + (_devNum >> 3);
+			byte bit = _BV(_devNum & 7);
+			
+			if (((*curr & bit) != 0) != (val & 1)) root.markDirty(_devType, _devNum);
+			*prev = (*curr & bit) ? *prev | bit : *prev & ~bit;		// Move current to previous
+			*curr = (val & 1) ? *curr | bit : *curr & ~bit;				// Load latest to current
+#else
+		  if (get(VAL_CURR) != (val & 1)) root.markDirty(_devType, _devNum);
 		  unsigned int temp = HA_device::get(VAL_STATE);
 			
 			temp &= ~(MASK_CURR | MASK_PREV);						// Clear the current and previous state fields
@@ -230,7 +251,7 @@ void HA_devBit::put(byte valType, unsigned int val) {
 			temp |= MASK_CURR & (val << OFFSET_CURR);		// Load latest to current
 			
 			HA_device::put(VAL_STATE, temp);											// Update
-			
+#endif
 			
 			SREG = oldSREG;														// Restore status register
 			break;
@@ -241,8 +262,13 @@ void HA_devBit::put(byte valType, unsigned int val) {
 
 unsigned int HA_devBit::get(byte valType) {
 	switch (valType) {
+#ifdef HA_COLUMNS
+		case VAL_CURR:		return (root.currBits(_devType)[_devNum >> 3] >> (_devNum & 7)) & 1;
+		case VAL_PREV:		return (root.prevBits(_devType)[_devNum >> 3] >> (_devNum & 7)) & 1;
+#else
 		case VAL_CURR:		return (HA_device::get(VAL_STATE) & MASK_CURR) >> OFFSET_CURR;
 		case VAL_PREV:		return (HA_device::get(VAL_STATE) & MASK_PREV) >> OFFSET_PREV; 
+#endif
 		default:					return HA_device::get(valType); 
 	}
 }
@@ -289,8 +315,17 @@ void HA_dev2Byte::put(byte valType, unsigned int val) {
 			char oldSREG = SREG;                               
 		  cli();                                    // Disable interrupts whilst accessing map
 		    
+#ifdef HA_COLUMNS
+			unsigned int *curr = root.currWords(_devType) + _devNum;
+			
+			if (*curr != val) root.markDirty(_devType, _devNum);
+			root.prevWords(_devType)[_devNum] = *curr;	// Move current to previous
+			*curr = val;																// Load latest to current
+#else
+			if (_readingCurrent != val) root.markDirty(_devType, _devNum);
 		  _readingPrevious = _readingCurrent;				// Move current to previous
 			_readingCurrent = val;										// Load latest to current
+#endif
 			
 			SREG = oldSREG;														// Restore status register
 			break;
@@ -301,8 +336,13 @@ void HA_dev2Byte::put(byte valType, unsigned int val) {
 
 unsigned int HA_dev2Byte::get(byte valType) {
 	switch (valType) {
+#ifdef HA_COLUMNS
+		case VAL_CURR:			return root.currWords(_devType)[_devNum]; break;
+		case VAL_PREV:			return root.prevWords(_devType)[_devNum]; break;
+#else
 		case VAL_CURR:			return _readingCurrent; break;
 		case VAL_PREV:			return _readingPrevious; break;
+#endif
 		default:						return HA_device::get(valType); 
 	}
 }
@@ -340,6 +380,7 @@ boolean HA_devMultiByte::create(byte bufLen) {		// Finds space for buffer and th
 		return true;
 	}
 	else {
+		if (arena.sealed()) arena.refuse(bufLen * 2);		// Heap frozen by seal()
 		_bufLen = 0; 
 		return false;
 	}
@@ -374,6 +415,8 @@ void HA_devMultiByte::put(byte valType, byte *valBuf) {   // <<<<<<<<<<<<<< Chan
 			char oldSREG = SREG;                               
 		  cli();
 		  
+		  if (memcmp(_bufCurr, valBuf, _bufLen) != 0) root.markDirty(_devType, _devNum);
+		  
 		  // Swap pointers to move curr to prev, and then fill curr with new valBufue
 		  byte *temp = _bufPrev;
 		  _bufPrev = _bufCurr;
@@ -484,8 +527,7 @@ void HA_sensAnalog::put(byte valType, unsigned int val, byte devType) {
 	switch (valType) {
 		case VAL_ON_EVENT: 	_onEvent = val; break;
 		case VAL_PUSH:
-			HA_dev2Byte::put(valType, val);
-			if (get(VAL_CURR) != get(VAL_PREV)) changeList.put(devType, HA_device::get(VAL_DEVIDX), val);
+			HA_dev2Byte::put(valType, val);				// Marks the change for HA_root's change views
 			break;
 		default:						HA_dev2Byte::put(valType, val);
 	}
@@ -62,6 +62,12 @@ const static byte VAL_LUMINANCE = 0x80 | 2;
 const static byte VAL_CONTEXT = 0x90 | 2;
 
 const static byte VAL_DEVIDX = 0xA0;
+const static byte VAL_DEVTYPE = 0xB0;									// Set by HA_root
+
+// Column layout of readings, by class (see HA_COLUMNS)
+const static byte COL_NONE = 0;												// Held in the object, or no readings
+const static byte COL_BIT = 1;												// Packed bits, 8 devices per byte
+const static byte COL_WORD = 2;												// unsigned int per device
 
 /*
 // **************** Device types *********************
@@ -104,10 +110,13 @@ class HA_device {				// Base class for all devices
 		byte putRef(char *device);
 		void getRef(char *device, byte devType);
 		void getSnapshot(byte devType);
+		
+		const static byte COLUMN = COL_NONE;
 	
 	protected:
 		volatile unsigned int _deviceMap[2];  		// Holds basic identity and status information	
 		byte _devNum;															// Index number
+		byte _devType;														// For HA_root - reading columns and change tracking
 		
 		// Layout of _deviceMap 
 		// 
@@ -153,6 +162,8 @@ class HA_devBit : public HA_device {						// Generic class for on/off devices.
 	  
 		void readDev();
 		void setDev(byte val);
+		
+		const static byte COLUMN = COL_BIT;
 	  
 	protected:
 		const static unsigned int MASK_CURR = B10;
@@ -174,9 +185,13 @@ class HA_dev2Byte : public HA_device {						// Generic class for sensors with re
 	  void put(byte valType, void *valPtr);
 	  void get(byte valType, void *valPtr);
 	  
+		const static byte COLUMN = COL_WORD;
+	  
+#ifndef HA_COLUMNS
 	protected:
 		unsigned int _readingCurrent;
 		unsigned int _readingPrevious;
+#endif
 		
 };
 
@@ -20,6 +20,7 @@
 */
 
 #include "HA_evaluations.h"
+#include "HA_arena.h"
 //#include "Time.h"
 
 
@@ -103,14 +104,13 @@ HA_argList::HA_argList (byte numArgs) {
 	create(numArgs);
 }
 
-HA_argList::~HA_argList () {
-	free(argPtr.argList);
+HA_argList::~HA_argList () {				// List space is in the arena, which is never freed
 }
 
-boolean HA_argList::create(byte numArgs) {			// To be called directly if constructor not called (if malloc'ed)
+boolean HA_argList::create(byte numArgs) {			// To be called directly if constructor not called (if in an array from the arena)
 	byte *addr;	
 
-	if (numArgs > 3) addr = (byte*)malloc(numArgs);			// Get some space
+	if (numArgs > 3) addr = (byte*)arena.alloc(numArgs);	// Get some space
 	else addr = _argElem;																// Unless small enough to be held locally
 	
 	if (addr != NULL) {
@@ -142,3 +142,7 @@ void HA_argList::put(byte argNum, byte argVal) {
 byte HA_argList::get(byte argNum) { 
 	if (argNum < _numArgs) return (_numArgs > 3) ? argPtr.argList[argNum] : _argElem[argNum];
 }
+
+byte *HA_argList::args() {
+	return (_numArgs > 3) ? argPtr.argList : _argElem;
+}
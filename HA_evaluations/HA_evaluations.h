@@ -162,7 +162,7 @@ class HA_evaluation {
 // ****************** HA_arglist ********************
 // Instantiated as an array in dynamic memory pointed to by root.ptrArgList
 // Contains a list of arguments comprising either indexes into the HA_entities array or indexes into the HA_evaluation array
-// Arg list is normally allocated dynamically (unless 3 or fewer args when held locally)
+// Arg list is normally allocated from the arena (unless 3 or fewer args when held locally)
 
 class HA_argList {
 	public:
@@ -174,6 +174,7 @@ class HA_argList {
 		byte numArgs();
 		void put(byte argNum, byte argVal);
 		byte get(byte argNum);
+		byte *args();					// All args, for scanning
 		
 	protected:
 		byte _numArgs;				// Max 256
@@ -21,6 +21,7 @@
 
 
 #include "HA_globals.h"
+#include <avr/pgmspace.h>
 
 
 // *************** IP and other comms addresses - variables here, statics in HA_globals.h *************
@@ -64,23 +65,41 @@ void stolower(char *s) {
 // ************  Device type codes & methods  *********
 /*
 const char REGIONCODES[NUMREGIONCODES + 1] = { 'G', 'D', 'S', 'E', 'K', 'B', '/0' };          // Gt Hall, Dining, Study, External, Kitchen, Basement, null termination
-const char *DEVICETYPES[NUM_DEV_TYPES + NUM_VAR_TYPES + NUM_ZONE_TYPES + NUM_OBJ_TYPES] = { "xT", "xF", "xH", "xL", "xM", "xP", "xR", "xO", "p", "P", "D", "L", "R", "vB", "vI", "vR", "Z", "Ti", "HB" };  
+*/
+const char DEVICETYPES[NUM_TYPE_CODES][TYPE_CODE_LEN] PROGMEM = { "xT", "xF", "xH", "xL", "xM", "xP", "xR", "xO", "p", "P", "D", "L", "R", "vB", "vI", "vR", "Z", "Ti", "HB" };  
 								// Sensors:  Touch, fire, heat, luminance, motion, presence, RFID, open
 								// Actors: 5a power, 13A power, lock (was 'B'), light, relay
 
 
+// Device type from the code at the start of device - a trie on the first two chars, unrolled into switches, so no strings are
+// compared.  Unknown codes give 0, as the scan of DEVICETYPES it replaces did
 
 byte getDevTypeIdx (char *device) {
-	  for (int i = 0; i < NUM_DEV_TYPES; i++) {
-      if (strncmp(device, DEVICETYPES[i], strlen(DEVICETYPES[i])) == 0) return i;
-    }
-    return 0;
+	switch (device[0]) {
+		case 'x':
+			switch (device[1]) {
+				case 'T':		return DEV_TYPE_TOUCH;
+				case 'F':		return DEV_TYPE_FIRE;
+				case 'H':		return DEV_TYPE_HEAT;
+				case 'L':		return DEV_TYPE_LUMINANCE;
+				case 'M':		return DEV_TYPE_MOTION;
+				case 'P':		return DEV_TYPE_PRESENCE;
+				case 'R':		return DEV_TYPE_RFID;
+				case 'O':		return DEV_TYPE_OPEN;
+			}
+			break;
+		case 'p':				return DEV_TYPE_5APWR;
+		case 'P':				return DEV_TYPE_13APWR;
+		case 'D':				return DEV_TYPE_LOCK;
+		case 'L':				return DEV_TYPE_LIGHT;
+		case 'R':				return DEV_TYPE_RELAY;
+	}
+	return 0;
 }
 
 void getDevTypeChar (byte entIdx, char *entChar) {			// Returns device type, var type or zone type char string
-	strncpy (entChar, DEVICETYPES[entIdx], 3);
+	strncpy_P (entChar, DEVICETYPES[entIdx], TYPE_CODE_LEN);
 }
-*/
 
 // *************** DayHourMinute routines - compressed form of time **************
 
@@ -131,41 +150,41 @@ void dhmToText(unsigned int dhm, char *responseText) {
 }
 
 boolean dhmBetween(unsigned int dhmVal, unsigned int dhmFrom, unsigned int dhmTo) {
-  unsigned int dhmFDay = dhmGet(dhmFrom, VAL_DAY), dhmTDay = dhmGet(dhmTo, VAL_DAY);
-  boolean nextWeek = false;
- 
-  switch (dhmFDay) {			// NB default case results in a return 
-    case 0:      dhmFDay = 1; dhmTDay = 7; break;        			// Daily
-    case 8:      dhmFDay = 2; dhmTDay = 5; break;        			// Mon-Thu
-    case 9:      dhmFDay = 2; dhmTDay = 6; break;        			// Mon-Fri
-    case 10:     dhmFDay = 7; dhmTDay = 1; nextWeek = true; break;        			// Weekend 
-    default:		 																							// Specific times & days - just need to take account of potential change of week
-    	nextWeek = (dhmTDay < dhmFDay);
-    	return (nextWeek) ? (dhmVal >= dhmFrom) || (dhmVal <= dhmTo) : (dhmVal >= dhmFrom) && (dhmVal <= dhmTo);
-  }
+	dhmSchedule schedule;
+	
+	dhmCompile(dhmFrom, dhmTo, &schedule);
+	return dhmInSchedule(dhmVal, &schedule);
+}
 
-  // Only here if range of days to be tested - cycle through same times each day
-  for (int i = dhmFDay; i <= ((nextWeek) ? 7 : dhmTDay); i++) {
-    dhmPut(&dhmFrom, VAL_DAY, i);
-    dhmPut(&dhmTo, VAL_DAY, i);
-    
-    // Test if time now is between the times stated; if so break out of loop
-    if (dhmVal >= dhmFrom && dhmVal <= dhmTo) return true;
+void dhmCompile(unsigned int dhmFrom, unsigned int dhmTo, dhmSchedule *schedule) {
+  switch (dhmGet(dhmFrom, VAL_DAY)) {
+    case 0:      schedule->days = B11111110; break;        			// Daily
+    case 8:      schedule->days = B00111100; break;        			// Mon-Thu
+    case 9:      schedule->days = B01111100; break;        			// Mon-Fri
+    case 10:     schedule->days = B10000010; break;        			// Weekend
+    default:     schedule->days = 0;													// Specific times & days - one span, perhaps into next week
   }
   
-  // Second loop needed if end date is next week
-  if (nextWeek) {
-  	for (int i = 1; i <= dhmTDay; i++) {
-    	dhmPut(&dhmFrom, VAL_DAY, i);
-    	dhmPut(&dhmTo, VAL_DAY, i);
-    
-      // Test if time now is between the times stated; if so break out of loop
-      if (dhmVal >= dhmFrom && dhmVal <= dhmTo) return true;
-    }
+  if (schedule->days != 0) {														// Same times each day - the day of dhmTo is ignored
+  	schedule->from = dhmFrom & ~MASK_DAY;
+  	schedule->to = dhmTo & ~MASK_DAY;
+  	schedule->wraps = false;
   }
-  
-  // If get here then no match, so return
-  return false;
+  else {
+  	schedule->from = dhmFrom;
+  	schedule->to = dhmTo;
+  	schedule->wraps = (dhmGet(dhmTo, VAL_DAY) < dhmGet(dhmFrom, VAL_DAY));
+  }
+}
+
+boolean dhmInSchedule(unsigned int dhmVal, const dhmSchedule *schedule) {
+	if (schedule->days != 0) {
+		if (!(schedule->days & (1 << dhmGet(dhmVal, VAL_DAY)))) return false;
+		dhmVal &= ~MASK_DAY;
+		return (dhmVal >= schedule->from) && (dhmVal <= schedule->to);
+	}
+	
+	return (schedule->wraps) ? (dhmVal >= schedule->from) || (dhmVal <= schedule->to) : (dhmVal >= schedule->from) && (dhmVal <= schedule->to);
 }
 
 
@@ -27,15 +27,46 @@
 
 //#define DEBUG
 
+// Device readings held in columns - current and previous values of each device type in dense arrays in HA_root (bits for
+// on/off devices), so aggregates over arg lists scan them directly.  Comment out to keep readings in each device object
+#define HA_COLUMNS
 
+// WAKEUP telemetry - latency histogram and run time per normal sleeper, shown at /wakestats and sent to syslog.  About 400
+// bytes of SRAM and a micros() per wake, so only for a controller being tuned
+//#define WAKEUP_STATS
+
+
+// Per controller sizing.  WAKEUP_SLEEPERS is bunks in WAKEUP (one per temperature sensor thread, plus time, NTP, channel daemon,
+// heating and zone timers); WAKEUP_PENDING is the queue per priority for runAnyPending (power of 2); NUM_CONTEXTS is the
+// switcher table of member function callbacks.  HA_ARENA_SIZE is the one block that all configuration arrays (entities,
+// evaluations, arg lists, channels and their buffers) are carved from - see HA_arena.h.  SRAM actually used, and the
+// arena high-water mark, are shown at the top of /wakestats
 #if defined GREAT_HALL_CONTROLLER
 #define NUM_TEMP_SENSORS 1
+#define WAKEUP_SLEEPERS 8
+#define WAKEUP_PENDING 4
+#define NUM_CONTEXTS 6
+#define HA_ARENA_SIZE 1024
 #elif defined BOILER_CONTROLLER
 #define NUM_TEMP_SENSORS 6
+#define WAKEUP_SLEEPERS 16
+#define WAKEUP_PENDING 8
+#define NUM_CONTEXTS 10
+#define HA_ARENA_SIZE 1536
 #elif defined DINING_CONTROLLER
 #define NUM_TEMP_SENSORS 4
+#define WAKEUP_SLEEPERS 12
+#define WAKEUP_PENDING 8
+#define NUM_CONTEXTS 8
+#define HA_ARENA_SIZE 1280
 #else 
 #define NUM_TEMP_SENSORS 6
+#define WAKEUP_SLEEPERS 12
+#define WAKEUP_PENDING 8
+#define NUM_CONTEXTS 12
+#ifndef HA_ARENA_SIZE														// Host builds size their own
+#define HA_ARENA_SIZE 1536
+#endif
 #endif // GREAT_HALL
 
 
@@ -353,6 +384,11 @@ void stolower(char *s);
 
 // ************** Device methods ***************
 
+const static byte NUM_TYPE_CODES = NUM_DEV_TYPES + NUM_VAR_TYPES + NUM_ZONE_TYPES + NUM_OBJ_TYPES;
+const static byte TYPE_CODE_LEN = 3;					// Longest code, and its null
+
+extern const char DEVICETYPES[NUM_TYPE_CODES][TYPE_CODE_LEN] PROGMEM;		// Code for each entity type, as in references - "xH", "L", "vB"
+
 byte getDevTypeIdx (char *device);
 void getDevTypeChar (byte devIdx, char *devChar);
 
@@ -365,6 +401,20 @@ unsigned int dhmAccess(unsigned int *dhmVal, byte type, unsigned int value, int
 void dhmToText(unsigned int dhm, char *responseText);
 boolean dhmBetween(unsigned int dhmVal, unsigned int dhmFrom, unsigned int dhmTo);
 
+// A from/to pair as a schedule, worked out once by dhmCompile so that each dhmInSchedule test is a bit test and two
+// compares rather than a dhmPut per day.  Day ranges (every day, Mon-Thu, Mon-Fri, Sat/Sun) become a bit per day and
+// the window within each day; specific days are one span of the week, which may run on into the next
+
+struct dhmSchedule {
+	unsigned int from;																		// Day cleared, if days is set
+	unsigned int to;
+	byte days;																						// Bit n for day n (1 = Sun), or 0 for a span
+	boolean wraps;																				// Span runs into next week
+};
+
+void dhmCompile(unsigned int dhmFrom, unsigned int dhmTo, dhmSchedule *schedule);
+boolean dhmInSchedule(unsigned int dhmVal, const dhmSchedule *schedule);
+
 // ****** Error logging ******
 
 static const byte ERR_LIMIT = 16;
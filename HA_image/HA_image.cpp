@@ -0,0 +1,385 @@
+ /*
+    Copyright (C) 2011  Andrew Richards
+
+    Part of home automation suite
+
+    Contains HA_image and EEPROMStream methods
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HA_image.h"
+#include "HA_arena.h"
+
+static char IMAGE_FILES[2][11] = { "STATE0.IMG", "STATE1.IMG" };
+
+
+// ********************** EEPROMStream **********************
+
+EEPROMStream::EEPROMStream(int base, int end) {
+	_base = base;
+	_end = end;
+	_addr = base;
+	_written = 0;
+}
+
+size_t EEPROMStream::write(uint8_t val) {
+	if (_addr >= _end) return 0;
+
+	if (EEPROM.read(_addr) != val) {
+		EEPROM.write(_addr, val);
+		_written++;
+	}
+	_addr++;
+	return 1;
+}
+
+int EEPROMStream::available() {
+	return _end - _addr;
+}
+
+int EEPROMStream::read() {
+	return (_addr < _end) ? EEPROM.read(_addr++) : -1;
+}
+
+int EEPROMStream::peek() {
+	return (_addr < _end) ? EEPROM.read(_addr) : -1;
+}
+
+void EEPROMStream::flush() {
+}
+
+void EEPROMStream::rewind() {
+	_addr = _base;
+}
+
+unsigned int EEPROMStream::written() {
+	return _written;
+}
+
+
+// ********************** HA_image **********************
+
+HA_image::HA_image() {
+	_seq = 0;
+	_readSeq = 0;
+	_length = 0;
+	_eepromWritten = 0;
+	_sdNext = 0;
+}
+
+boolean HA_image::save(Print &out, unsigned long types) {
+	byte rec[IMAGE_MAX_REC];
+
+	clearDue();																							// Before writing, so changes made meanwhile are caught next time
+	_sum1 = _sum2 = 0;
+	_count = 0;
+	_failed = false;
+
+	put(out, 'H');
+	put(out, 'I');
+	put(out, IMAGE_VERSION);
+	put(out, NUM_ENT_TYPES);
+	_seq++;
+	for (byte i = 0; i < 4; i++) put(out, _seq >> (i * 8));
+
+	for (byte t = 0; t < NUM_ENT_TYPES; t++) {
+		byte entType = (OBJ_TYPE_ZONE + t) % NUM_ENT_TYPES;		// Zones first, so relays their on events set are then given their own readings
+		if (!(types & IMAGE_TYPE(entType)) || root.numEnts(entType) == 0) continue;
+
+		byte len = recLen(entType);
+		put(out, entType);
+		put(out, root.numEnts(entType));
+		put(out, len);
+		for (byte entNum = 0; entNum < root.numEnts(entType); entNum++) {
+			getRec(entType, entNum, rec);
+			for (byte i = 0; i < len; i++) put(out, rec[i]);
+		}
+	}
+
+	put(out, IMAGE_END);
+	byte sum1 = _sum1, sum2 = _sum2;
+	put(out, sum1);
+	put(out, sum2);
+	_length = _count;
+
+	return !_failed;
+}
+
+boolean HA_image::check(Stream &in) {
+	return scan(in, false);
+}
+
+boolean HA_image::restore(Stream &in) {
+	if (!scan(in, true)) return false;
+
+	_seq = _readSeq;
+	clearDue();																							// What was restored is what is saved
+	return true;
+}
+
+boolean HA_image::due() {
+	return root.anyDirty(DIRTY_IMAGE);
+}
+
+boolean HA_image::saveSD() {
+	char *name = IMAGE_FILES[_sdNext];
+
+	SD.remove(name);
+	File file = SD.open(name, FILE_WRITE);
+	if (!file) {
+		Serial.print(arena.heapShort(SD_FILE_HEAP) ? "image: no heap to open " : "image: can't open ");		// See HA_HEAP_RESERVE
+		Serial.println(name);
+		return false;
+	}
+	boolean saved = save(file);
+	file.close();
+
+	if (saved) _sdNext ^= 1;																// Next time leave this one alone
+	return saved;
+}
+
+boolean HA_image::restoreSD() {
+	int latest = -1;
+	unsigned long latestSeq = 0;
+
+	for (byte f = 0; f < 2; f++) {
+		if (!SD.exists(IMAGE_FILES[f])) continue;
+
+		File file = SD.open(IMAGE_FILES[f], FILE_READ);
+		if (!file) continue;
+		if (check(file) && (latest < 0 || _readSeq > latestSeq)) {
+			latest = f;
+			latestSeq = _readSeq;
+		}
+		file.close();
+	}
+	if (latest < 0) {
+		Serial.println("image: none on SD");
+		return false;
+	}
+
+	File file = SD.open(IMAGE_FILES[latest], FILE_READ);
+	boolean restored = file && restore(file);
+	if (file) file.close();
+
+	_sdNext = latest ^ 1;
+	return restored;
+}
+
+boolean HA_image::saveEEPROM(int base, unsigned long types) {
+	EEPROMStream eeprom(base);
+
+	if (length(types) > (unsigned int)eeprom.available()) {
+		Serial.println("image: too big for EEPROM");
+		return false;
+	}
+	boolean saved = save(eeprom, types);
+	_eepromWritten = eeprom.written();
+	return saved;
+}
+
+boolean HA_image::restoreEEPROM(int base) {
+	EEPROMStream eeprom(base);
+
+	if (!check(eeprom)) {
+		Serial.println("image: none in EEPROM");
+		return false;
+	}
+	eeprom.rewind();
+	return restore(eeprom);
+}
+
+unsigned int HA_image::length(unsigned long types) {
+	unsigned int len = 8 + 3;																// Header and trailer
+
+	for (byte entType = 0; entType < NUM_ENT_TYPES; entType++) {
+		if (types & IMAGE_TYPE(entType) && root.numEnts(entType) > 0) len += 3 + root.numEnts(entType) * recLen(entType);
+	}
+	return len;
+}
+
+unsigned long HA_image::sequence() {
+	return _seq;
+}
+
+void HA_image::report(char *buffer, int maxLen) {
+	snprintf(buffer, maxLen, "image seq=%lu length=%u eeprom writes=%u%s", _seq, _length, _eepromWritten, due() ? " due" : "");
+}
+
+// Read a whole image, checking as it goes.  Only applied if apply - and then only types matching the configuration
+
+boolean HA_image::scan(Stream &in, boolean apply) {
+	byte rec[IMAGE_MAX_REC];
+	int val;
+
+	_sum1 = _sum2 = 0;
+	_count = 0;
+
+	if (get(in) != 'H' || get(in) != 'I') return false;
+	if (get(in) != IMAGE_VERSION) {
+		Serial.println("image: wrong version");
+		return false;
+	}
+	if (get(in) != NUM_ENT_TYPES) return false;
+
+	_readSeq = 0;
+	for (byte i = 0; i < 4; i++) {
+		if ((val = get(in)) < 0) return false;
+		_readSeq |= (unsigned long)val << (i * 8);
+	}
+
+	while ((val = get(in)) >= 0 && val != IMAGE_END) {
+		byte entType = val;
+		int numEnts = get(in);
+		int len = get(in);
+		if (entType >= NUM_ENT_TYPES || numEnts < 0 || len < 0 || len > IMAGE_MAX_REC) return false;
+
+		boolean matches = numEnts == root.numEnts(entType) && numEnts > 0 && len == recLen(entType);
+		if (apply && !matches) {
+			Serial.print("image: skipped type ");
+			Serial.println(entType);
+		}
+
+		for (byte entNum = 0; entNum < numEnts; entNum++) {
+			for (byte i = 0; i < len; i++) {
+				if ((val = get(in)) < 0) return false;
+				rec[i] = val;
+			}
+			if (apply && matches) putRec(entType, entNum, rec);
+		}
+	}
+	if (val != IMAGE_END) return false;
+
+	byte sum1 = _sum1, sum2 = _sum2;
+	if (get(in) != sum1 || get(in) != sum2) {
+		Serial.println("image: bad checksum");
+		return false;
+	}
+	return true;
+}
+
+byte HA_image::recLen(byte entType) {
+	switch (entType) {
+		case DEV_TYPE_RFID:				return 2 * root.entBufLen(entType);
+		case VAR_TYPE_RFID:				return root.entBufLen(entType);
+		case VAR_TYPE_BYTE:				return 1;
+		case VAR_TYPE_2BYTE:			return 2;
+		case OBJ_TYPE_ZONE:				return 7;
+		default:									return (root.entColumn(entType) == COL_BIT) ? 1 : 4;
+	}
+}
+
+void HA_image::getRec(byte entType, byte entNum, byte *rec) {
+	unsigned int val;
+
+	switch (entType) {
+		case DEV_TYPE_RFID:
+			root.getEnt(entType, entNum, VAL_CURR, rec);
+			root.getEnt(entType, entNum, VAL_PREV, rec + root.entBufLen(entType));
+			break;
+		case VAR_TYPE_RFID:
+			root.getEnt(entType, entNum, VAL_CURR, rec);
+			break;
+		case VAR_TYPE_BYTE:
+			rec[0] = root.getEnt(entType, entNum, VAL_CURR);
+			break;
+		case VAR_TYPE_2BYTE:
+			val = root.getEnt(entType, entNum, VAL_CURR);
+			rec[0] = val;
+			rec[1] = val >> 8;
+			break;
+		case OBJ_TYPE_ZONE:
+			rec[0] = root.getEnt(entType, entNum, VAL_OCCUPANCY);
+			val = root.getEnt(entType, entNum, VAL_TARG_TEMP);		rec[1] = val; rec[2] = val >> 8;
+			val = root.getEnt(entType, entNum, VAL_ACT_TEMP);			rec[3] = val; rec[4] = val >> 8;
+			val = root.getEnt(entType, entNum, VAL_LUMINANCE);		rec[5] = val; rec[6] = val >> 8;
+			break;
+		default:
+			if (root.entColumn(entType) == COL_BIT) {
+				rec[0] = (root.getEnt(entType, entNum, VAL_CURR) & 1) | ((root.getEnt(entType, entNum, VAL_PREV) & 1) << 1);
+			}
+			else {
+				val = root.getEnt(entType, entNum, VAL_CURR);		rec[0] = val; rec[1] = val >> 8;
+				val = root.getEnt(entType, entNum, VAL_PREV);		rec[2] = val; rec[3] = val >> 8;
+			}
+	}
+}
+
+void HA_image::putRec(byte entType, byte entNum, byte *rec) {		// Previous pushed first, so current moves it along
+	unsigned int curr, prev;
+
+	switch (entType) {
+		case DEV_TYPE_RFID:
+			root.putEnt(entType, entNum, VAL_PUSH, (void*)(rec + root.entBufLen(entType)));
+			root.putEnt(entType, entNum, VAL_PUSH, (void*)rec);
+			break;
+		case VAR_TYPE_RFID:
+			root.putEnt(entType, entNum, VAL_PUSH, (void*)rec);
+			break;
+		case VAR_TYPE_BYTE:
+			root.putEnt(entType, entNum, VAL_PUSH, (unsigned int)rec[0]);
+			break;
+		case VAR_TYPE_2BYTE:
+			root.putEnt(entType, entNum, VAL_PUSH, (unsigned int)(rec[0] | (rec[1] << 8)));
+			break;
+		case OBJ_TYPE_ZONE:
+			root.putEnt(entType, entNum, VAL_TARG_TEMP, (unsigned int)(rec[1] | (rec[2] << 8)));
+			root.putEnt(entType, entNum, VAL_ACT_TEMP, (unsigned int)(rec[3] | (rec[4] << 8)));
+			root.putEnt(entType, entNum, VAL_LUMINANCE, (unsigned int)(rec[5] | (rec[6] << 8)));
+			if (rec[0] == ON) root.putEnt(entType, entNum, VAL_OCCUPANCY, ON);	// Restarts the countdown
+			break;
+		default:
+			if (root.entColumn(entType) == COL_BIT) {
+				prev = (rec[0] >> 1) & 1;
+				curr = rec[0] & 1;
+			}
+			else {
+				prev = rec[2] | (rec[3] << 8);
+				curr = rec[0] | (rec[1] << 8);
+			}
+			root.putEnt(entType, entNum, VAL_PUSH, prev);
+			if (root.isActor(entType)) root.setDev(entType, entNum, curr);		// Drives the output as well - a push alone would leave the hardware at its power-on state
+			else root.putEnt(entType, entNum, VAL_PUSH, curr);
+	}
+}
+
+void HA_image::clearDue() {
+	byte bits[32];																					// Enough for 255 entities
+
+	for (byte entType = 0; entType < NUM_ENT_TYPES; entType++) root.harvestDirty(DIRTY_IMAGE, entType, bits, sizeof(bits));
+}
+
+// Every byte of an image goes through put() or get(), so the checksum covers all of it
+
+void HA_image::put(Print &out, byte val) {
+	if (out.write(val) != 1) _failed = true;
+	sum(val);
+}
+
+int HA_image::get(Stream &in) {
+	int val = in.read();
+
+	if (val >= 0) sum(val);
+	return val;
+}
+
+void HA_image::sum(byte val) {
+	_sum1 = (_sum1 + val) % 255;
+	_sum2 = (_sum2 + _sum1) % 255;
+	_count++;
+}
+
+
+HA_image image;
@@ -0,0 +1,135 @@
+ /*
+    Copyright (C) 2011  Andrew Richards
+
+    Part of home automation suite
+
+    Contains the HA_image class - a saved image of HA_root state, restored for a warm restart
+
+    A reboot otherwise loses every zone's occupancy, every variable and each device's current and previous reading,
+    and the controller spends minutes repopulating them.  The image holds just that state (configuration is rebuilt
+    by setup() as ever), streamed a record at a time so no copy is built in SRAM:
+
+    - save() writes to any Print - an SD File, or the EEPROM stream below.  types picks which entity types go in
+    - check() reads a whole image and says if it is sound; restore() then applies it through putEnt, as readings do,
+      and sets actors (lights, relays, locks, power) through setDev so their outputs are driven to the saved state
+    - saveSD()/restoreSD() alternate between two files, so power lost mid-write leaves the last image intact
+    - saveEEPROM()/restoreEEPROM() for the small fields (IMAGE_SMALL), rewriting only bytes that differ
+    - due() is true once something in the image has changed since it was saved (DIRTY_IMAGE, HA_root.h)
+
+    Call restoreSD() or restoreEEPROM() at the end of setup(), once devices and channels are initialised and after
+    wakeup.init() and initSwitcher() (an occupied zone restarts its countdown and re-applies its on event), but
+    before loop() runs.
+
+    Image layout (integers LSB first)
+    ---------------------------------
+    Header:			'H' 'I' IMAGE_VERSION NUM_ENT_TYPES sequence(4)
+    Per type:		entType numEnts recLen, then numEnts records of recLen bytes.  Zones first, then in type order
+    Trailer:		IMAGE_END, Fletcher-16 of everything before it(2)
+
+    Records - bit devices: curr in bit 0, prev in bit 1.  Other devices: curr(2) prev(2), or for RFID the current
+    then previous buffers.  Variables: the value, or buffer.  Zones: occupancy(1) target(2) actual(2) luminance(2).
+    A type whose count or record length no longer matches the configuration is skipped, and starts cold.
+    Bump IMAGE_VERSION whenever a record changes.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HA_image_h
+#define HA_image_h
+
+#include "HA_globals.h"
+#include "HA_root.h"
+#include <SD.h>
+#include <EEPROM.h>
+
+#ifndef E2END
+#define E2END 4095															// Host builds - as the Mega
+#endif
+
+const static byte IMAGE_VERSION = 1;
+const static byte IMAGE_END = 0xFF;
+const static byte IMAGE_MAX_REC = 2 * HA_devRFID::_bufLen;		// Longest record - an RFID reader's two buffers
+
+#define IMAGE_TYPE(entType)		(1UL << (entType))
+const static unsigned long IMAGE_ALL = (1UL << NUM_ENT_TYPES) - 1;
+const static unsigned long IMAGE_SMALL = IMAGE_ALL & ~(IMAGE_TYPE(DEV_TYPE_RFID) | IMAGE_TYPE(VAR_TYPE_RFID));
+
+// *********** EEPROM as a stream ************
+// Reads and writes from base up to end.  A write that would not change the byte is skipped, saving time and wear
+
+class EEPROMStream : public Stream {
+	public:
+		EEPROMStream(int base, int end = E2END + 1);
+
+		virtual size_t write(uint8_t val);
+		virtual int available();
+		virtual int read();
+		virtual int peek();
+		virtual void flush();
+		using Print::write;
+
+		void rewind();
+		unsigned int written();							// Bytes actually rewritten
+
+	private:
+		int _base;
+		int _end;
+		int _addr;
+		unsigned int _written;
+};
+
+// *********** HA_image ************
+
+class HA_image {
+	public:
+		HA_image();
+
+		boolean save(Print &out, unsigned long types = IMAGE_ALL);
+		boolean check(Stream &in);											// Whole image sound - header, layout and checksum
+		boolean restore(Stream &in);										// Apply an image that has passed check()
+		boolean due();																	// Anything changed since the last save
+
+		boolean saveSD();
+		boolean restoreSD();
+		boolean saveEEPROM(int base = 0, unsigned long types = IMAGE_SMALL);
+		boolean restoreEEPROM(int base = 0);
+
+		unsigned int length(unsigned long types = IMAGE_ALL);		// Bytes save() would write, to plan EEPROM space
+		unsigned long sequence();
+		void report(char *buffer, int maxLen);
+
+	private:
+		boolean scan(Stream &in, boolean apply);
+		byte recLen(byte entType);
+		void getRec(byte entType, byte entNum, byte *rec);
+		void putRec(byte entType, byte entNum, byte *rec);
+		void clearDue();
+
+		void put(Print &out, byte val);
+		int get(Stream &in);
+		void sum(byte val);
+
+		unsigned long _seq;								// Of the last image saved or restored
+		unsigned long _readSeq;						// From the header of the image last scanned
+		byte _sum1, _sum2;								// Fletcher-16 running sums
+		unsigned int _count;							// Bytes put or got
+		boolean _failed;									// A put was not written
+		unsigned int _length;							// Of the last image saved
+		unsigned int _eepromWritten;			// Bytes rewritten by the last saveEEPROM
+		byte _sdNext;											// SD file to write next - the one not holding the latest image
+};
+
+extern HA_image image;
+
+#endif
@@ -0,0 +1,73 @@
+/* Warm restart - state saved while running and restored at the end of setup()
+
+  A small configuration (lights, heat sensors, variables and zones).  On start the newest sound image on SD is
+  restored, or failing that the EEPROM image of the small fields; either way the controller carries on where it left
+  off instead of waiting minutes for sensors to report.  Every minute, if anything has changed, the whole image is
+  written to SD; every hour the small fields are also written to EEPROM, where only bytes that differ are rewritten.
+
+  Type 'r' on Serial (9600 baud) to print the image report, 's' to save now.
+
+
+**************************/
+
+
+
+#include <SD.h>
+#include <SPI.h>
+#include <EEPROM.h>
+#include "Wakeup.h"
+#include "HA_switcher.h"
+#include "HA_root.h"
+#include "HA_arena.h"
+#include "HA_image.h"
+
+static const int EEPROM_IMAGE_BASE = 0;
+
+void saveSD() {
+  if (image.due()) image.saveSD();
+}
+
+void saveEEPROM() {
+  image.saveEEPROM(EEPROM_IMAGE_BASE);
+}
+
+void setup() {
+  char buffer[60];
+
+  Serial.begin(9600);
+  wakeup.init();
+  initSwitcher();
+
+  // Configuration, as ever
+  if (!root.createChanArray(1) || !root.createEntArray(DEV_TYPE_LIGHT, 16) || !root.createEntArray(DEV_TYPE_HEAT, 4)
+      || !root.createEntArray(DEV_TYPE_RELAY, 4) || !root.createEntArray(VAR_TYPE_2BYTE, 8) || !root.createEntArray(OBJ_TYPE_ZONE, 4)) {
+    Serial.println("No space - raise HA_ARENA_SIZE");
+    return;
+  }
+  arena.seal();
+
+  // State, from the last run
+  pinMode(SS, OUTPUT);
+  if (!(SD.begin(SD_CS_PIN) && image.restoreSD())) image.restoreEEPROM(EEPROM_IMAGE_BASE);
+  image.report(buffer, 60);
+  Serial.println(buffer);
+
+  wakeup.wakeMeAfter(saveSD, 1, REPEAT_COUNT | UNITS_MINUTES);
+  wakeup.wakeMeAfter(saveEEPROM, 1, REPEAT_COUNT | UNITS_HOURS);
+}
+
+void loop() {
+  char buffer[60];
+
+  wakeup.runAnyPending();
+
+  switch (Serial.read()) {
+    case 'r':
+      image.report(buffer, 60);
+      Serial.println(buffer);
+      break;
+    case 's':
+      Serial.println(image.saveSD() ? "saved" : "not saved");
+      break;
+  }
+}
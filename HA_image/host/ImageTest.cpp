@@ -0,0 +1,321 @@
+ /*
+	*****************  HA host build  **********************
+
+	Description
+	-----------
+
+	Saved state images of HA_root on a PC, with SD and EEPROM in memory (HA_root/host/HostCore.h).  Each case prints
+	FAIL with the file and line and what was seen, and the program exits 1 if any failed:
+
+		- memory round trip: every device, variable and zone reading saved, the controller rebooted, and the image
+		  checked and restored to exactly the state before, with each light's and relay's pin driven to match
+		- rejection: check() refuses the image with any byte corrupted, truncated, or with the wrong IMAGE_VERSION
+		- a type whose configuration has changed is skipped and starts cold, the rest are restored
+		- SD: the two files alternate and the newest is restored; when the newest is torn (power lost part way
+		  through writing it) the previous image is restored instead
+		- EEPROM: the small fields only, and a resave rewrites only the bytes that changed
+
+	From the repository root:
+
+		sh HA_root/host/build.sh HA_image/host/ImageTest.cpp imagetest
+		./imagetest
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HostCore.h"
+#include "HA_root.h"
+#include "HA_image.h"
+
+static const byte TYPES[] = { DEV_TYPE_LIGHT, DEV_TYPE_RELAY, DEV_TYPE_HEAT, DEV_TYPE_LUMINANCE, DEV_TYPE_RFID, VAR_TYPE_BYTE, VAR_TYPE_2BYTE, VAR_TYPE_RFID, OBJ_TYPE_ZONE };
+static const byte COUNTS[] = { 20, 2, 3, 5, 2, 4, 4, 2, 3 };
+static const unsigned int STATE_LEN = 4096;
+static const unsigned int IMAGE_LEN = 4096;
+static const int EEPROM_BASE = 100;
+static const byte ACTOR_PIN = 22;
+
+int fails;
+
+// An image in memory
+class MemStream : public Stream {
+	public:
+		MemStream() : len(0), pos(0) {}
+		size_t write(uint8_t val) {
+			if (len >= IMAGE_LEN) return 0;
+			data[len++] = val;
+			return 1;
+		}
+		using Print::write;
+		int available() { return len - pos; }
+		int read() { return (pos < len) ? data[pos++] : -1; }
+		int peek() { return (pos < len) ? data[pos] : -1; }
+
+		uint8_t data[IMAGE_LEN];
+		unsigned int len;
+		unsigned int pos;
+};
+
+// Every value the image should carry, as text, to compare before and after
+class State {
+	public:
+		State() { _text[0] = '\0'; }
+		boolean operator==(const State &other) const { return strcmp(_text, other._text) == 0; }
+		boolean operator!=(const State &other) const { return !(*this == other); }
+		const char *text() const { return _text; }
+		void add(const char *format, unsigned int a, unsigned int b = 0, unsigned int c = 0, unsigned int d = 0) {
+			unsigned int len = strlen(_text);
+			snprintf(_text + len, STATE_LEN - len, format, a, b, c, d);
+		}
+
+	private:
+		char _text[STATE_LEN];
+};
+
+State state() {
+	State s;
+
+	for (byte i = 0; i < sizeof(TYPES); i++) {
+		byte t = TYPES[i];
+		for (byte n = 0; n < root.numEnts(t); n++) {
+			if (t == DEV_TYPE_RFID || t == VAR_TYPE_RFID) {
+				byte *curr = root.getBufPtr(t, n, VAL_CURR);
+				byte *prev = (t == DEV_TYPE_RFID) ? root.getBufPtr(t, n, VAL_PREV) : curr;
+				for (byte k = 0; k < HA_devRFID::_bufLen; k++) s.add("%02x%02x", curr[k], prev[k]);
+			}
+			else if (t == OBJ_TYPE_ZONE) s.add("z%u/%u/%u/%u", root.getEnt(t, n, VAL_OCCUPANCY), root.getEnt(t, n, VAL_TARG_TEMP),
+				root.getEnt(t, n, VAL_ACT_TEMP), root.getEnt(t, n, VAL_LUMINANCE));
+			else if (t >= NUM_DEV_TYPES) s.add("v%u", root.getEnt(t, n, VAL_CURR));
+			else s.add("d%u/%u", root.getEnt(t, n, VAL_CURR), root.getEnt(t, n, VAL_PREV));
+			s.add(" ", 0);
+		}
+		s.add("|", 0);
+	}
+	return s;
+}
+
+// Lights and relays drive pins directly, from ACTOR_PIN up
+byte actorPin(byte entType, byte entNum) {
+	return ACTOR_PIN + ((entType == DEV_TYPE_RELAY) ? COUNTS[0] : 0) + entNum;
+}
+
+// Configuration as setup() would build it - heating's count can be changed to make its type no longer match an image
+void configure(byte numHeat = COUNTS[2]) {
+	hostReboot();
+	root.createChanArray(1);
+	root.initChan(0, CHAN_PROTOCOL_PIO, HOST_PINS, 0);
+	root.initChanAccess(0, CHAN_ACCESS_DIRECT, 0, 0, 0);
+	for (byte i = 0; i < sizeof(TYPES); i++) {
+		CHECK(root.createEntArray(TYPES[i], (TYPES[i] == DEV_TYPE_HEAT) ? numHeat : COUNTS[i]), "no space for type %d", TYPES[i]);
+	}
+	for (byte n = 0; n < COUNTS[0]; n++) root.initDev(DEV_TYPE_LIGHT, n, CH0, actorPin(DEV_TYPE_LIGHT, n), 0);
+	for (byte n = 0; n < COUNTS[1]; n++) root.initDev(DEV_TYPE_RELAY, n, CH0, actorPin(DEV_TYPE_RELAY, n), 0);
+}
+
+// Each actor's output must be what the root says it is - a restored reading the hardware never got is a lie
+unsigned int actorsWrong() {
+	unsigned int wrong = 0;
+
+	for (byte i = 0; i < 2; i++) {
+		byte t = (i == 0) ? DEV_TYPE_LIGHT : DEV_TYPE_RELAY;
+		for (byte n = 0; n < root.numEnts(t); n++) {
+			if (hostPins[actorPin(t, n)] != root.getEnt(t, n, VAL_CURR)) wrong++;
+		}
+	}
+	return wrong;
+}
+
+// Two readings for everything, so current and previous differ
+void populate() {
+	byte bufA[HA_devRFID::_bufLen], bufB[HA_devRFID::_bufLen];
+
+	for (byte n = 0; n < COUNTS[0]; n++) {
+		root.setDev(DEV_TYPE_LIGHT, n, n % 3 == 0);
+		root.setDev(DEV_TYPE_LIGHT, n, n % 2 == 0);
+	}
+	root.setDev(DEV_TYPE_RELAY, 1, ON);
+	for (byte n = 0; n < COUNTS[2]; n++) {
+		root.putEnt(DEV_TYPE_HEAT, n, VAL_PUSH, (unsigned int)(1800 + n));
+		root.putEnt(DEV_TYPE_HEAT, n, VAL_PUSH, (unsigned int)(2100 + n * 7));
+	}
+	for (byte n = 0; n < COUNTS[3]; n++) {
+		root.putEnt(DEV_TYPE_LUMINANCE, n, VAL_PUSH, (unsigned int)(300 * n));
+		root.putEnt(DEV_TYPE_LUMINANCE, n, VAL_PUSH, (unsigned int)(65535 - n));
+	}
+	for (byte n = 0; n < COUNTS[4]; n++) {
+		for (byte k = 0; k < HA_devRFID::_bufLen; k++) {
+			bufA[k] = k + n;
+			bufB[k] = 0xA0 + k * n;
+		}
+		root.putEnt(DEV_TYPE_RFID, n, VAL_PUSH, (void*)bufA);
+		root.putEnt(DEV_TYPE_RFID, n, VAL_PUSH, (void*)bufB);
+	}
+	for (byte n = 0; n < COUNTS[5]; n++) {
+		root.putEnt(VAR_TYPE_BYTE, n, VAL_PUSH, (unsigned int)(200 + n));
+		root.putEnt(VAR_TYPE_2BYTE, n, VAL_PUSH, (unsigned int)(40000 + n));
+	}
+	for (byte n = 0; n < COUNTS[7]; n++) {
+		for (byte k = 0; k < HA_devRFID::_bufLen; k++) bufA[k] = 0x30 + k + n;
+		root.putEnt(VAR_TYPE_RFID, n, VAL_PUSH, (void*)bufA);
+	}
+	root.putEnt(OBJ_TYPE_ZONE, 1, VAL_TARG_TEMP, (unsigned int)2150);
+	root.putEnt(OBJ_TYPE_ZONE, 1, VAL_ACT_TEMP, (unsigned int)1975);
+	root.putEnt(OBJ_TYPE_ZONE, 1, VAL_LUMINANCE, (unsigned int)420);
+	root.putEnt(OBJ_TYPE_ZONE, 1, VAL_OCCUPANCY, ON);
+	root.putEnt(OBJ_TYPE_ZONE, 2, VAL_ACT_TEMP, (unsigned int)1600);
+}
+
+boolean checks(MemStream &mem) {
+	mem.pos = 0;
+	return image.check(mem);
+}
+
+void testMemory() {
+	MemStream mem;
+
+	configure();
+	populate();
+	State before = state();
+	CHECK(image.due(), "not due after changes");
+	CHECK(image.save(mem), "save failed");
+	CHECK(mem.len == image.length(), "saved %u bytes, length() says %u", mem.len, image.length());
+	CHECK(!image.due(), "still due after save");
+
+	configure();
+	CHECK(state() != before, "reboot did not clear state");
+	CHECK(actorsWrong() == 0 && hostPins[actorPin(DEV_TYPE_RELAY, 1)] == LOW, "outputs not at power on after reboot");
+	CHECK(checks(mem), "sound image refused");
+	mem.pos = 0;
+	CHECK(image.restore(mem), "restore failed");
+	CHECK(state() == before, "restored state differs\n  saved    %s\n  restored %s", before.text(), state().text());
+	CHECK(actorsWrong() == 0, "%u lights and relays restored without their outputs being set", actorsWrong());
+	CHECK(!image.due(), "due straight after restore");
+	printf("Memory: %u byte image, %u chars of state identical after restore\n", mem.len, (unsigned int)strlen(before.text()));
+
+	// Rejection - every byte corrupted in turn, the end cut off, or another version
+	unsigned int accepted = 0;
+	for (unsigned int i = 0; i < mem.len; i++) {
+		MemStream bad = mem;
+		bad.data[i] ^= 0x10;
+		if (checks(bad)) accepted++;
+	}
+	CHECK(accepted == 0, "%u of %u single byte corruptions accepted", accepted, mem.len);
+	for (unsigned int cut = 1; cut < mem.len; cut += 13) {
+		MemStream bad = mem;
+		bad.len -= cut;
+		CHECK(!checks(bad), "image truncated by %u bytes accepted", cut);
+	}
+	MemStream bad = mem;
+	bad.data[2] = IMAGE_VERSION + 1;
+	CHECK(!checks(bad), "image of version %d accepted", IMAGE_VERSION + 1);
+
+	// A changed configuration - heating no longer matches, so starts cold, and the rest is restored
+	configure(COUNTS[2] + 1);
+	mem.pos = 0;
+	CHECK(image.restore(mem), "restore to changed configuration failed");
+	CHECK(root.getEnt(DEV_TYPE_HEAT, 0, VAL_CURR) == 0, "heating restored to a different count");
+	CHECK(root.getEnt(VAR_TYPE_2BYTE, 3, VAL_CURR) == 40003, "variables not restored alongside a changed type");
+}
+
+SDSlot *newestFile() {													// Highest sequence in the header, bytes 4-7
+	SDSlot *newest = NULL;
+	unsigned long newestSeq = 0;
+
+	for (byte f = 0; f < SD_SLOTS; f++) {
+		if (!sdSlots[f].used) continue;
+		unsigned long seq = 0;
+		for (byte i = 0; i < 4; i++) seq |= (unsigned long)sdSlots[f].data[4 + i] << (8 * i);
+		if (newest == NULL || seq > newestSeq) {
+			newest = &sdSlots[f];
+			newestSeq = seq;
+		}
+	}
+	return newest;
+}
+
+void testSD() {
+	memset(sdSlots, 0, sizeof(sdSlots));
+	configure();
+	populate();
+	CHECK(image.saveSD(), "first SD save failed");
+	unsigned long firstSeq = image.sequence();
+	root.putEnt(VAR_TYPE_BYTE, 0, VAL_PUSH, (unsigned int)7);
+	State newer = state();
+	CHECK(image.saveSD(), "second SD save failed");
+	CHECK(sdSlots[0].used && sdSlots[1].used, "expected two image files");
+
+	configure();
+	CHECK(image.restoreSD() && state() == newer, "newest SD image not restored");
+	CHECK(image.sequence() == firstSeq + 1, "restored sequence %lu, expected %lu", image.sequence(), firstSeq + 1);
+
+	// Power lost part way through the next save - cut short, or cut short with the rest of the card block left
+	// as it was.  Either way the file before it is restored
+	root.putEnt(VAR_TYPE_BYTE, 0, VAL_PUSH, (unsigned int)9);
+	CHECK(image.saveSD(), "third SD save failed");
+	SDSlot *torn = newestFile();
+	SDSlot saved = *torn;
+	for (byte tear = 0; tear < 2; tear++) {
+		*torn = saved;
+		torn->len /= 2;
+		if (tear == 1) {
+			memset(torn->data + torn->len, 0xFF, saved.len - torn->len);
+			torn->len = saved.len;
+		}
+		configure();
+		CHECK(image.restoreSD() && state() == newer, "torn SD write %d did not fall back to the previous image", tear);
+	}
+	printf("SD: newest restored, torn write falls back to the previous image\n");
+}
+
+void testEEPROM() {
+	char report[80];
+
+	configure();
+	populate();
+	hostEepromWrites = 0;
+	CHECK(image.saveEEPROM(EEPROM_BASE), "EEPROM save failed");
+	unsigned long firstWrites = hostEepromWrites;
+	hostEepromWrites = 0;
+	image.saveEEPROM(EEPROM_BASE);
+	unsigned long resaveWrites = hostEepromWrites;
+	root.putEnt(VAR_TYPE_BYTE, 2, VAL_PUSH, (unsigned int)1);
+	hostEepromWrites = 0;
+	image.saveEEPROM(EEPROM_BASE);
+	unsigned long changedWrites = hostEepromWrites;
+	printf("EEPROM: %u byte image; first save wrote %lu, unchanged resave %lu, one variable changed %lu\n",
+		image.length(IMAGE_SMALL), firstWrites, resaveWrites, changedWrites);
+	CHECK(firstWrites <= image.length(IMAGE_SMALL), "first save wrote %lu bytes", firstWrites);
+	CHECK(resaveWrites <= 6, "unchanged resave wrote %lu bytes - more than sequence and checksum", resaveWrites);
+	CHECK(changedWrites <= 8, "resave with one variable changed wrote %lu bytes", changedWrites);
+
+	configure();
+	CHECK(image.restoreEEPROM(EEPROM_BASE), "EEPROM restore failed");
+	CHECK(root.getEnt(VAR_TYPE_BYTE, 2, VAL_CURR) == 1, "variable not restored from EEPROM");
+	CHECK(root.getEnt(DEV_TYPE_HEAT, 2, VAL_PREV) == 1802, "device not restored from EEPROM");
+	CHECK(root.getEnt(OBJ_TYPE_ZONE, 1, VAL_OCCUPANCY) == ON, "zone not restored from EEPROM");
+	CHECK(root.getBufPtr(VAR_TYPE_RFID, 0, VAL_CURR)[0] == 0, "RFID restored from EEPROM - not one of the small types");
+	image.report(report, sizeof(report));
+	printf("%s\n", report);
+}
+
+int main() {
+	testMemory();
+	testSD();
+	testEEPROM();
+
+	printf("%s (%d failures)\n", fails ? "FAILED" : "PASSED", fails);
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+ /*
+    Copyright (C) 2011  Andrew Richards
+
+    Part of home automation suite
+
+    Contains the configuration tables read by HA_root::loadConfig
+
+    A controller's topology - channels, entity arrays, devices, zone settings, interrupt ranges, evaluations and arg
+    lists - is written once in a text file and compiled by tools/ha_config.py into constant tables in PROGMEM (see
+    the tool for the file format).  setup() then makes one call, root.loadConfig(&CONFIG), in place of the long runs of
+    createEntArray, initChan, initDev, putEval and putArg calls:
+
+    - Channels, entity arrays, devices, settings and ranges are walked once, through the usual HA_root methods, to
+    build the mutable state in SRAM
+    - Evaluations and arg lists never change, so they are not copied.  HA_root reads them from the tables in flash,
+    leaving the arena for state.  They are checked as a graph (HA_root::checkEvals) - a loop or a missing input fails
+    loadConfig, before anything runs
+
+    Each table is an array of the records below; HA_config (also in PROGMEM) says where each is and how long.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HA_config_h
+#define HA_config_h
+
+#include "HA_root.h"
+
+const static byte CONFIG_VERSION = 1;							// Tables from a different version of ha_config.py are refused
+const static byte CONFIG_EVAL_LEN = 4;						// Bytes per evaluation - as HA_evaluation
+
+struct cfgChannel {															// initChan, initChanAccess and (unless CHAN_ALERT_NONE) initChanAlert
+	byte protocolType;
+	byte maxPins;
+	byte ioPin;
+	byte accessType;
+	byte latchPin;
+	byte dataPin;
+	byte clockPin;
+	byte alertType;
+	byte intNum;
+	byte intMode;
+	byte resetPin;
+	byte slaveSelectPin;
+	byte slaveSelectPinBank0;
+	byte slaveSelectPinBank1;
+};
+
+struct cfgEntities {														// createEntArray
+	byte entType;
+	byte numEnts;
+};
+
+struct cfgDevice {															// initDev
+	byte devType;
+	byte devNum;
+	byte channel;
+	byte pin;
+	byte handler;
+};
+
+struct cfgSetting {															// putEnt, for zones and starting values
+	byte entType;
+	byte entNum;
+	byte valType;
+	unsigned int val;
+};
+
+struct cfgRange {																// registerDevRange
+	byte chanNum;
+	byte rangeNum;
+	byte intPin;
+	byte devType;
+	byte devNum;
+};
+
+struct HA_config {
+	byte version;
+	byte numChans;
+	const cfgChannel *chans;											// Channel n is chans[n]
+	byte numEntArrays;
+	const cfgEntities *entArrays;
+	unsigned int numDevs;
+	const cfgDevice *devs;
+	unsigned int numSettings;
+	const cfgSetting *settings;
+	byte numRanges;
+	const cfgRange *ranges;
+	byte numEvals;
+	const byte *evals;														// CONFIG_EVAL_LEN bytes per evaluation, laid out as HA_evaluation
+	byte numArgLists;
+	const unsigned int *argIndex;									// Offset in args of each list, and one past the last
+	const byte *args;
+};
+
+typedef char configEvalLen[sizeof(HA_evaluation) == CONFIG_EVAL_LEN ? 1 : -1];		// Compile error if HA_evaluation changes shape
+
+#endif
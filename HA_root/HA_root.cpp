@@ -21,29 +21,187 @@
 
 
 #include "HA_root.h"
+#include "HA_arena.h"
+#include "HA_config.h"
 #include "Time.h"
+#include <avr/pgmspace.h>
+
+
+// ************* Operations table - one thunk per class and operation, so each call is direct ***************
+
+template <class T> static unsigned int opGet(void *ent, byte valType) 		{ return static_cast<T*>(ent)->get(valType); }
+template <class T> static unsigned int opGetVar(void *ent, byte valType) 	{ return static_cast<T*>(ent)->get(); }
+template <class T> static void opPut(void *ent, byte valType, unsigned int val) 		{ static_cast<T*>(ent)->put(valType, val); }
+template <class T> static void opPutVar(void *ent, byte valType, unsigned int val) 	{ static_cast<T*>(ent)->put(val); }
+template <class T> static byte opPutRef(void *ent, char *device) 					{ return static_cast<T*>(ent)->putRef(device); }
+template <class T> static void opGetRef(void *ent, byte entNum, char *device) 	{ static_cast<T*>(ent)->getRef(device); }
+template <class T> static void opGetSnapshot(void *ent) 									{ static_cast<T*>(ent)->getSnapshot(); }
+template <class T> static void opInitDev(void *ent, byte devNum, byte channel, byte pin, byte handler) 	{ static_cast<T*>(ent)->initDev(devNum, channel, pin, handler); }
+template <class T> static void opReadDev(void *ent, byte devNum) 				{ static_cast<T*>(ent)->readDev(); }
+template <class T> static void opSetDev(void *ent, byte val) 						{ static_cast<T*>(ent)->setDev(val); }
+
+static void opReadDevMotion(void *ent, byte devNum) 											{ static_cast<HA_devMotion*>(ent)->readDev(devNum); }
+static unsigned int opNoGet(void *ent, byte valType)											{ return 0; }		// Multi-byte variable, or no array yet
+static void opNoPut(void *ent, byte valType, unsigned int val) 						{ }
+
+static void varRef(char varCode, byte entNum, char *device) {
+	device[0] = 'v'; device[1] = varCode; device[2] = '.'; device[3] = entNum / 10 + 0x30; device[4] = entNum % 10 + 0x30; device[5] = 0x00;
+}
+static void opGetRefVarByte(void *ent, byte entNum, char *device)					{ varRef('B', entNum, device); }
+static void opGetRefVar2Byte(void *ent, byte entNum, char *device)				{ varRef('I', entNum, device); }
+static void opGetRefVarRFID(void *ent, byte entNum, char *device)					{ varRef('R', entNum, device); }
+static void opGetRefZone(void *ent, byte entNum, char *device) {
+	device[0] = static_cast<HA_zone*>(ent)->get(VAL_REGION); device[1] = static_cast<HA_zone*>(ent)->get(VAL_ZONE) + 0x30; device[2] = 0x00;
+}
+
+#define DEV_OPS(T)				sizeof(T), T::COLUMN, opGet<T>, opPut<T>, opPutRef<T>, opGetRef<T>, opGetSnapshot<T>, opInitDev<T>
+#define SENSOR_OPS(T)			DEV_OPS(T), opReadDev<T>, NULL
+#define ACTOR_OPS(T)			DEV_OPS(T), NULL, opSetDev<T>
+
+static const entOps ENT_OPS[] PROGMEM = {
+	{ SENSOR_OPS(HA_devTouch) },																																						// DEV_TYPE_TOUCH
+	{ SENSOR_OPS(HA_devFire) },																																							// DEV_TYPE_FIRE
+	{ SENSOR_OPS(HA_devHeat) },																																							// DEV_TYPE_HEAT
+	{ SENSOR_OPS(HA_devLuminance) },																																				// DEV_TYPE_LUMINANCE
+	{ DEV_OPS(HA_devMotion), opReadDevMotion, NULL },																												// DEV_TYPE_MOTION
+	{ SENSOR_OPS(HA_devPresence) },																																					// DEV_TYPE_PRESENCE
+	{ SENSOR_OPS(HA_devRFID) },																																							// DEV_TYPE_RFID.  Only underlying HA_device data via get/put
+	{ SENSOR_OPS(HA_devOpen) },																																							// DEV_TYPE_OPEN
+	{ ACTOR_OPS(HA_dev5APower) },																																						// DEV_TYPE_5APWR
+	{ ACTOR_OPS(HA_dev13APower) },																																					// DEV_TYPE_13APWR
+	{ ACTOR_OPS(HA_devLock) },																																							// DEV_TYPE_LOCK
+	{ ACTOR_OPS(HA_devLight) },																																							// DEV_TYPE_LIGHT
+	{ ACTOR_OPS(HA_devRelay) },																																							// DEV_TYPE_RELAY
+	{ sizeof(HA_varByte), COL_NONE, opGetVar<HA_varByte>, opPutVar<HA_varByte>, NULL, opGetRefVarByte, NULL, NULL, NULL, NULL },			// VAR_TYPE_BYTE
+	{ sizeof(HA_var2Byte), COL_NONE, opGetVar<HA_var2Byte>, opPutVar<HA_var2Byte>, NULL, opGetRefVar2Byte, NULL, NULL, NULL, NULL },	// VAR_TYPE_2BYTE
+	{ sizeof(HA_varRFID), COL_NONE, opNoGet, opNoPut, NULL, opGetRefVarRFID, NULL, NULL, NULL, NULL },												// VAR_TYPE_RFID.  No underlying data for multi-byte variable
+	{ sizeof(HA_zone), COL_NONE, opGet<HA_zone>, opPut<HA_zone>, NULL, opGetRefZone, opGetSnapshot<HA_zone>, NULL, NULL, NULL }				// OBJ_TYPE_ZONE
+};
+
+typedef char entOpsComplete[sizeof(ENT_OPS) / sizeof(ENT_OPS[0]) == NUM_ENT_TYPES ? 1 : -1];		// Compile error if a type is missing
 
           
 HA_root::HA_root() {
-	for (int i = 0; i < (NUM_DEV_TYPES + NUM_VAR_TYPES + 1); i++) {					// +1 for zones
+	for (int i = 0; i < NUM_ENT_TYPES; i++) {
 		_numEnts[i] = 0;
 		_classSize[i] = 0;
 		_entPtrs[i] = NULL;
+		_entGet[i] = opNoGet;
+		_entPut[i] = opNoPut;
+		_dirtyBits[i] = NULL;
 	}
+	memset(_dirtyTypes, 0, sizeof(_dirtyTypes));
+#ifdef HA_COLUMNS
+	for (int i = 0; i < NUM_DEV_TYPES; i++) {
+		_colKind[i] = COL_NONE;
+		_colCurr[i] = _colPrev[i] = NULL;
+	}
+#endif
 	
 	_numEvals = 0;
 	ptrEvaluation = NULL;
+	_evalTable = NULL;
 	
 	_numArgLists = 0;
 	ptrArgList = NULL;
+	_argIndex = NULL;
+	_argTable = NULL;
+	
+	_evalCode = NULL;
+	_evalEntry = NULL;
+	_evalCodeLen = 0;
+	_evalSched = NULL;
+	_numEvalSched = _evalSchedLen = 0;
+	_evalStale = true;
+	
+	_evalOrder = NULL;
+	_evalDepth = 0;
+	_orderStale = true;
+	
+	_memoStamp = NULL;
+	_memoVal = NULL;
+	_memoEpoch = 0;
+	_memoOn = false;
+	_memoHits = _memoMisses = 0;
+	_inPass = false;
+	_passNow = 0;
+	
+	_evalDirty = _evalVolatile = _readers = NULL;
+	_evalLast = _entReaderIdx = _evalReaderIdx = NULL;
+	_depEnts = _depLinks = 0;
+	_depStale = true;
 	
 	_numChannels = 0;
 	ptrChannel = NULL;
+	
+	_refCount = _refBuckets = _refSlots = 0;
+	_refDisp = _refIndex = NULL;
+	_refStale = true;
 };
 
 HA_root::~HA_root() {};
 
 
+// *************  Configuration tables - see HA_config.h  ********************
+
+boolean HA_root::loadConfig(const HA_config *config) {
+	HA_config cfg;
+	memcpy_P(&cfg, config, sizeof(HA_config));
+	
+	if (cfg.version != CONFIG_VERSION) {Serial.println("HA_root: config version"); return false;}
+	if (_numChannels != 0 || _numEvals != 0 || _numArgLists != 0) {Serial.println("HA_root: dup config"); return false;}
+	
+	// Channels first, as devices open them
+	if (cfg.numChans > 0 && !createChanArray(cfg.numChans)) return false;
+	for (byte i = 0; i < cfg.numChans; i++) {
+		cfgChannel chan;
+		memcpy_P(&chan, &cfg.chans[i], sizeof(cfgChannel));
+		
+		initChan(i, chan.protocolType, chan.maxPins, chan.ioPin);
+		initChanAccess(i, chan.accessType, chan.latchPin, chan.dataPin, chan.clockPin);
+		if (chan.alertType != CHAN_ALERT_NONE) initChanAlert(i, chan.alertType, chan.intNum, chan.intMode, chan.resetPin, chan.slaveSelectPin, chan.slaveSelectPinBank0, chan.slaveSelectPinBank1);
+	}
+	
+	for (byte i = 0; i < cfg.numEntArrays; i++) {
+		cfgEntities ents;
+		memcpy_P(&ents, &cfg.entArrays[i], sizeof(cfgEntities));
+		
+		if (!createEntArray(ents.entType, ents.numEnts)) {
+			Serial.print("HA_root: config ents ");
+			Serial.println(ents.entType);
+			return false;
+		}
+	}
+	
+	for (unsigned int i = 0; i < cfg.numDevs; i++) {
+		cfgDevice dev;
+		memcpy_P(&dev, &cfg.devs[i], sizeof(cfgDevice));
+		initDev(dev.devType, dev.devNum, dev.channel, dev.pin, dev.handler);
+	}
+	
+	for (unsigned int i = 0; i < cfg.numSettings; i++) {
+		cfgSetting setting;
+		memcpy_P(&setting, &cfg.settings[i], sizeof(cfgSetting));
+		putEnt(setting.entType, setting.entNum, setting.valType, setting.val);
+	}
+	
+	for (byte i = 0; i < cfg.numRanges; i++) {
+		cfgRange range;
+		memcpy_P(&range, &cfg.ranges[i], sizeof(cfgRange));
+		registerDevRange(range.chanNum, range.rangeNum, range.intPin, range.devType, range.devNum);
+	}
+	
+	// Evaluations and arg lists stay where they are
+	_numEvals = cfg.numEvals;
+	_evalTable = cfg.evals;
+	_numArgLists = cfg.numArgLists;
+	_argIndex = cfg.argIndex;
+	_argTable = cfg.args;
+	
+	return checkEvals();
+}
+
+
 int HA_root::findZone(byte regionZone) {
 	for (int zoneNum = 0; zoneNum < _numEnts[OBJ_TYPE_ZONE]; zoneNum++) {
 		if (entPtrs.ptrZone[zoneNum].get(VAL_REGION_ZONE) == regionZone) return zoneNum;
@@ -53,56 +211,279 @@ int HA_root::findZone(byte regionZone) {
 }
 
 
+// *************  Reference lookup  ********************
+//
+// Device references are found through a perfect hash (hash and displace) that indexRefs builds once the refs are set.  Each
+// ref packs into a 21 bit key; keys are hashed into buckets of about two, and each bucket is given the displacement that
+// sends all of its keys to empty slots.  A lookup parses the text once, hashes twice and checks the one device in its slot -
+// the same cost however many devices there are, and nothing is allocated.  Slots hold just the device's type and number,
+// about 3 bytes of arena per device with the displacements.  Without an index, or once a ref has changed, the devices of
+// the reference's type are scanned instead.  Variables and zones are decoded from the text.
+//
+// To build, every device's key is packed once into a list on top of the arena, sorted by bucket, and given back at the
+// end - 6 bytes a device for the moment it takes, so rebuild before arena.seal().  Each bucket then tries displacements
+// against just its own keys, so building is O(n log n) in the devices, not a pass over every device per try.
+//
+// The other way, getRef, needs no index: each device holds its own ref, and the type codes are a table in flash.
+
+static const byte REF_EMPTY = 0xFF;										// Slot with no device
+static const byte REF_MAX_DISP = 0x80;
+
+struct refEntry {																			// One device while indexRefs runs
+	unsigned long key;
+	byte devType;
+	byte devNum;
+};
+
+static unsigned long packRef(byte devType, unsigned int regionZone, unsigned int location, unsigned int devNum) {
+	return ((unsigned long)devType << 16) | ((regionZone & 0x3F) << 10) | (((location - 1) & 0x3F) << 4) | (devNum & 0x07);
+}
+
+static unsigned int refHash(unsigned long key, byte seed) {		// A different hash for each seed
+	key ^= seed * 0x9E3779B1UL;
+	key ^= key >> 16;
+	key *= 0x85EBCA6BUL;
+	key ^= key >> 13;
+	key *= 0xC2B2AE35UL;
+	return (unsigned int)(key ^ (key >> 16));
+}
+
+static boolean refBefore(refEntry *a, refEntry *b, unsigned int buckets) {	// Bucket order, then device order within a bucket
+	unsigned int bucketA = refHash(a->key, 0) % buckets, bucketB = refHash(b->key, 0) % buckets;
+	if (bucketA != bucketB) return bucketA < bucketB;
+	return (a->devType != b->devType) ? a->devType < b->devType : a->devNum < b->devNum;
+}
+
+static void refSiftDown(refEntry *entries, unsigned int pos, unsigned int num, unsigned int buckets) {		// Max-heap, for the sort
+	for (unsigned int child; (child = 2 * pos + 1) < num; pos = child) {
+		if (child + 1 < num && refBefore(&entries[child], &entries[child + 1], buckets)) child++;
+		if (!refBefore(&entries[pos], &entries[child], buckets)) return;
+		refEntry swap = entries[pos];
+		entries[pos] = entries[child];
+		entries[child] = swap;
+	}
+}
+
+static boolean refPlace(refEntry *entries, byte num, byte disp, byte *index, unsigned int slots) {		// The bucket's keys all into empty slots, or none of them
+	for (byte i = 0; i < num; i++) {
+		byte j = 0;
+		while (j < i && entries[j].key != entries[i].key) j++;
+		if (j < i) continue;																	// The same ref twice - the first device keeps it, as a scan would find
+		
+		byte *slot = index + 2 * (refHash(entries[i].key, disp + 1) % slots);
+		if (slot[0] == REF_EMPTY) {
+			slot[0] = entries[i].devType;
+			slot[1] = entries[i].devNum;
+			continue;
+		}
+		for (j = 0; j < i; j++) {															// Collision - take back the keys placed so far
+			slot = index + 2 * (refHash(entries[j].key, disp + 1) % slots);
+			if (slot[0] == entries[j].devType && slot[1] == entries[j].devNum) slot[0] = slot[1] = REF_EMPTY;
+		}
+		return false;
+	}
+	return true;
+}
+
+unsigned long HA_root::refKey(byte devType, byte devNum) {
+	return packRef(devType, getEnt(devType, devNum, VAL_REGION_ZONE), getEnt(devType, devNum, VAL_LOCATION), getEnt(devType, devNum, VAL_DEVNUM));
+}
+
+boolean HA_root::indexRefs() {			// Call again if refs change - putRef marks the index stale, and findRef scans until then
+	unsigned int count = 0;
+	for (byte devType = 0; devType < NUM_DEV_TYPES; devType++) count += _numEnts[devType];
+	if (count == 0) return true;
+	
+	if (_refIndex == NULL || _refSlots != count + count / 4 + 1) {				// First time, or more devices since
+		unsigned int arenaMark = arena.mark();
+		_refCount = 0;
+		_refBuckets = count / 2 + 1;
+		_refSlots = count + count / 4 + 1;															// Load of 0.8 - displacements are found in a few tries
+		_refDisp = (byte*)arena.alloc(_refBuckets);
+		_refIndex = (byte*)arena.alloc(_refSlots * 2);
+		if (_refDisp == NULL || _refIndex == NULL) {
+			arena.release(arenaMark);
+			_refDisp = _refIndex = NULL;
+			Serial.println("HA_root: no space for ref index");
+			return false;
+		}
+	}
+	
+	// Every key packed once, then sorted so each bucket's keys are together
+	unsigned int arenaMark = arena.mark();
+	refEntry *entries = (refEntry*)arena.alloc(count * sizeof(refEntry));
+	if (entries == NULL) {
+		_refCount = 0;
+		Serial.println("HA_root: no space to build ref index");
+		return false;
+	}
+	unsigned int e = 0;
+	for (byte devType = 0; devType < NUM_DEV_TYPES; devType++) {
+		for (byte devNum = 0; devNum < _numEnts[devType]; devNum++, e++) {
+			entries[e].key = refKey(devType, devNum);
+			entries[e].devType = devType;
+			entries[e].devNum = devNum;
+		}
+	}
+	for (e = count / 2; e-- > 0; ) refSiftDown(entries, e, count, _refBuckets);
+	for (e = count - 1; e > 0; e--) {
+		refEntry swap = entries[0];
+		entries[0] = entries[e];
+		entries[e] = swap;
+		refSiftDown(entries, 0, e, _refBuckets);
+	}
+	
+	// Bucket sizes, held in the displacements until each is placed
+	memset(_refDisp, 0, _refBuckets);
+	byte largest = 0;
+	for (e = 0; e < count; e++) {
+		byte *size = _refDisp + refHash(entries[e].key, 0) % _refBuckets;
+		if (*size < REF_MAX_DISP - 1) (*size)++;
+		if (*size > largest) largest = *size;
+	}
+	
+	// Then the biggest buckets placed first, while most slots are free
+	boolean placed = true;
+	memset(_refIndex, REF_EMPTY, _refSlots * 2);
+	for (byte size = largest; size > 0 && placed; size--) {
+		unsigned int first = 0;
+		for (unsigned int bucket = 0; bucket < _refBuckets && placed; bucket++) {
+			while (first < count && refHash(entries[first].key, 0) % _refBuckets < bucket) first++;
+			if (_refDisp[bucket] != size) continue;
+			unsigned int num = 0;
+			while (first + num < count && refHash(entries[first + num].key, 0) % _refBuckets == bucket) num++;
+			
+			byte disp = 0;
+			while (!refPlace(entries + first, num, disp, _refIndex, _refSlots)) {
+				if (++disp == REF_MAX_DISP) {
+					placed = false;
+					break;
+				}
+			}
+			_refDisp[bucket] = disp | REF_MAX_DISP;													// Top bit - bucket done, not to be seen as a size
+		}
+	}
+	arena.release(arenaMark);
+	if (!placed) {
+		_refCount = 0;
+		Serial.println("HA_root: ref index failed");
+		return false;
+	}
+	for (unsigned int bucket = 0; bucket < _refBuckets; bucket++) _refDisp[bucket] &= ~REF_MAX_DISP;
+	
+	_refCount = count;
+	_refStale = false;
+	return true;
+}
+
+boolean HA_root::findRef(char *ref, byte *entType, byte *entNum) {
+	int len = strlen(ref);
+	
+	if (ref[0] == 'v' && len >= 5) {																	// Variable - vB.03
+		switch (ref[1]) {
+			case 'B':		*entType = VAR_TYPE_BYTE; break;
+			case 'I':		*entType = VAR_TYPE_2BYTE; break;
+			case 'R':		*entType = VAR_TYPE_RFID; break;
+			default:		return false;
+		}
+		int varNum = atoi(ref + 3);
+		*entNum = varNum;
+		return varNum < _numEnts[*entType];
+	}
+	
+	if (len == 2) {																										// Zone - D1
+		for (byte zoneNum = 0; zoneNum < _numEnts[OBJ_TYPE_ZONE]; zoneNum++) {
+			if (entPtrs.ptrZone[zoneNum].get(VAL_REGION) == ref[0] && entPtrs.ptrZone[zoneNum].get(VAL_ZONE) + 0x30 == ref[1]) {
+				*entType = OBJ_TYPE_ZONE;
+				*entNum = zoneNum;
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	// Device - G1.03.xH2, read exactly as putRef would store it
+	if (len < 7 || strchr(REGIONCODES, ref[0]) == NULL) return false;
+	HA_device probe = HA_device();
+	byte devType = probe.putRef(ref);
+	char code[TYPE_CODE_LEN];
+	getDevTypeChar(devType, code);
+	if (strncmp(ref + 6, code, strlen(code)) != 0) return false;			// Not a device code - getDevTypeIdx gives 0 for those
+	unsigned long key = packRef(devType, probe.get(VAL_REGION_ZONE), probe.get(VAL_LOCATION), probe.get(VAL_DEVNUM));
+	
+	if (_refCount != 0 && !_refStale) {
+		byte *slot = _refIndex + 2 * (refHash(key, _refDisp[refHash(key, 0) % _refBuckets] + 1) % _refSlots);
+		if (slot[0] == REF_EMPTY || refKey(slot[0], slot[1]) != key) return false;
+		*entType = slot[0];
+		*entNum = slot[1];
+		return true;
+	}
+	
+	for (byte devNum = 0; devNum < _numEnts[devType]; devNum++) {			// No index - scan the type
+		if (refKey(devType, devNum) == key) {
+			*entType = devType;
+			*entNum = devNum;
+			return true;
+		}
+	}
+	return false;
+}
+
+
 // *************  Entities - device & variables  ********************
 
 boolean HA_root::createEntArray(byte entType, byte numEntities) {		// Finds space for array of entities
-	int classSize = 0;
+	entOps ops;
+	unsigned int arenaMark = arena.mark();			// To give back the array if its buffers don't fit
 
 	// Avoid duplicates
+	if (entType >= NUM_ENT_TYPES) {Serial.println("HA_root: bad Ent type"); return false;}
 	if (_numEnts[entType] != 0) {Serial.println("HA_root: dup Ent array"); return false;}
-		
-	switch (entType) {
-		case DEV_TYPE_TOUCH:			classSize = sizeof(HA_devTouch); break;
-		case DEV_TYPE_FIRE:				classSize = sizeof(HA_devFire); break;
-		case DEV_TYPE_HEAT:			  classSize = sizeof(HA_devHeat); break;
-		case DEV_TYPE_LUMINANCE:  classSize = sizeof(HA_devLuminance); break;
-		case DEV_TYPE_MOTION:			classSize = sizeof(HA_devMotion); break;
-		case DEV_TYPE_PRESENCE:		classSize = sizeof(HA_devPresence); break;
-		case DEV_TYPE_RFID:				classSize = sizeof(HA_devRFID); break;
-		case DEV_TYPE_OPEN:				classSize = sizeof(HA_devOpen); break;
-		case DEV_TYPE_5APWR:			classSize = sizeof(HA_dev5APower); break;
-		case DEV_TYPE_13APWR:			classSize = sizeof(HA_dev13APower); break;
-		case DEV_TYPE_LOCK:				classSize = sizeof(HA_devLock); break;
-		case DEV_TYPE_LIGHT:			classSize = sizeof(HA_devLight); break;
-		case DEV_TYPE_RELAY:			classSize = sizeof(HA_devRelay); break;
-		case VAR_TYPE_BYTE:				classSize = sizeof(HA_varByte); break;
-		case VAR_TYPE_2BYTE:			classSize = sizeof(HA_var2Byte); break;
-		case VAR_TYPE_RFID:				classSize = sizeof(HA_varRFID); break;
-		case OBJ_TYPE_ZONE:				classSize = sizeof(HA_zone); break;
-	}
-	
-	_entPtrs[entType] = malloc(classSize * numEntities);					// Get some space
+	
+	getOps(entType, &ops);
+	int classSize = ops.classSize;
+	
+	_entPtrs[entType] = arena.alloc(classSize * numEntities);			// Get some space
 	
 	if (_entPtrs[entType] != NULL) {														// Attach arrray of devices to root pointer
-		_numEnts[entType] = numEntities;
-		_classSize[entType] = classSize;
-		
 		if (entType == DEV_TYPE_RFID || entType == VAR_TYPE_RFID) {		// If multi-byte entity, get space for buffer
-			unsigned int bufLen = entBufLen(entType) * numEntities * ((entType == DEV_TYPE_RFID) ? 2 : 1);  
-			byte *space = (byte*)malloc(bufLen);		
+			unsigned int bufLen = (entType == DEV_TYPE_RFID) ? HA_devRFID::_bufLen * 2 : HA_varRFID::_bufLen;		// Per entity - devices keep current & previous
+			byte *space = (byte*)arena.alloc(bufLen * numEntities);		
 		  if (space != NULL) {
 			  switch (entType) {																
-					case DEV_TYPE_RFID:		for (int i = 0; i < numEntities; i++) entPtrs.ptrDevRFID[i].init(space + (i * bufLen * 2)); break;
+					case DEV_TYPE_RFID:		for (int i = 0; i < numEntities; i++) entPtrs.ptrDevRFID[i].init(space + (i * bufLen)); break;
 					case VAR_TYPE_RFID:		for (int i = 0; i < numEntities; i++) entPtrs.ptrVarRFID[i].init(space + (i * bufLen)); break;
 				}
   		}
-  		else {		// No space for values - free array space
-	  		free(_entPtrs[entType]);
-	  		_numEnts[entType] = 0;
+  		else {		// No space for values - give back array space
+	  		arena.release(arenaMark);
+	  		_entPtrs[entType] = NULL;
 	  		return false;
   		}
 		}
+		_dirtyBits[entType] = (byte*)arena.alloc(NUM_DIRTY_VIEWS * ((numEntities + 7) / 8));		// Change tracking, all views
+		if (_dirtyBits[entType] == NULL) {
+			arena.release(arenaMark);
+			_entPtrs[entType] = NULL;
+			return false;
+		}
+#ifdef HA_COLUMNS
+		if (ops.column != COL_NONE && !createColumns(entType, ops.column, numEntities)) {
+			arena.release(arenaMark);
+			_entPtrs[entType] = NULL;
+			_dirtyBits[entType] = NULL;
+			return false;
+		}
+#endif
+		_numEnts[entType] = numEntities;
+		_classSize[entType] = classSize;
+		if (entType < NUM_DEV_TYPES) _refStale = true;
+		_depStale = _orderStale = true;
+		_entGet[entType] = ops.get;
+		_entPut[entType] = ops.put;
+		
 		for (int i = 0; i < numEntities; i++) putEnt(entType, i, VAL_DEVIDX, i);				// Initialise device number
+		if (entType < NUM_DEV_TYPES) for (int i = 0; i < numEntities; i++) putEnt(entType, i, VAL_DEVTYPE, entType);		// So each device finds its column and change bits
 		return true;
 	}
 	else {
@@ -111,6 +492,93 @@ boolean HA_root::createEntArray(byte entType, byte numEntities) {		// Finds spac
 	}
 }
 
+void HA_root::getOps(byte entType, entOps *ops) {
+	memcpy_P(ops, &ENT_OPS[entType], sizeof(entOps));
+}
+
+// *************  Change tracking - see DIRTY_ views in HA_root.h  ********************
+
+void HA_root::markDirty(byte entType, byte entNum) {		// Set in every view.  May be called from an ISR
+	byte *bits = _dirtyBits[entType];
+	if (bits == NULL || entNum >= _numEnts[entType]) return;
+	
+	byte stride = (_numEnts[entType] + 7) >> 3;
+	byte mask = _BV(entNum & 7);
+	byte oldSREG = SREG;
+	cli();
+	
+	bits += entNum >> 3;
+	for (byte view = 0; view < NUM_DIRTY_VIEWS; view++, bits += stride) {
+		*bits |= mask;
+		_dirtyTypes[view][entType >> 3] |= _BV(entType & 7);
+	}
+	
+	SREG = oldSREG;
+}
+
+boolean HA_root::nextDirty(byte view, byte *entType, byte *entNum) {
+	byte oldSREG = SREG;
+	cli();
+	
+	for (byte type = 0; type < NUM_ENT_TYPES; type++) {
+		if (!(_dirtyTypes[view][type >> 3] & _BV(type & 7))) continue;			// Nothing changed in this type
+		
+		byte stride = (_numEnts[type] + 7) >> 3;
+		byte *bits = _dirtyBits[type] + view * stride;
+		for (byte i = 0; i < stride; i++) {
+			if (bits[i] == 0) continue;
+			
+			byte bit = 0;
+			while (!(bits[i] & _BV(bit))) bit++;
+			bits[i] &= ~_BV(bit);
+			*entType = type;
+			*entNum = (i << 3) + bit;
+			SREG = oldSREG;
+			return true;
+		}
+		_dirtyTypes[view][type >> 3] &= ~_BV(type & 7);								// All harvested
+	}
+	
+	SREG = oldSREG;
+	return false;
+}
+
+byte HA_root::harvestDirty(byte view, byte entType, byte *bits, byte maxBytes) {		// Bit n of the copy is entity n
+	if (!(_dirtyTypes[view][entType >> 3] & _BV(entType & 7))) return 0;
+	
+	byte stride = (_numEnts[entType] + 7) >> 3;
+	byte *viewBits = _dirtyBits[entType] + view * stride;
+	if (stride > maxBytes) stride = maxBytes;
+	
+	byte oldSREG = SREG;
+	cli();
+	memcpy(bits, viewBits, stride);
+	memset(viewBits, 0, stride);
+	if (stride == ((_numEnts[entType] + 7) >> 3)) _dirtyTypes[view][entType >> 3] &= ~_BV(entType & 7);		// Unless some left for next time
+	SREG = oldSREG;
+	
+	return stride;
+}
+
+boolean HA_root::anyDirty(byte view) {
+	for (byte i = 0; i < sizeof(_dirtyTypes[view]); i++) if (_dirtyTypes[view][i]) return true;
+	return false;
+}
+
+#ifdef HA_COLUMNS
+boolean HA_root::createColumns(byte devType, byte column, byte numDevs) {		// Current & previous readings for all devices of the type
+	unsigned int colSize = (column == COL_BIT) ? (numDevs + 7) / 8 : numDevs * sizeof(unsigned int);
+	byte *space = (byte*)arena.alloc(colSize * 2);
+	
+	if (space == NULL) return false;
+	
+	_colKind[devType] = column;
+	_colCurr[devType] = space;
+	_colPrev[devType] = space + colSize;
+	return true;
+}
+#endif
+
 byte HA_root::numEnts(byte entType) {
 	return _numEnts[entType];
 }
@@ -119,6 +587,16 @@ byte HA_root::classSize(byte entType) {
 	return _classSize[entType];
 }
 
+byte HA_root::entColumn(byte entType) {
+	return pgm_read_byte(&ENT_OPS[entType].column);
+}
+
+boolean HA_root::isActor(byte entType) {
+	entOps ops;
+	getOps(entType, &ops);
+	return ops.setDev != NULL;
+}
+
 byte HA_root::entBufLen(byte entType) {
 	switch (entType) {
 		case DEV_TYPE_RFID:				return entPtrs.ptrDevRFID[0].bufLen(); 
@@ -131,25 +609,10 @@ void HA_root::putEnt(byte entType, byte entNum, byte valType, unsigned int val)
 	// Check bounds
 	if (_numEnts[entType] < entNum) Serial.println("HA_root: put OO bounds");
 	
-	switch (entType) {
-		case DEV_TYPE_TOUCH:			entPtrs.ptrTouch[entNum].put(valType, val); break;
-		case DEV_TYPE_FIRE:				entPtrs.ptrFire[entNum].put(valType, val); break;
-		case DEV_TYPE_HEAT:			  entPtrs.ptrHeat[entNum].put(valType, val); break;
-		case DEV_TYPE_LUMINANCE:  entPtrs.ptrLuminance[entNum].put(valType, val); break;
-		case DEV_TYPE_MOTION:			entPtrs.ptrMotion[entNum].put(valType, val); break;
-		case DEV_TYPE_PRESENCE:		entPtrs.ptrPresence[entNum].put(valType, val); break;
-		case DEV_TYPE_RFID:				entPtrs.ptrDevRFID[entNum].put(valType, val); break;		// Only underlying HA_device data available
-		case DEV_TYPE_OPEN:				entPtrs.ptrOpen[entNum].put(valType, val); break;
-		case DEV_TYPE_5APWR:			entPtrs.ptr5APower[entNum].put(valType, val); break;
-		case DEV_TYPE_13APWR:			entPtrs.ptr13APower[entNum].put(valType, val); break;
-		case DEV_TYPE_LOCK:				entPtrs.ptrLock[entNum].put(valType, val); break;
-		case DEV_TYPE_LIGHT:			entPtrs.ptrLight[entNum].put(valType, val); break;
-		case DEV_TYPE_RELAY:			entPtrs.ptrRelay[entNum].put(valType, val); break;
-		case VAR_TYPE_BYTE:			  entPtrs.ptrByte[entNum].put(val); break;
-		case VAR_TYPE_2BYTE:			entPtrs.ptr2Byte[entNum].put(val); break;		
-		case VAR_TYPE_RFID:				break;		// No underlying data for multi-byte variable
-		case OBJ_TYPE_ZONE:				entPtrs.ptrZone[entNum].put(valType, val); break;		
-	}
+	void *ent = entAddr(entType, entNum);
+	if (entType < NUM_DEV_TYPES && (valType == VAL_REGION || valType == VAL_ZONE || valType == VAL_REGION_ZONE || valType == VAL_LOCATION || valType == VAL_DEVNUM)) _refStale = true;	// Parts of its ref
+	if (entType >= NUM_DEV_TYPES && entType != OBJ_TYPE_ZONE && (valType == VAL_PUSH || valType == VAL_CURR) && _entGet[entType](ent, VAL_CURR) != val) markDirty(entType, entNum);	// Devices and zones mark their own
+	_entPut[entType](ent, valType, val);
 }
 
 unsigned int HA_root::getEnt(byte entType, byte entNum, byte valType) {								// Not suitable for multi-byte buffers
@@ -161,47 +624,17 @@ unsigned int HA_root::getEnt(byte entType, byte entNum, byte valType) {								/
 		Serial.println(entNum);
 	}
 	
-	switch (entType) {
-		case DEV_TYPE_TOUCH:			return entPtrs.ptrTouch[entNum].get(valType); 
-		case DEV_TYPE_FIRE:				return entPtrs.ptrFire[entNum].get(valType); 
-		case DEV_TYPE_HEAT:			  return entPtrs.ptrHeat[entNum].get(valType); 
-		case DEV_TYPE_LUMINANCE:  return entPtrs.ptrLuminance[entNum].get(valType); 
-		case DEV_TYPE_MOTION:			return entPtrs.ptrMotion[entNum].get(valType); 
-		case DEV_TYPE_PRESENCE:		return entPtrs.ptrPresence[entNum].get(valType); 
-		case DEV_TYPE_RFID:				return entPtrs.ptrDevRFID[entNum].get(valType); 			// Only underlying HA_device data available
-		case DEV_TYPE_OPEN:				return entPtrs.ptrOpen[entNum].get(valType); 
-		case DEV_TYPE_5APWR:			return entPtrs.ptr5APower[entNum].get(valType); 
-		case DEV_TYPE_13APWR:			return entPtrs.ptr13APower[entNum].get(valType); 
-		case DEV_TYPE_LOCK:				return entPtrs.ptrLock[entNum].get(valType); 
-		case DEV_TYPE_LIGHT:			return entPtrs.ptrLight[entNum].get(valType); 
-		case DEV_TYPE_RELAY:			return entPtrs.ptrRelay[entNum].get(valType); 
-		case VAR_TYPE_BYTE:				return entPtrs.ptrByte[entNum].get(); 
-		case VAR_TYPE_2BYTE:			return entPtrs.ptr2Byte[entNum].get(); 
-		case VAR_TYPE_RFID:				break;		// No underlying data for multi-byte variable
-		case OBJ_TYPE_ZONE:				return entPtrs.ptrZone[entNum].get(valType);
-		
-	}
+	return _entGet[entType](entAddr(entType, entNum), valType);
 }
 
 byte HA_root::putRef(byte entType, byte entNum, char *device) {
 	// Check bounds
 	if (_numEnts[entType] < entNum) Serial.println("Putref: put OO bounds");
 	
-	switch (entType) {
-		case DEV_TYPE_TOUCH:			return entPtrs.ptrTouch[entNum].putRef(device); 
-		case DEV_TYPE_FIRE:				return entPtrs.ptrFire[entNum].putRef(device); 
-		case DEV_TYPE_HEAT:			  return entPtrs.ptrHeat[entNum].putRef(device); 
-		case DEV_TYPE_LUMINANCE:  return entPtrs.ptrLuminance[entNum].putRef(device); 
-		case DEV_TYPE_MOTION:			return entPtrs.ptrMotion[entNum].putRef(device); 
-		case DEV_TYPE_PRESENCE:		return entPtrs.ptrPresence[entNum].putRef(device); 
-		case DEV_TYPE_RFID:				return entPtrs.ptrDevRFID[entNum].putRef(device); 	
-		case DEV_TYPE_OPEN:				return entPtrs.ptrOpen[entNum].putRef(device); 
-		case DEV_TYPE_5APWR:			return entPtrs.ptr5APower[entNum].putRef(device); 
-		case DEV_TYPE_13APWR:			return entPtrs.ptr13APower[entNum].putRef(device); 
-		case DEV_TYPE_LOCK:				return entPtrs.ptrLock[entNum].putRef(device); 
-		case DEV_TYPE_LIGHT:			return entPtrs.ptrLight[entNum].putRef(device); 
-		case DEV_TYPE_RELAY:			return entPtrs.ptrRelay[entNum].putRef(device);  		
-	}
+	entOps ops;
+	getOps(entType, &ops);
+	_refStale = true;
+	return ops.putRef ? ops.putRef(entAddr(entType, entNum), device) : 0;
 }
  
  
@@ -209,48 +642,88 @@ void HA_root::getRef(byte entType, byte entNum, char *device) {
 	// Check bounds
 	if (_numEnts[entType] < entNum) Serial.println("Getref: put OO bounds");
 	
-	switch (entType) {
-		case DEV_TYPE_TOUCH:			entPtrs.ptrTouch[entNum].getRef(device); break;
-		case DEV_TYPE_FIRE:				entPtrs.ptrFire[entNum].getRef(device); break;
-		case DEV_TYPE_HEAT:			  entPtrs.ptrHeat[entNum].getRef(device); break;
-		case DEV_TYPE_LUMINANCE:  entPtrs.ptrLuminance[entNum].getRef(device); break;
-		case DEV_TYPE_MOTION:			entPtrs.ptrMotion[entNum].getRef(device); break;
-		case DEV_TYPE_PRESENCE:		entPtrs.ptrPresence[entNum].getRef(device); break;
-		case DEV_TYPE_RFID:				entPtrs.ptrDevRFID[entNum].getRef(device); break;	
-		case DEV_TYPE_OPEN:				entPtrs.ptrOpen[entNum].getRef(device); break;
-		case DEV_TYPE_5APWR:			entPtrs.ptr5APower[entNum].getRef(device); break;
-		case DEV_TYPE_13APWR:			entPtrs.ptr13APower[entNum].getRef(device); break;
-		case DEV_TYPE_LOCK:				entPtrs.ptrLock[entNum].getRef(device); break;
-		case DEV_TYPE_LIGHT:			entPtrs.ptrLight[entNum].getRef(device); break;
-		case DEV_TYPE_RELAY:			entPtrs.ptrRelay[entNum].getRef(device); break;
-		case VAR_TYPE_BYTE:			  device[0] = 'v'; device[1] = 'B'; device[2] = '.'; device[3] = entNum / 10 + 0x30; device[4] = entNum % 10 + 0x30; device[5] = 0x00; break;
-		case VAR_TYPE_2BYTE:			device[0] = 'v'; device[1] = 'I'; device[2] = '.'; device[3] = entNum / 10 + 0x30; device[4] = entNum % 10 + 0x30; device[5] = 0x00; break;
-		case VAR_TYPE_RFID:				device[0] = 'v'; device[1] = 'R'; device[2] = '.'; device[3] = entNum / 10 + 0x30; device[4] = entNum % 10 + 0x30; device[5] = 0x00; break;
-		case OBJ_TYPE_ZONE:				device[0] = entPtrs.ptrZone[entNum].get(VAL_REGION); device[1] = entPtrs.ptrZone[entNum].get(VAL_ZONE) + 0x30; device[2] = 0x00; break;
-	}  
+	entOps ops;
+	getOps(entType, &ops);
+	if (ops.getRef) ops.getRef(entAddr(entType, entNum), entNum, device);
 }
 
 void HA_root::getSnapshot(byte entType, byte entNum) {
 	// Check bounds
 	if (_numEnts[entType] < entNum) Serial.println("Getref: put OO bounds");
 	
-	switch (entType) {
-		case DEV_TYPE_TOUCH:			entPtrs.ptrTouch[entNum].getSnapshot(); break;
-		case DEV_TYPE_FIRE:				entPtrs.ptrFire[entNum].getSnapshot(); break;
-		case DEV_TYPE_HEAT:			  entPtrs.ptrHeat[entNum].getSnapshot(); break;
-		case DEV_TYPE_LUMINANCE:  entPtrs.ptrLuminance[entNum].getSnapshot(); break;
-		case DEV_TYPE_MOTION:			entPtrs.ptrMotion[entNum].getSnapshot(); break;
-		case DEV_TYPE_PRESENCE:		entPtrs.ptrPresence[entNum].getSnapshot(); break;
-		case DEV_TYPE_RFID:				entPtrs.ptrDevRFID[entNum].getSnapshot(); break;	
-		case DEV_TYPE_OPEN:				entPtrs.ptrOpen[entNum].getSnapshot(); break;
-		case DEV_TYPE_5APWR:			entPtrs.ptr5APower[entNum].getSnapshot(); break;
-		case DEV_TYPE_13APWR:			entPtrs.ptr13APower[entNum].getSnapshot(); break;
-		case DEV_TYPE_LOCK:				entPtrs.ptrLock[entNum].getSnapshot(); break;
-		case DEV_TYPE_LIGHT:			entPtrs.ptrLight[entNum].getSnapshot(); break;
-		case DEV_TYPE_RELAY:			entPtrs.ptrRelay[entNum].getSnapshot(); break;
-		case OBJ_TYPE_ZONE:				entPtrs.ptrZone[entNum].getSnapshot(); break; 
-		default: Serial.println();
-	}  
+	entOps ops;
+	getOps(entType, &ops);
+	if (ops.getSnapshot) ops.getSnapshot(entAddr(entType, entNum)); 
+	else Serial.println();
+}
+
+
+
+// *************  Snapshot streams - see HA_root.h  ********************
+
+void HA_root::snapBegin(HA_snapCursor *cursor, byte entType, byte format) {
+	cursor->entType = (entType == SNAP_ALL) ? 0 : entType;
+	cursor->entNum = 0;
+	cursor->onlyType = entType;
+	cursor->format = format;
+	cursor->count = 0;
+	cursor->done = false;
+}
+
+boolean HA_root::snapFind(HA_snapCursor *cursor) {						// Move the cursor to an entity that exists, if any are left
+	while (cursor->entType < NUM_ENT_TYPES && cursor->entNum >= _numEnts[cursor->entType]) {
+		if (cursor->onlyType != SNAP_ALL) return false;
+		cursor->entType++;
+		cursor->entNum = 0;
+	}
+	return cursor->entType < NUM_ENT_TYPES;
+}
+
+unsigned int HA_root::snapNext(HA_snapCursor *cursor, byte *buffer, unsigned int maxLen) {
+	unsigned int len = 0;
+	boolean json = (cursor->format == SNAP_JSON);
+	
+	if (cursor->done || maxLen < SNAP_JSON_MAX + 2) return 0;
+	if (json && cursor->count == 0) buffer[len++] = '[';
+	
+	while (snapFind(cursor)) {
+		byte entType = cursor->entType;
+		byte entNum = cursor->entNum;
+		unsigned int val = getEnt(entType, entNum, VAL_CURR);											// Each type's own reading - a zone's is its occupancy
+		byte status = (entType < NUM_DEV_TYPES) ? getEnt(entType, entNum, VAL_STATUS) : 0;
+		
+		if (json) {
+			char code[TYPE_CODE_LEN];
+			if (len + SNAP_JSON_MAX + 1 > maxLen) break;												// Leaves room for the closing ]
+			getDevTypeChar(entType, code);
+			len += sprintf((char*)buffer + len, "%s{\"t\":\"%s\",\"n\":%d,\"v\":%u,\"s\":%d}", cursor->count ? "," : "", code, entNum, val, status);
+		}
+		else {
+			if (len + SNAP_RECORD_LEN > maxLen) break;
+			buffer[len++] = entType;
+			buffer[len++] = entNum;
+			buffer[len++] = lowByte(val);
+			buffer[len++] = highByte(val);
+			buffer[len++] = status;
+		}
+		cursor->count++;
+		cursor->entNum++;
+	}
+	
+	if (!snapFind(cursor)) {
+		if (json) buffer[len++] = ']';
+		cursor->done = true;
+	}
+	return len;
+}
+
+unsigned int HA_root::snapStream(Print &out, byte *buffer, unsigned int bufLen, byte entType, byte format) {
+	HA_snapCursor cursor;
+	unsigned int len;
+	
+	snapBegin(&cursor, entType, format);
+	while ((len = snapNext(&cursor, buffer, bufLen)) > 0) out.write(buffer, len);
+	return cursor.count;
 }
 
 boolean HA_root::logChange(byte entType, byte entNum, byte val) {
@@ -265,7 +738,7 @@ void HA_root::putEnt(byte entType, byte entNum, byte valType, void *valPtr) {		/
 
 	switch (entType) {
 		case DEV_TYPE_RFID:				entPtrs.ptrDevRFID[entNum].put(valType, (byte*)valPtr); break;
-		case VAR_TYPE_RFID:				entPtrs.ptrVarRFID[entNum].put((byte*)valPtr); break;
+		case VAR_TYPE_RFID:				entPtrs.ptrVarRFID[entNum].put((byte*)valPtr); markDirty(entType, entNum); break;
 		default:									putEnt(entType, entNum, valType, *(unsigned int*)valPtr);
 	}
 }
@@ -323,22 +796,10 @@ void HA_root::initDev(byte devType, byte devNum, byte channel, byte pin, byte ha
 		Serial.println(devNum);
 	}
 	
-	switch (devType) {
-		case DEV_TYPE_TOUCH:			entPtrs.ptrTouch[devNum].initDev(devNum, channel, pin, handler); break;
-		case DEV_TYPE_FIRE:				entPtrs.ptrFire[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_HEAT:			  entPtrs.ptrHeat[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_LUMINANCE:  entPtrs.ptrLuminance[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_MOTION:			entPtrs.ptrMotion[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_PRESENCE:		entPtrs.ptrPresence[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_RFID:				entPtrs.ptrDevRFID[devNum].initDev(devNum, channel, pin, handler); break; 	
-		case DEV_TYPE_OPEN:				entPtrs.ptrOpen[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_5APWR:			entPtrs.ptr5APower[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_13APWR:			entPtrs.ptr13APower[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_LOCK:				entPtrs.ptrLock[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_LIGHT:			entPtrs.ptrLight[devNum].initDev(devNum, channel, pin, handler); break; 
-		case DEV_TYPE_RELAY:			entPtrs.ptrRelay[devNum].initDev(devNum, channel, pin, handler); break; 
-		default:									Serial.println("Err: initDev");		
-	}
+	entOps ops;
+	getOps(devType, &ops);
+	if (ops.initDev) ops.initDev(entAddr(devType, devNum), devNum, channel, pin, handler);
+	else Serial.println("Err: initDev");
 };
 
 void HA_root::resetDev(byte devType, byte devNum) {
@@ -367,31 +828,20 @@ void HA_root::readDev(byte devType, byte devNum) {						// Sensors
 	// Check bounds
 	if (_numEnts[devType] < devNum) Serial.println("readDev: OO bounds");
 	
-	switch (devType) {
-		case DEV_TYPE_TOUCH:			entPtrs.ptrTouch[devNum].readDev(); break;
-		case DEV_TYPE_FIRE:				entPtrs.ptrFire[devNum].readDev(); break; 
-		case DEV_TYPE_HEAT:			  entPtrs.ptrHeat[devNum].readDev(); break; 
-		case DEV_TYPE_LUMINANCE:  entPtrs.ptrLuminance[devNum].readDev(); break; 
-		case DEV_TYPE_MOTION:			entPtrs.ptrMotion[devNum].readDev(devNum); break; 
-		case DEV_TYPE_PRESENCE:		entPtrs.ptrPresence[devNum].readDev(); break; 
-		case DEV_TYPE_RFID:				entPtrs.ptrDevRFID[devNum].readDev(); break; 	
-		case DEV_TYPE_OPEN:				entPtrs.ptrOpen[devNum].readDev(); break;  
-		default:									Serial.println("Err: readDev");		
-	}
+	entOps ops;
+	getOps(devType, &ops);
+	if (ops.readDev) ops.readDev(entAddr(devType, devNum), devNum);
+	else Serial.println("Err: readDev");
 };
 
 void HA_root::setDev(byte devType, byte devNum, byte val) {			// Actors
 	// Check bounds
 	if (_numEnts[devType] < devNum) Serial.println("setDev: OO bounds");
 	
-	switch (devType) { 
-		case DEV_TYPE_5APWR:			entPtrs.ptr5APower[devNum].setDev(val); break; 
-		case DEV_TYPE_13APWR:			entPtrs.ptr13APower[devNum].setDev(val); break; 
-		case DEV_TYPE_LOCK:				entPtrs.ptrLock[devNum].setDev(val); break; 
-		case DEV_TYPE_LIGHT:			entPtrs.ptrLight[devNum].setDev(val); break; 
-		case DEV_TYPE_RELAY:			entPtrs.ptrRelay[devNum].setDev(val); break; 
-		default:									Serial.println("Err: setDev");		
-	}
+	entOps ops;
+	getOps(devType, &ops);
+	if (ops.setDev) ops.setDev(entAddr(devType, devNum), val);
+	else Serial.println("Err: setDev");
 };
 
 void HA_root::processDevInt(byte devType, byte devNum, byte alertingPin) {
@@ -436,7 +886,7 @@ boolean HA_root::createChanArray(byte numChans) {		// Finds space for array of c
 	// Avoid duplicates
 	if (_numChannels != 0) {Serial.println("HA_root: dup Chan array"); return false;}
 	
-	ptrChannel = (HA_channel*)malloc(classSize * numChans);					// Get some space
+	ptrChannel = (HA_channel*)arena.alloc(classSize * numChans);			// Get some space
 	
 	if (ptrChannel != NULL) {														// Attach array of channels to root pointer
 		_numChannels = numChans;
@@ -493,7 +943,7 @@ boolean HA_root::createEvalArray(byte numEvals) {		// Finds space for array of e
 	// Avoid duplicates
 	if (_numEvals != 0) {Serial.println("HA_root: dup Eval array"); return false;}
 	
-	ptrEvaluation = (HA_evaluation*)malloc(classSize * numEvals);					// Get some space
+	ptrEvaluation = (HA_evaluation*)arena.alloc(classSize * numEvals);		// Get some space
 	
 	if (ptrEvaluation != NULL) {														// Attach arrray of evaluations to root pointer
 		_numEvals = numEvals;
@@ -510,22 +960,34 @@ byte HA_root::numEvals() {
 }
 
 void HA_root::putEval(byte evalNum, byte valType, byte val) {
-	if (_numEvals <= evalNum) Serial.print("Err: putEval ");
+	if (_numEvals <= evalNum || _evalTable != NULL) Serial.print("Err: putEval ");
 	else ptrEvaluation[evalNum].put(valType, val); 
+	_evalStale = _depStale = _orderStale = true;
 }
 
 void HA_root::putEval(byte evalNum, byte valCalc, byte valAType, byte valA, byte valExp, byte valBType, byte valB) {
-	if (_numEvals <= evalNum) Serial.print("Err: putEval ");
+	if (_numEvals <= evalNum || _evalTable != NULL) Serial.print("Err: putEval ");
 	else ptrEvaluation[evalNum].put(valCalc, valAType, valA, valExp, valBType, valB);
+	_evalStale = _depStale = _orderStale = true;
 }
 
 byte HA_root::getEval(byte evalNum, byte valType) {
 	if (_numEvals <= evalNum) Serial.print("Err: getEval ");
+	else if (_evalTable != NULL) {
+		HA_evaluation eval;
+		memcpy_P(&eval, _evalTable + evalNum * CONFIG_EVAL_LEN, CONFIG_EVAL_LEN);
+		return eval.get(valType);
+	}
 	else return ptrEvaluation[evalNum].get(valType); 
 }
 
 void HA_root::getEval(byte evalNum, byte *valCalc, byte *valAType, byte *valA, byte *valExp, byte *valBType, byte *valB) {
 	if (_numEvals <= evalNum) Serial.print("Err: getEval");
+	else if (_evalTable != NULL) {
+		HA_evaluation eval;
+		memcpy_P(&eval, _evalTable + evalNum * CONFIG_EVAL_LEN, CONFIG_EVAL_LEN);
+		eval.get(valCalc, valAType, valA, valExp, valBType, valB);
+	}
 	else ptrEvaluation[evalNum].get(valCalc, valAType, valA, valExp, valBType, valB);
 }
 	
@@ -538,7 +1000,7 @@ boolean HA_root::createArgListArray(byte numArgLists) {		// Finds space for arra
   // Avoid duplicates
 	if (_numArgLists != 0) {Serial.println("HA_root: dup ArgList array"); return false;}
 	
-	ptrArgList = (HA_argList*)malloc(classSize * numArgLists);					// Get some space
+	ptrArgList = (HA_argList*)arena.alloc(classSize * numArgLists);			// Get some space
 	
 	if (ptrArgList != NULL) {														// Attach arrray of evaluations to root pointer
 		_numArgLists = numArgLists;
@@ -555,22 +1017,28 @@ byte HA_root::numArgLists() {
 }
 
 boolean HA_root::createArgList(byte argListNum, byte numArgs) {
-	if (_numArgLists <= argListNum) Serial.print("Err: createArgList");
-	else return ptrArgList[argListNum].create(numArgs);
+	_evalStale = _depStale = _orderStale = true;
+	if (_numArgLists <= argListNum || _argTable != NULL) Serial.print("Err: createArgList");
+	else if (ptrArgList[argListNum].create(numArgs)) return true;
+	else if (arena.sealed()) arena.refuse(numArgs);			// Heap frozen by seal()
+	return false;
 }
 
 
 byte HA_root::numArgs(byte argListNum) {
+	if (_argTable != NULL) return pgm_read_word(&_argIndex[argListNum + 1]) - pgm_read_word(&_argIndex[argListNum]);
 	return ptrArgList[argListNum].numArgs();
 }
 
 void HA_root::putArg(byte argListNum, byte argNum, byte val) {
-	if (_numArgLists <= argListNum || numArgs(argListNum) <= argNum) Serial.print("Err: putArg ");
+	if (_numArgLists <= argListNum || numArgs(argListNum) <= argNum || _argTable != NULL) Serial.print("Err: putArg ");
 	else ptrArgList[argListNum].put(argNum, val); 
+	_evalStale = _depStale = _orderStale = true;
 }
 
 byte HA_root::getArg(byte argListNum, byte argNum) {
 	if (_numArgLists <= argListNum || numArgs(argListNum) <= argNum) Serial.print("Err: getArg ");
+	else if (_argTable != NULL) return pgm_read_byte(_argTable + pgm_read_word(&_argIndex[argListNum]) + argNum);
 	else return ptrArgList[argListNum].get(argNum); 
 }
 
@@ -593,35 +1061,55 @@ void HA_root::runEval(byte evalNum, unsigned int *evalPtr) {
 		Serial.print("Err: runEval1 - ");
 		Serial.println(evalNum);
 	}
+	else {
+		if (_memoOn) {
+			if (_memoStamp[evalNum] == _memoEpoch) {													// Already run in this pass
+				*evalPtr = _memoVal[evalNum];
+				_memoHits++;
+				return;
+			}
+			_memoMisses++;
+		}
+		if (!_evalStale) {																								// Compiled
+			*evalPtr = runCode(_evalEntry[evalNum]);
+			if (_memoOn) memoPut(evalNum, *evalPtr);
+			return;
+		}
+	}
   
   getEval(evalNum, &valCalc, &valAType, &valA, &valExp, &valBType, &valB);
   
   switch (valAType) {
   	case VAR_TYPE_RFID: 
-  	case DEV_TYPE_RFID: {
-	  		if (valBType != DEV_TYPE_RFID && valBType != VAR_TYPE_RFID) { Serial.println("Err: runEvalMulti"); return; }
-	
-				// Calc determines how to interpret valA - either current (always if VAR) or previous
-				byte *evalAPtr = getBufPtr(valAType, valA, (valAType == VAR_TYPE_RFID || valCalc == CALC_DEV) ? VAL_CURR : VAL_PREV);	// Pointer to current/previous buffer of device indexed by valA
-				
-				// valB always current
-				byte *evalBPtr = getBufPtr(valBType, valB, VAL_CURR);
-				
-				// Limited range of valid expressions for multi-byte
-				switch (valExp) {
-					case EXP_SET:			putEnt(valBType, valB, VAL_PUSH, evalAPtr); *evalPtr = 1; break;
-					case EXP_EQ:			*evalPtr = equal(valAType, evalAPtr, evalBPtr); break;
-					case EXP_NEQ: 		*evalPtr = !equal(valAType, evalAPtr, evalBPtr); break;
-					case EXP_NOOP:		break;				// Ignore
-					default:					Serial.println("Err: runEval2");		
-				}
-  		}
+  	case DEV_TYPE_RFID:
+  		if (!runMulti(valCalc, valAType, valA, valExp, valBType, valB, evalPtr)) return;
 			break;
   	default: {
   		unsigned int evalA = getValA(valCalc, valAType, valA); 	
 			runExp(valCalc, valAType, evalA, valExp, valBType, valB, evalPtr);
 		}
 	}		
+	if (_memoOn && evalNum < _numEvals) memoPut(evalNum, *evalPtr);
+}
+
+boolean HA_root::runMulti(byte valCalc, byte valAType, byte valA, byte valExp, byte valBType, byte valB, unsigned int *evalPtr) {		// Multi-byte (RFID) evaluation
+	if (valBType != DEV_TYPE_RFID && valBType != VAR_TYPE_RFID) { Serial.println("Err: runEvalMulti"); return false; }
+	
+	// Calc determines how to interpret valA - either current (always if VAR) or previous
+	byte *evalAPtr = getBufPtr(valAType, valA, (valAType == VAR_TYPE_RFID || valCalc == CALC_DEV) ? VAL_CURR : VAL_PREV);	// Pointer to current/previous buffer of device indexed by valA
+	
+	// valB always current
+	byte *evalBPtr = getBufPtr(valBType, valB, VAL_CURR);
+	
+	// Limited range of valid expressions for multi-byte
+	switch (valExp) {
+		case EXP_SET:			putEnt(valBType, valB, VAL_PUSH, evalAPtr); *evalPtr = 1; break;
+		case EXP_EQ:			*evalPtr = equal(valAType, evalAPtr, evalBPtr); break;
+		case EXP_NEQ: 		*evalPtr = !equal(valAType, evalAPtr, evalBPtr); break;
+		case EXP_NOOP:		break;				// Ignore
+		default:					Serial.println("Err: runEval2");		
+	}
+	return true;
 }
 
 
@@ -645,21 +1133,11 @@ unsigned int HA_root::getValA(byte valCalc, byte valAType, byte valA) {
 		case CALC_OFF: 			return !getEnt(valAType, valA, VAL_CURR) && getEnt(valAType, valA, VAL_PREV); 	// Curr vs prev of device indexed by valA
 		case CALC_YEAR: 		return year(); 																// Current year
 		case CALC_MONTH: 		return month();
-		case CALC_NOW: 			return dhmNow();															// Current time (in day, hour, month format)				
-		case CALC_AVG: {				// Average of entities in argument list indexed by valA
-			for (int i = 0; i < numArgs(valA); i++) evalA += getEnt(valAType, getArg(valA, i), VAL_CURR);
-			return evalA / numArgs(valA);
-		}
-		case CALC_AND: {				// Logical AND of entities in argument list indexed by valA
-			evalA = getEnt(valAType, getArg(valA, 0), VAL_CURR);
-			for (int i = 1; i < numArgs(valA) && evalA != 0; i++) evalA = getEnt(valAType, getArg(valA, i), VAL_CURR);            // For AND, quit on a false
-			return evalA;
-		}
-		case CALC_OR: {					// Logical OR of entities in argument list indexed by valA
-			evalA = getEnt(valAType, getArg(valA, 0), VAL_CURR);
-			for (int i = 1; i < numArgs(valA) && evalA == 0; i++) evalA = getEnt(valAType, getArg(valA, i), VAL_CURR);            // For OR, quit on a true
-			return evalA;
-		}
+		case CALC_NOW: 			return evalNow();															// Current time (in day, hour, month format)				
+		case CALC_AVG: 				// Average of entities in argument list indexed by valA
+		case CALC_AND: 				// Logical AND of entities in argument list indexed by valA
+		case CALC_OR: 				// Logical OR of entities in argument list indexed by valA
+			return aggregate(valCalc, valAType, valA);
 		case CALC_AVGV: {				// Average of evaluations in argument list indexed by valA
 			for (int i = 0; i < numArgs(valA); i++) {
 				runEval(getArg(valA, i), &temp);
@@ -683,6 +1161,53 @@ unsigned int HA_root::getValA(byte valCalc, byte valAType, byte valA) {
 	}
 }
 
+unsigned int HA_root::aggregate(byte valCalc, byte valAType, byte valA) {		// CALC_AVG, _AND or _OR of the entities in arg list valA
+	unsigned int evalA = 0;
+	
+#ifdef HA_COLUMNS
+	if (colKind(valAType) != COL_NONE) return colAggregate(valCalc, valAType, valA);
+#endif
+	switch (valCalc) {
+		case CALC_AVG:
+			for (int i = 0; i < numArgs(valA); i++) evalA += getEnt(valAType, getArg(valA, i), VAL_CURR);
+			return evalA / numArgs(valA);
+		case CALC_AND:
+			evalA = getEnt(valAType, getArg(valA, 0), VAL_CURR);
+			for (int i = 1; i < numArgs(valA) && evalA != 0; i++) evalA = getEnt(valAType, getArg(valA, i), VAL_CURR);            // For AND, quit on a false
+			return evalA;
+		case CALC_OR:
+			evalA = getEnt(valAType, getArg(valA, 0), VAL_CURR);
+			for (int i = 1; i < numArgs(valA) && evalA == 0; i++) evalA = getEnt(valAType, getArg(valA, i), VAL_CURR);            // For OR, quit on a true
+			return evalA;
+	}
+	return 0;
+}
+
+#ifdef HA_COLUMNS
+unsigned int HA_root::colAggregate(byte valCalc, byte devType, byte argListNum) {	// CALC_AVG, _AND or _OR read straight from the columns
+	if (_numArgLists <= argListNum) {Serial.println("Err: colAggregate"); return 0;}
+	
+	byte numArgs = this->numArgs(argListNum);
+	const byte *args = (_argTable != NULL) ? _argTable + pgm_read_word(&_argIndex[argListNum]) : ptrArgList[argListNum].args();
+	byte numDevs = _numEnts[devType];
+	unsigned int sum = 0, val = 0;
+	
+	for (byte i = 0; i < numArgs; i++) {							// Same results as getEnt in turn - AND stops on a false, OR on a true
+		byte devNum = (_argTable != NULL) ? pgm_read_byte(args + i) : args[i];
+		if (devNum >= numDevs) {Serial.println("HA_root: agg OO bounds"); return 0;}
+		
+		if (_colKind[devType] == COL_BIT) val = (((byte*)_colCurr[devType])[devNum >> 3] >> (devNum & 7)) & 1;
+		else val = ((unsigned int*)_colCurr[devType])[devNum];
+		
+		if (valCalc == CALC_AND && val == 0) return 0;
+		if (valCalc == CALC_OR && val != 0) return val;
+		sum += val;
+	}
+	
+	return (valCalc == CALC_AVG) ? sum / numArgs : val;
+}
+#endif
+
 void HA_root::runExp(byte valCalc, byte valAType, unsigned int evalA, byte valExp, byte valBType, byte valB, unsigned int *evalPtr) {
 	unsigned int evalB = getEnt(valBType, valB, VAL_CURR);
 	
@@ -718,46 +1243,7 @@ void HA_root::runExp(byte valCalc, byte valAType, unsigned int evalA, byte valEx
 		case EXP_LT:				*evalPtr =  evalA < evalB; break;
 		case EXP_BTW:
 		case EXP_NOT_BTW: {
-      unsigned int dhmADay = dhmGet(evalA, VAL_DAY), dhmBDay = dhmGet(evalB, VAL_DAY), timeNow = dhmMake(1,22,35);
-      boolean between = false, nextWeek = false;
-     
-      switch (dhmADay) {			// NB default case results in a return 
-        case 0:      dhmADay = 1; dhmBDay = 7; break;        			// Daily
-        case 8:      dhmADay = 2; dhmBDay = 5; break;        			// Mon-Thu
-        case 9:      dhmADay = 2; dhmBDay = 6; break;        			// Mon-Fri
-        case 10:     dhmADay = 7; dhmBDay = 1; nextWeek = true; break;        			// Weekend 
-        default:		 							// Specific days. dhmADay and dhmBDay already set - single test														
-					// Test if now is between the times stated - allow for going into next week
-					nextWeek = evalB < evalA;
-      		between = (nextWeek) ? timeNow >= evalA || timeNow <= evalB : timeNow >= evalA && timeNow <= evalB;
-    			*evalPtr = (valExp == EXP_BTW) ? between : !between;    // Swap logic if not between  
-      }
-
-      // Only here if range of days to be tested - cycle through same times each day
-      for (int i = dhmADay; i <= ((nextWeek) ? 7 : dhmBDay); i++) {
-	      dhmPut (&evalA, VAL_DAY, i);
-	      dhmPut (&evalB, VAL_DAY, i);
-	      
-	      // Test if time now is between the times stated; if so break out of loop
-	      if (timeNow >= evalA && timeNow <= evalB) {
-		      between = true;
-		      break;
-	      }
-      }
-      // Second loop needed if end date is next week
-      if (nextWeek) {
-      	for (int i = 1; i <= dhmBDay; i++) {
-	      	dhmPut (&evalA, VAL_DAY, i);
-	      	dhmPut (&evalB, VAL_DAY, i);
-	      
-		      // Test if time now is between the times stated; if so break out of loop
-		      if (timeNow >= evalA && timeNow <= evalB) {
-			      between = true;
-			      break;
-		      }
-	      }
-      }
-	      
+			boolean between = dhmBetween(evalNow(), evalA, evalB);
     	*evalPtr = (valExp == EXP_BTW) ? between : !between;    // Swap logic if not between  
       break;
     }
@@ -768,6 +1254,699 @@ void HA_root::runExp(byte valCalc, byte valAType, unsigned int evalA, byte valEx
 }
 
 
+// **************** Checking evaluations  ******************
+//
+// CALC_EVAL, _AVGV, _ANDV and _ORV let evaluations read each other, and runEval follows them by recursion - a loop
+// recurses until the stack meets the heap.  checkEvals looks at the evaluations as a graph before any are run: every
+// input exists, the arg lists that are read have args, and nothing reads itself through others (reported with the
+// loop, as "evals loop 3 > 7 > 12 > 3").  The walk is depth first, without recursion, and linear in evaluations and
+// args.  It leaves the deepest nesting, for evalDepth and evalStackUse, and an order with every evaluation after all
+// those it reads, for compileEvals, indexEvals and runChangedEvals.  loadConfig calls it; a sketch that builds its
+// evaluations by hand calls it once they are set.
+
+static const byte DEP_EVAL = 0xFF;								// evalInput type for an evaluation, rather than an entity
+static const byte EVAL_WALKING = 0xFF;						// checkEvals depth of an evaluation on the walk's path
+static const byte EVAL_NO_REF = 0xFF;						// evalRef past the last
+
+byte HA_root::evalRef(byte evalNum, byte refNum) {			// The evaluations that evalNum runs, one by one
+	byte valCalc = getEval(evalNum, VAL_CALC), valAType = getEval(evalNum, VAL_A_TYPE), valA = getEval(evalNum, VAL_A);
+	
+	if (valAType == DEV_TYPE_RFID || valAType == VAR_TYPE_RFID || valCalc < CALC_AVGV) return EVAL_NO_REF;
+	if (valCalc == CALC_EVAL) return (refNum == 0) ? valA : EVAL_NO_REF;
+	return (refNum < numArgs(valA)) ? getArg(valA, refNum) : EVAL_NO_REF;
+}
+
+boolean HA_root::checkEvals() {
+	byte entType, entNum, placed = 0;
+	
+	_orderStale = true;
+	_evalDepth = 0;
+	if (_numEvals == 0) return true;
+	
+	// Inputs
+	for (byte evalNum = 0; evalNum < _numEvals; evalNum++) {
+		byte valCalc = getEval(evalNum, VAL_CALC), valAType = getEval(evalNum, VAL_A_TYPE), valA = getEval(evalNum, VAL_A);
+		if (valAType != DEV_TYPE_RFID && valAType != VAR_TYPE_RFID && valCalc >= CALC_AVG && valCalc != CALC_EVAL
+				&& (valA >= _numArgLists || numArgs(valA) == 0)) {
+			Serial.print("HA_root: eval ");
+			Serial.print(evalNum);
+			Serial.print(" - no args in list ");
+			Serial.println(valA);
+			return false;
+		}
+		for (unsigned int i = 0; evalInput(evalNum, i, &entType, &entNum); i++) {
+			if ((entType == DEP_EVAL) ? entNum < _numEvals : entType < NUM_ENT_TYPES && entNum < _numEnts[entType]) continue;
+			Serial.print("HA_root: eval ");
+			Serial.print(evalNum);
+			Serial.print(" input OO bounds ");
+			Serial.println(i);
+			return false;
+		}
+	}
+	
+	if (_evalOrder == NULL) _evalOrder = (byte*)arena.alloc(_numEvals);
+	unsigned int arenaMark = arena.mark();
+	byte *depth = (byte*)arena.alloc(_numEvals);					// 0 until walked, then EVAL_WALKING, then 1 + the deepest it runs
+	byte *next = (byte*)arena.alloc(_numEvals);					// Ref to follow next at each level of the walk
+	if (_evalOrder == NULL || depth == NULL || next == NULL) {
+		arena.release(arenaMark);
+		Serial.println("HA_root: no space to check evals");
+		return false;
+	}
+	byte *path = _evalOrder + _numEvals - 1;						// Evaluation at each level, path[-level] - the end of the order, not yet placed
+	memset(depth, 0, _numEvals);
+	
+	for (byte start = 0; start < _numEvals; start++) {
+		if (depth[start] != 0) continue;
+		byte level = 0;
+		*path = start;
+		next[0] = 0;
+		depth[start] = EVAL_WALKING;
+		
+		for (;;) {
+			byte evalNum = path[-level], ref = evalRef(evalNum, next[level]++);
+			
+			if (ref != EVAL_NO_REF) {
+				if (depth[ref] == EVAL_WALKING) {									// Back to the path - a loop
+					byte from = level;
+					while (path[-from] != ref) from--;
+					Serial.print("HA_root: evals loop ");
+					for (byte i = from; i <= level; i++) {
+						Serial.print(path[-i]);
+						Serial.print(" > ");
+					}
+					Serial.println(ref);
+					arena.release(arenaMark);
+					return false;
+				}
+				if (depth[ref] == 0) {													// Down
+					path[-(++level)] = ref;
+					next[level] = 0;
+					depth[ref] = EVAL_WALKING;
+				}
+				continue;
+			}
+			
+			// All it runs are placed - so is this
+			byte deepest = 0;
+			for (byte i = 0; (ref = evalRef(evalNum, i)) != EVAL_NO_REF; i++) if (depth[ref] > deepest) deepest = depth[ref];
+			depth[evalNum] = (deepest < EVAL_WALKING - 1) ? deepest + 1 : EVAL_WALKING - 1;
+			if (depth[evalNum] > _evalDepth) _evalDepth = depth[evalNum];
+			_evalOrder[placed++] = evalNum;
+			if (level-- == 0) break;
+		}
+	}
+	
+	arena.release(arenaMark);
+	_orderStale = false;
+	return true;
+}
+
+byte HA_root::evalDepth() {
+	return _evalDepth;
+}
+
+unsigned int HA_root::evalStackUse() {
+	return _evalDepth * EVAL_FRAME;
+}
+
+
+// **************** Compiled evaluations  ******************
+//
+// compileEvals translates every evaluation into a run of bytecode in one program, and runEval then runs that instead of
+// decoding the HA_evaluation: entity reads name their type and number directly, the CALC_ and EXP_ switches are decided
+// once here, and nested evaluations are calls to their start in the program.  The interpreter in runCode is a loop over
+// a stack of EVAL_STACK readings and EVAL_MAX_DEPTH return addresses, both on the C stack and fixed in size - there is
+// no recursion.  CALC_ANDV and _ORV jump past the rest of their list on the first false or true, as the calls did.
+//
+// EXP_BTW and _NOT_BTW each have their own dhmSchedule, numbered in the code after the op.  It is worked out again only
+// when the from/to pair differs from the one it came from - a setting held in variables is compiled once, not at every
+// test, and a from/to that is worked out by other evaluations is still followed.
+//
+// Each evaluation's code leaves its result on the stack and ends in OP_RET.  A multi-byte (RFID) evaluation is one
+// OP_MULTI, which compares or copies the buffers in runMulti - it reads no other evaluation, so nothing in runCode goes
+// back into runEval.  Changing an evaluation or arg list afterwards sends runEval back to decoding each one until
+// compileEvals is called again.
+
+static const byte EVAL_STACK = EVAL_MAX_DEPTH + 4;		// Each suspended evaluation holds at most one reading, the running one three
+
+static const byte OP_RET 		= 0;				// End of evaluation - result on the stack
+static const byte OP_CURR 	= 1;				// type, num - push current reading
+static const byte OP_NCURR 	= 2;				// type, num - push !current
+static const byte OP_PREV 	= 3;				// type, num - push previous reading
+static const byte OP_ROFC 	= 4;				// type, num - push rate of change, as CALC_ROFC
+static const byte OP_ON 		= 5;				// type, num - push true if just turned on
+static const byte OP_OFF 		= 6;				// type, num - push true if just turned off
+static const byte OP_YEAR 	= 7;
+static const byte OP_MONTH 	= 8;
+static const byte OP_NOW 		= 9;
+static const byte OP_AGG 		= 10;				// calc, type, arg list - push CALC_AVG, _AND or _OR of entities
+static const byte OP_CALL 	= 11;				// address (LSB first), eval num - push result of the evaluation there
+static const byte OP_MULTI 	= 12;				// calc, A type, num, exp, B type, num - push result of a multi-byte (RFID) evaluation, as runMulti
+static const byte OP_JZ 		= 13;				// address - jump if top is false, leaving it
+static const byte OP_JNZ 		= 14;				// address - jump if top is true, leaving it
+static const byte OP_POP 		= 15;
+static const byte OP_PUSH 	= 16;				// value (LSB first)
+static const byte OP_SET 		= 17;				// type, num, flags - EXP_SET from the top, which becomes the result
+static const byte OP_UNSET 	= 18;				// type, num - EXP_UNSET
+static const byte OP_ADD 		= 19;				// Binary operators - second from top op top
+static const byte OP_SUB 		= 20;
+static const byte OP_MULT 	= 21;
+static const byte OP_DIV 		= 22;
+static const byte OP_AND 		= 23;
+static const byte OP_OR 		= 24;
+static const byte OP_EQ 		= 25;
+static const byte OP_NEQ 		= 26;
+static const byte OP_GT 		= 27;
+static const byte OP_LT 		= 28;
+static const byte OP_BTW 		= 29;				// schedule num
+static const byte OP_NOT_BTW = 30;				// schedule num
+
+static const byte SET_BINARY = 0x01;			// OP_SET flags - destination is on/off, so any true is 1
+static const byte SET_IF_TRUE = 0x02;			// Only set if true - valA is a single device
+
+static void emit(byte *code, unsigned int *len, byte val) {			// Sizing pass when code is NULL
+	if (code != NULL) code[*len] = val;
+	(*len)++;
+}
+
+static void emitWord(byte *code, unsigned int *len, unsigned int val) {
+	emit(code, len, lowByte(val));
+	emit(code, len, highByte(val));
+}
+
+boolean HA_root::compileEvals() {
+	unsigned int len = 0;
+	
+	_evalStale = true;
+	if (_numEvals == 0) return false;
+	if (_orderStale && !checkEvals()) return false;
+	if (_evalDepth > EVAL_MAX_DEPTH) {Serial.println("HA_root: evals nest too deep to compile"); return false;}
+	
+	// Where each evaluation starts - sized first, then written
+	if (_evalEntry == NULL) _evalEntry = (unsigned int*)arena.alloc(_numEvals * sizeof(unsigned int));
+	if (_evalEntry == NULL) {Serial.println("HA_root: no space to compile"); return false;}
+	_numEvalSched = 0;
+	for (byte evalNum = 0; evalNum < _numEvals; evalNum++) {
+		_evalEntry[evalNum] = len;
+		len += compileEval(evalNum, NULL);
+	}
+	if (_evalSched == NULL || _numEvalSched > _evalSchedLen) {
+		_evalSched = (_numEvalSched > 0) ? (evalSchedule*)arena.alloc(_numEvalSched * sizeof(evalSchedule)) : NULL;
+		if (_numEvalSched > 0 && _evalSched == NULL) {Serial.println("HA_root: no space to compile"); _evalSchedLen = 0; return false;}
+		_evalSchedLen = _numEvalSched;
+	}
+	for (byte schedNum = 0; schedNum < _numEvalSched; schedNum++) {		// As from 0 to 0, until first tested
+		_evalSched[schedNum].from = _evalSched[schedNum].to = 0;
+		dhmCompile(0, 0, &_evalSched[schedNum].schedule);
+	}
+	
+	if (_evalCode == NULL || len > _evalCodeLen) {								// Room from an earlier compile is used again
+		_evalCode = (byte*)arena.alloc(len);
+		if (_evalCode == NULL) {Serial.println("HA_root: no space to compile"); _evalCodeLen = 0; return false;}
+		_evalCodeLen = len;
+	}
+	_numEvalSched = 0;
+	for (byte evalNum = 0; evalNum < _numEvals; evalNum++) compileEval(evalNum, _evalCode + _evalEntry[evalNum]);
+	
+	_evalStale = false;
+	return true;
+}
+
+unsigned int HA_root::evalCodeLen() {
+	return _evalCodeLen + ((_evalEntry != NULL) ? _numEvals * sizeof(unsigned int) : 0) + _evalSchedLen * sizeof(evalSchedule);
+}
+
+unsigned int HA_root::compileEval(byte evalNum, byte *code) {		// Bytecode for one evaluation; returns its length.  Jumps are from code
+	unsigned int len = 0;
+	unsigned int start = (code != NULL) ? code - _evalCode : 0;
+	byte valCalc, valAType, valA, valExp, valBType, valB;
+	
+	getEval(evalNum, &valCalc, &valAType, &valA, &valExp, &valBType, &valB);
+	
+	if (valAType == DEV_TYPE_RFID || valAType == VAR_TYPE_RFID) {
+		emit(code, &len, OP_MULTI);
+		emit(code, &len, valCalc);
+		emit(code, &len, valAType);
+		emit(code, &len, valA);
+		emit(code, &len, valExp);
+		emit(code, &len, valBType);
+		emit(code, &len, valB);
+		emit(code, &len, OP_RET);
+		return len;
+	}
+	
+	// valA
+	switch (valCalc) {
+		case CALC_DEV: 		emit(code, &len, OP_CURR); break;
+		case CALC_NDEV: 	emit(code, &len, OP_NCURR); break;
+		case CALC_PDEV: 	emit(code, &len, OP_PREV); break;
+		case CALC_ROFC: 	emit(code, &len, OP_ROFC); break;
+		case CALC_ON: 		emit(code, &len, OP_ON); break;
+		case CALC_OFF: 		emit(code, &len, OP_OFF); break;
+		case CALC_YEAR: 	emit(code, &len, OP_YEAR); break;
+		case CALC_MONTH: 	emit(code, &len, OP_MONTH); break;
+		case CALC_NOW: 		emit(code, &len, OP_NOW); break;
+		case CALC_AVG:
+		case CALC_AND:
+		case CALC_OR:
+			emit(code, &len, OP_AGG);
+			emit(code, &len, valCalc);
+			break;
+	}
+	if (valCalc <= CALC_OFF || (valCalc >= CALC_AVG && valCalc <= CALC_OR)) {
+		emit(code, &len, valAType);
+		emit(code, &len, valA);
+	}
+	else if (valCalc >= CALC_AVGV) {											// Calls to other evaluations
+		byte numRefs = (valCalc == CALC_EVAL) ? 1 : numArgs(valA);
+		byte numCalls = (numRefs == 0 && valCalc != CALC_AVGV) ? 1 : numRefs;
+		unsigned int end = 0;
+		
+		if (valCalc == CALC_ANDV || valCalc == CALC_ORV) end = len + 8 * numCalls - 4;		// Where the list ends, for the jumps out of it - an OP_CALL each, with a jump and pop before all but the first
+		for (byte i = 0; i < numCalls; i++) {
+			byte ref = (valCalc == CALC_EVAL) ? valA : getArg(valA, i);
+			
+			if (i > 0 && end != 0) {
+				emit(code, &len, (valCalc == CALC_ANDV) ? OP_JZ : OP_JNZ);
+				emitWord(code, &len, start + end);
+				emit(code, &len, OP_POP);
+			}
+			emit(code, &len, OP_CALL);
+			emitWord(code, &len, _evalEntry[ref]);
+			emit(code, &len, ref);
+			if (i > 0 && valCalc == CALC_AVGV) emit(code, &len, OP_ADD);
+		}
+		if (valCalc == CALC_AVGV) {
+			if (numCalls == 0) {emit(code, &len, OP_PUSH); emitWord(code, &len, 0);}
+			emit(code, &len, OP_PUSH);
+			emitWord(code, &len, numRefs);
+			emit(code, &len, OP_DIV);
+		}
+	}
+	
+	// The expression, with valB
+	switch (valExp) {
+		case EXP_SET:	{
+			byte flags = ((BINARY_DEV >> valBType) & 1) ? SET_BINARY : 0;
+			if (valCalc <= CALC_OFF && valAType != VAR_TYPE_BYTE && valAType != VAR_TYPE_2BYTE && valAType != VAR_TYPE_RFID) flags |= SET_IF_TRUE;
+			emit(code, &len, OP_SET);
+			emit(code, &len, valBType);
+			emit(code, &len, valB);
+			emit(code, &len, flags);
+			break;
+		}
+		case EXP_UNSET:
+			emit(code, &len, OP_UNSET);
+			emit(code, &len, valBType);
+			emit(code, &len, valB);
+			break;
+		case EXP_NOOP:
+			break;
+		default:
+			if (valExp > EXP_NOT_BTW) break;
+			emit(code, &len, OP_CURR);
+			emit(code, &len, valBType);
+			emit(code, &len, valB);
+			emit(code, &len, OP_ADD + valExp - EXP_ADD);								// EXP_ADD to EXP_NOT_BTW are in the same order as their ops
+			if (valExp == EXP_BTW || valExp == EXP_NOT_BTW) emit(code, &len, _numEvalSched++);
+	}
+	
+	emit(code, &len, OP_RET);
+	return len;
+}
+
+unsigned int HA_root::runCode(unsigned int pc) {
+	unsigned int stack[EVAL_STACK];
+	unsigned int calls[EVAL_MAX_DEPTH];
+	byte callEvals[EVAL_MAX_DEPTH];																		// The evaluation each call runs, for the memo
+	byte sp = 0, depth = 0;
+	const byte *code = _evalCode;
+	
+	for (;;) {
+		byte op = code[pc++];
+		
+		if (op >= OP_ADD) {																							// Binary operators
+			unsigned int b = stack[--sp], a = stack[sp - 1];
+			switch (op) {
+				case OP_ADD:			a = a + b; break;
+				case OP_SUB:			a = a - b; break;
+				case OP_MULT:			a = a * b; break;
+				case OP_DIV:			a = a / b; break;
+				case OP_AND:			a = a && b; break;
+				case OP_OR:				a = a || b; break;
+				case OP_EQ:				a = a == b; break;
+				case OP_NEQ:			a = a != b; break;
+				case OP_GT:				a = a > b; break;
+				case OP_LT:				a = a < b; break;
+				case OP_BTW:			a = evalBetween(code[pc++], a, b); break;
+				case OP_NOT_BTW:	a = !evalBetween(code[pc++], a, b); break;
+			}
+			stack[sp - 1] = a;
+			continue;
+		}
+		
+		if (op >= OP_CURR && op <= OP_OFF) {														// Entity readings
+			byte entType = code[pc], entNum = code[pc + 1];
+			void *ent = entAddr(entType, entNum);
+			entGetFn get = _entGet[entType];
+			unsigned int curr = get(ent, VAL_CURR);
+			pc += 2;
+			switch (op) {
+				case OP_CURR:			stack[sp++] = curr; break;
+				case OP_NCURR:		stack[sp++] = !curr; break;
+				case OP_PREV:			stack[sp++] = get(ent, VAL_PREV); break;
+				case OP_ROFC: {
+					int valPrev = get(ent, VAL_PREV);
+					stack[sp++] = (unsigned int)((((int)curr - valPrev) * 100) / valPrev);
+					break;
+				}
+				case OP_ON:				stack[sp++] = curr && !get(ent, VAL_PREV); break;
+				case OP_OFF:			stack[sp++] = !curr && get(ent, VAL_PREV); break;
+			}
+			continue;
+		}
+		
+		switch (op) {
+			case OP_RET:
+				if (depth == 0) return stack[sp - 1];
+				pc = calls[--depth];
+				if (_memoOn) memoPut(callEvals[depth], stack[sp - 1]);
+				break;
+			case OP_YEAR:				stack[sp++] = year(); break;
+			case OP_MONTH:			stack[sp++] = month(); break;
+			case OP_NOW:				stack[sp++] = evalNow(); break;
+			case OP_AGG:
+				stack[sp++] = aggregate(code[pc], code[pc + 1], code[pc + 2]);
+				pc += 3;
+				break;
+			case OP_CALL:
+				if (_memoOn) {
+					if (_memoStamp[code[pc + 2]] == _memoEpoch) {									// Already run in this pass
+						stack[sp++] = _memoVal[code[pc + 2]];
+						_memoHits++;
+						pc += 3;
+						break;
+					}
+					_memoMisses++;
+				}
+				callEvals[depth] = code[pc + 2];
+				calls[depth++] = pc + 3;
+				pc = code[pc] | (code[pc + 1] << 8);
+				break;
+			case OP_MULTI: {
+				unsigned int result = 0;
+				runMulti(code[pc], code[pc + 1], code[pc + 2], code[pc + 3], code[pc + 4], code[pc + 5], &result);
+				stack[sp++] = result;
+				pc += 6;
+				break;
+			}
+			case OP_JZ:
+			case OP_JNZ:
+				if ((stack[sp - 1] == 0) == (op == OP_JZ)) pc = code[pc] | (code[pc + 1] << 8);
+				else pc += 2;
+				break;
+			case OP_POP:				sp--; break;
+			case OP_PUSH:
+				stack[sp++] = code[pc] | (code[pc + 1] << 8);
+				pc += 2;
+				break;
+			case OP_SET: {
+				unsigned int evalA = stack[sp - 1];
+				byte flags = code[pc + 2];
+				if ((flags & SET_BINARY) && evalA > 0) evalA = 1;
+				if (!(flags & SET_IF_TRUE) || evalA > 0) putEnt(code[pc], code[pc + 1], VAL_PUSH, evalA);
+				stack[sp - 1] = evalA;
+				pc += 3;
+				break;
+			}
+			case OP_UNSET:
+				if (stack[sp - 1] > 0) putEnt(code[pc], code[pc + 1], VAL_PUSH, OFF);
+				stack[sp - 1] = 0;
+				pc += 2;
+				break;
+		}
+	}
+}
+
+boolean HA_root::evalBetween(byte schedNum, unsigned int dhmFrom, unsigned int dhmTo) {		// dhmBetween the time for the pass, keeping the schedule
+	evalSchedule *sched = _evalSched + schedNum;
+	
+	if (dhmFrom != sched->from || dhmTo != sched->to) {
+		sched->from = dhmFrom;
+		sched->to = dhmTo;
+		dhmCompile(dhmFrom, dhmTo, &sched->schedule);
+	}
+	return dhmInSchedule(evalNow(), &sched->schedule);
+}
+
+
+// **************** Changed evaluations  ******************
+//
+// indexEvals finds, for every entity and every evaluation, the evaluations that read it, and takes the order from
+// checkEvals, with each evaluation after everything it reads.  runChangedEvals is then a rule pass that runs only those that may give a
+// different answer: readers of an entity changed since the last pass (the DIRTY_RULES view), readers of an evaluation
+// whose result has changed in this pass, and evaluations of the time, which run every pass.  In that order one pass
+// carries a change all the way through; a SET or UNSET that changes an entity is picked up by the next.  On a quiet
+// house a pass runs nothing.
+//
+// Evaluations are held by their position in that order, so the dirty bits are visited in order and a reader, always
+// later, is reached in the same scan.  Readers are lists, one after another in _readers, indexed as CSR.
+
+boolean HA_root::evalInput(byte evalNum, unsigned int inputNum, byte *entType, byte *entNum) {		// Each entity or evaluation that evalNum reads
+	byte valCalc, valAType, valA, valExp, valBType, valB, numA = 0;
+	boolean multi, readsB;
+	
+	getEval(evalNum, &valCalc, &valAType, &valA, &valExp, &valBType, &valB);
+	multi = (valAType == DEV_TYPE_RFID || valAType == VAR_TYPE_RFID);
+	if (multi) {
+		numA = 1;
+		readsB = (valExp == EXP_EQ || valExp == EXP_NEQ);
+	}
+	else {
+		if (valCalc <= CALC_OFF || valCalc == CALC_EVAL) numA = 1;
+		else if (valCalc >= CALC_AVG && valA < _numArgLists) numA = numArgs(valA);
+		readsB = (valExp >= EXP_ADD && valExp <= EXP_NOT_BTW);
+	}
+	
+	if (inputNum < numA) {
+		*entType = (!multi && valCalc >= CALC_AVGV) ? DEP_EVAL : valAType;
+		*entNum = (multi || valCalc <= CALC_OFF || valCalc == CALC_EVAL) ? valA : getArg(valA, inputNum);
+		return true;
+	}
+	if (inputNum == numA && readsB) {
+		*entType = valBType;
+		*entNum = valB;
+		return true;
+	}
+	return false;
+}
+
+boolean HA_root::indexEvals() {			// Call again if evaluations, arg lists or entity arrays change - until then a pass runs everything
+	unsigned int base[NUM_ENT_TYPES], numEnts = 0, entLinks = 0, evalLinks = 0;
+	byte entType, entNum, bytes = (_numEvals + 7) / 8;
+	
+	_depStale = true;
+	if (_numEvals == 0) return false;
+	for (byte type = 0; type < NUM_ENT_TYPES; type++) {
+		base[type] = numEnts;
+		numEnts += _numEnts[type];
+	}
+	
+	// Count the links - checkEvals has seen that every input exists
+	if (_orderStale && !checkEvals()) return false;
+	for (byte evalNum = 0; evalNum < _numEvals; evalNum++) {
+		for (unsigned int i = 0; evalInput(evalNum, i, &entType, &entNum); i++) {
+			if (entType == DEP_EVAL) evalLinks++;
+			else entLinks++;
+		}
+	}
+	
+	// Space - that of the last index if it fits
+	if (_evalDirty == NULL || numEnts != _depEnts || entLinks + evalLinks > _depLinks) {
+		unsigned int arenaMark = arena.mark();
+		_evalDirty = (byte*)arena.alloc(bytes);
+		_evalVolatile = (byte*)arena.alloc(bytes);
+		_evalLast = (unsigned int*)arena.alloc(_numEvals * sizeof(unsigned int));
+		_entReaderIdx = (unsigned int*)arena.alloc((numEnts + 1) * sizeof(unsigned int));
+		_evalReaderIdx = (unsigned int*)arena.alloc((_numEvals + 1) * sizeof(unsigned int));
+		_readers = (byte*)arena.alloc(entLinks + evalLinks + 1);
+		if (_evalDirty == NULL || _evalVolatile == NULL || _evalLast == NULL || _entReaderIdx == NULL || _evalReaderIdx == NULL || _readers == NULL) {
+			arena.release(arenaMark);
+			_evalDirty = _evalVolatile = _readers = NULL;
+			_evalLast = _entReaderIdx = _evalReaderIdx = NULL;
+			Serial.println("HA_root: no space for eval index");
+			return false;
+		}
+		_depEnts = numEnts;
+		_depLinks = entLinks + evalLinks;
+	}
+	
+	// Readers of each evaluation, by number for now.  Counted into their lists' ends, which become starts as they fill
+	memset(_entReaderIdx, 0, (numEnts + 1) * sizeof(unsigned int));
+	memset(_evalReaderIdx, 0, (_numEvals + 1) * sizeof(unsigned int));
+	for (byte evalNum = 0; evalNum < _numEvals; evalNum++) {
+		for (unsigned int i = 0; evalInput(evalNum, i, &entType, &entNum); i++) {
+			if (entType == DEP_EVAL) _evalReaderIdx[entNum]++;
+			else _entReaderIdx[base[entType] + entNum]++;
+		}
+	}
+	for (unsigned int i = 1; i <= numEnts; i++) _entReaderIdx[i] += _entReaderIdx[i - 1];
+	_evalReaderIdx[0] += entLinks;
+	for (byte i = 1; i <= _numEvals; i++) _evalReaderIdx[i] += _evalReaderIdx[i - 1];
+	for (byte evalNum = 0; evalNum < _numEvals; evalNum++) {
+		for (unsigned int i = 0; evalInput(evalNum, i, &entType, &entNum); i++) {
+			if (entType == DEP_EVAL) _readers[--_evalReaderIdx[entNum]] = evalNum;
+		}
+	}
+	
+	// Now by position in checkEvals' order - _evalLast holds each evaluation's until the end
+	for (byte pos = 0; pos < _numEvals; pos++) _evalLast[_evalOrder[pos]] = pos;
+	for (unsigned int i = _evalReaderIdx[0]; i < _evalReaderIdx[_numEvals]; i++) _readers[i] = _evalLast[_readers[i]];
+	for (byte evalNum = 0; evalNum < _numEvals; evalNum++) {
+		for (unsigned int i = 0; evalInput(evalNum, i, &entType, &entNum); i++) {
+			if (entType != DEP_EVAL) _readers[--_entReaderIdx[base[entType] + entNum]] = _evalLast[evalNum];
+		}
+	}
+	
+	memset(_evalVolatile, 0, bytes);
+	for (byte pos = 0; pos < _numEvals; pos++) {
+		byte valCalc = getEval(_evalOrder[pos], VAL_CALC), valExp = getEval(_evalOrder[pos], VAL_EXP);
+		if ((valCalc >= CALC_YEAR && valCalc <= CALC_NOW) || valExp == EXP_BTW || valExp == EXP_NOT_BTW) _evalVolatile[pos >> 3] |= _BV(pos & 7);
+	}
+	memset(_evalDirty, 0xFF, bytes);																// First pass runs everything
+	memset(_evalLast, 0, _numEvals * sizeof(unsigned int));
+	
+	_depStale = false;
+	return true;
+}
+
+void HA_root::dirtyReaders(unsigned int first, unsigned int last) {
+	for (unsigned int i = first; i < last; i++) _evalDirty[_readers[i] >> 3] |= _BV(_readers[i] & 7);
+}
+
+byte HA_root::runChangedEvals() {
+	byte bits[32], ran = 0;														// Room for 255 entities of a type
+	unsigned int base = 0, result;
+	
+	// Entities changed since the last pass
+	for (byte type = 0; type < NUM_ENT_TYPES; base += _numEnts[type], type++) {
+		byte len = harvestDirty(DIRTY_RULES, type, bits, sizeof(bits));
+		if (_depStale) continue;
+		for (byte i = 0; i < len; i++) {
+			if (bits[i] == 0) continue;
+			for (byte bit = 0; bit < 8; bit++) {
+				unsigned int ent = base + (i << 3) + bit;
+				if (bits[i] & _BV(bit)) dirtyReaders(_entReaderIdx[ent], _entReaderIdx[ent + 1]);
+			}
+		}
+	}
+	
+	beginEvalPass();
+	if (_depStale) {																// No index, or out of date - everything, in order if checked
+		for (byte pos = 0; pos < _numEvals; pos++) {
+			byte evalNum = _orderStale ? pos : _evalOrder[pos];
+			result = 0;
+			runEval(evalNum, &result);
+			if (_evalLast != NULL) _evalLast[evalNum] = result;
+		}
+		endEvalPass();
+		return _numEvals;
+	}
+	
+	for (byte i = 0; i < (_numEvals + 7) / 8; i++) _evalDirty[i] |= _evalVolatile[i];
+	for (unsigned int pos = 0; pos < _numEvals; pos++) {
+		if (_evalDirty[pos >> 3] == 0) {						// Nothing in this byte
+			pos |= 7;
+			continue;
+		}
+		if (!(_evalDirty[pos >> 3] & _BV(pos & 7))) continue;
+		_evalDirty[pos >> 3] &= ~_BV(pos & 7);
+		
+		byte evalNum = _evalOrder[pos];
+		result = _evalLast[evalNum];
+		runEval(evalNum, &result);
+		ran++;
+		if (result != _evalLast[evalNum]) {						// Its readers are later, so run in this pass
+			_evalLast[evalNum] = result;
+			dirtyReaders(_evalReaderIdx[evalNum], _evalReaderIdx[evalNum + 1]);
+		}
+	}
+	endEvalPass();
+	return ran;
+}
+
+unsigned int HA_root::lastEval(byte evalNum) {
+	if (_evalLast == NULL || evalNum >= _numEvals) return 0;
+	return _evalLast[evalNum];
+}
+
+
+// **************** Evaluation memo  ******************
+//
+// Within a rule pass an evaluation read by several others - through CALC_EVAL or arg lists, an AVGV sharing members with
+// an ANDV - is run once, and its result reused.  Each result is stamped with the pass it was found in, so a new pass
+// clears the memo by moving to the next stamp; only when the stamps wrap are they cleared, once in 255 passes.  Outside
+// a pass nothing is memoised.  Within one, an evaluation's result is from when it first ran, even if a SET later in
+// the pass changes what it reads - the next pass sees the change.  The time (CALC_NOW, EXP_BTW) is also read once per
+// pass, with or without the memo.
+
+boolean HA_root::memoEvals() {				// Before arena.seal()
+	if (_numEvals == 0) return false;
+	if (_memoStamp == NULL) {
+		unsigned int arenaMark = arena.mark();
+		_memoStamp = (byte*)arena.alloc(_numEvals);
+		_memoVal = (unsigned int*)arena.alloc(_numEvals * sizeof(unsigned int));
+		if (_memoStamp == NULL || _memoVal == NULL) {
+			arena.release(arenaMark);
+			_memoStamp = NULL;
+			_memoVal = NULL;
+			Serial.println("HA_root: no space for eval memo");
+			return false;
+		}
+		memset(_memoStamp, 0, _numEvals);
+		_memoEpoch = 0;
+	}
+	return true;
+}
+
+void HA_root::beginEvalPass() {
+	_passNow = dhmNow();																				// The same time for the whole pass
+	_inPass = true;
+	if (_memoStamp == NULL) return;
+	if (++_memoEpoch == 0) {																		// Stamps wrapped - 0 is never a pass
+		memset(_memoStamp, 0, _numEvals);
+		_memoEpoch = 1;
+	}
+	_memoOn = true;
+}
+
+void HA_root::endEvalPass() {
+	_inPass = _memoOn = false;
+}
+
+unsigned int HA_root::evalNow() {
+	return _inPass ? _passNow : dhmNow();
+}
+
+void HA_root::memoPut(byte evalNum, unsigned int val) {
+	_memoStamp[evalNum] = _memoEpoch;
+	_memoVal[evalNum] = val;
+}
+
+unsigned long HA_root::memoHits() {
+	return _memoHits;
+}
+
+unsigned long HA_root::memoMisses() {
+	return _memoMisses;
+}
+
+void HA_root::memoReport(char *buffer, int maxLen) {
+	snprintf(buffer, maxLen, "memo hits=%lu misses=%lu%s", _memoHits, _memoMisses, (_memoStamp == NULL) ? " off" : "");
+}
+
+
 void HA_root::printRoot() {
 	char devTypeChar[3];
 	char buffer[10];
@@ -34,10 +34,80 @@
 #include "HA_channels.h"
 
 
-		
+static const byte NUM_ENT_TYPES = NUM_DEV_TYPES + NUM_VAR_TYPES + NUM_ZONE_TYPES;
+
+// *********** Operations for each entity type ************
+// One entry per DEV_TYPE_, VAR_TYPE_ and OBJ_TYPE_ZONE, held in PROGMEM (see HA_root.cpp).  get and put are copied
+// to SRAM by createEntArray, so the hot path is one indexed call; the rest are read from flash when used.  NULL where
+// the type has no such operation.  Adding an entity type means one line in the table, not a case in every method
+
+// *********** Change tracking ************
+// Each consumer has its own view of what has changed since it last looked - a bit per entity, set by markDirty when a
+// device's reading changes (in the device, as readDev pushes directly), when putEnt changes a variable, or when a zone's
+// occupancy, temperatures or luminance change (in HA_zone::put, so the occupancy timeout too), and cleared only by that
+// consumer harvesting it.  Per view, a bit per entity type says which bitsets are worth scanning
+
+const static byte DIRTY_WEB = 0;									// Browser ajax check
+const static byte DIRTY_PEERS = 1;								// Other controllers
+const static byte DIRTY_RULES = 2;								// Evaluations
+const static byte DIRTY_IMAGE = 3;								// Saved state image (HA_image.h)
+const static byte NUM_DIRTY_VIEWS = 4;
+
+// *********** Snapshot streams ************
+// The current reading and status of every entity of a type, or of all types, in chunks a caller sends as they come - one
+// client.write per chunk, so each is one packet and within the W5100's transmit buffer.  The cursor holds the place
+// between chunks; records are never split across them.  JSON is an array of {"t":"xH","n":3,"v":215,"s":0}; binary is
+// SNAP_RECORD_LEN bytes per entity - type, number, reading LSB first, status
+
+const static byte SNAP_ALL = 0xFF;								// Every entity type
+const static byte SNAP_JSON = 0;
+const static byte SNAP_BINARY = 1;
+const static byte SNAP_RECORD_LEN = 5;						// Binary
+const static byte SNAP_JSON_MAX = 40;							// Longest JSON record with its comma - chunks must be 2 longer than this
+
+struct HA_snapCursor {
+	byte entType;
+	byte entNum;
+	byte onlyType;															// SNAP_ALL, or the one type
+	byte format;
+	unsigned int count;													// Records so far
+	boolean done;
+};
+
+// *********** Compiled evaluations ************
+// compileEvals turns the evaluations and arg lists into one bytecode program, with entity and evaluation references
+// resolved, which runEval then runs on a small fixed stack instead of decoding each HA_evaluation (see HA_root.cpp).
+// Nested evaluations (CALC_EVAL, _AVGV, _ANDV, _ORV) are calls within the program, up to EVAL_MAX_DEPTH deep
+
+const static byte EVAL_MAX_DEPTH = 8;
+const static byte EVAL_FRAME = 48;											// Approximate stack per level of nesting when interpreted - runEval and getValA frames
+
+struct evalSchedule {																		// An EXP_BTW evaluation's schedule, and the from/to it was worked out from
+	unsigned int from;
+	unsigned int to;
+	dhmSchedule schedule;
+};
+
+struct HA_config;															// Configuration tables in PROGMEM - see HA_config.h
+
+typedef unsigned int (*entGetFn)(void *ent, byte valType);
+typedef void (*entPutFn)(void *ent, byte valType, unsigned int val);
+
+struct entOps {
+	byte classSize;
+	byte column;												// COL_ layout of readings, from the class
+	entGetFn get;
+	entPutFn put;
+	byte (*putRef)(void *ent, char *device);
+	void (*getRef)(void *ent, byte entNum, char *device);
+	void (*getSnapshot)(void *ent);
+	void (*initDev)(void *ent, byte devNum, byte channel, byte pin, byte handler);
+	void (*readDev)(void *ent, byte devNum);
+	void (*setDev)(void *ent, byte val);
+};
 		
 // *********** Global root for all data structures ************
-// Comprises pointers to malloc arrays of classes
+// Comprises pointers to arrays of classes, allocated from the arena (HA_arena.h)
 
 class HA_root {
 
@@ -49,11 +119,15 @@ class HA_root {
 		// Methods
 		HA_root();
 		~HA_root();
+		
+		boolean loadConfig(const HA_config *config);		// Whole configuration from PROGMEM tables, at the start of setup()
 
 		// Methods for entities - devices, variables & zones
 		boolean createEntArray(byte entType, byte numEntities);
 		byte numEnts(byte entType);
 		byte classSize(byte entType);
+		byte entColumn(byte entType);								// COL_ layout of the type's readings, from the ops table
+		boolean isActor(byte entType);								// Has setDev - its reading is also the state of an output
 		byte entBufLen(byte entType);	
 	  
 		void putEnt(byte entType, byte entNum, byte valType, unsigned int val);
@@ -62,6 +136,10 @@ class HA_root {
 		byte putRef(byte entType, byte entNum, char *device);
 		void getRef(byte entType, byte entNum, char *device);
 		void getSnapshot(byte entType, byte entNum);
+		
+		void snapBegin(HA_snapCursor *cursor, byte entType = SNAP_ALL, byte format = SNAP_JSON);
+		unsigned int snapNext(HA_snapCursor *cursor, byte *buffer, unsigned int maxLen);		// Next chunk of whole records; 0 when all sent
+		unsigned int snapStream(Print &out, byte *buffer, unsigned int bufLen, byte entType = SNAP_ALL, byte format = SNAP_JSON);	// Returns records sent
 		boolean logChange(byte entType, byte entNum, byte val);
 		
 		void putEnt(byte entType, byte entNum, byte valType, void *valPtr);
@@ -81,6 +159,25 @@ class HA_root {
 		
 		int findZone(byte regionZone);
 		
+		// Textual references - devices (G1.03.xH2), variables (vB.03) and zones (D1) - to entities.  See indexRefs in HA_root.cpp
+		boolean indexRefs();																// Once refs are set, before arena.seal()
+		boolean findRef(char *ref, byte *entType, byte *entNum);
+		
+		// Change tracking - see DIRTY_ views above
+		void markDirty(byte entType, byte entNum);
+		boolean nextDirty(byte view, byte *entType, byte *entNum);					// Next changed entity, cleared as it is returned
+		byte harvestDirty(byte view, byte entType, byte *bits, byte maxBytes);	// Copy and clear a type's bits; returns bytes copied
+		boolean anyDirty(byte view);																				// Quick test - may be true once more after the last is taken
+		
+#ifdef HA_COLUMNS
+		// Reading columns, by device type, indexed by device number - see HA_COLUMNS in HA_globals.h
+		byte colKind(byte devType) { return (devType < NUM_DEV_TYPES) ? _colKind[devType] : COL_NONE; }
+		byte *currBits(byte devType) { return (byte*)_colCurr[devType]; }
+		byte *prevBits(byte devType) { return (byte*)_colPrev[devType]; }
+		unsigned int *currWords(byte devType) { return (unsigned int*)_colCurr[devType]; }
+		unsigned int *prevWords(byte devType) { return (unsigned int*)_colPrev[devType]; }
+#endif
+		
 		// Methods for channels 
 		boolean createChanArray(byte numChans);
 		byte numChans();
@@ -114,24 +211,62 @@ class HA_root {
 		byte getArg(byte argListNum, byte argNum);
 				
 		// Perform evaluations
+		boolean checkEvals();																// Inputs exist and no loops - see HA_root.cpp.  loadConfig calls it
+		byte evalDepth();																		// Deepest nesting of evaluations, from checkEvals
+		unsigned int evalStackUse();														// Roughly the stack that nesting takes when interpreted
+		boolean compileEvals();															// Once evaluations and arg lists are set, before arena.seal()
+		unsigned int evalCodeLen();													// Bytes of arena held by the program
+		boolean indexEvals();																// Which evaluations read each entity and evaluation - see runChangedEvals
+		byte runChangedEvals();															// Rule pass: only evaluations whose inputs changed; returns how many ran
+		unsigned int lastEval(byte evalNum);												// Result from the last pass that ran it
+		boolean memoEvals();																// Each evaluation run once per pass, however many read it
+		void beginEvalPass();																// Around a sketch's own pass, for the memo and one dhmNow - runChangedEvals calls them itself
+		void endEvalPass();
+		unsigned long memoHits();
+		unsigned long memoMisses();
+		void memoReport(char *buffer, int maxLen);
 		void runEval(byte evalNum, unsigned int *evalPtr);
 		unsigned int getValA(byte valCalc, byte valAType, byte valA);
 		void runExp(byte valCalc, byte valAType, unsigned int evalA, byte valExp, byte valBType, byte valB, unsigned int *evalPtr);
+		boolean runMulti(byte valCalc, byte valAType, byte valA, byte valExp, byte valBType, byte valB, unsigned int *evalPtr);
 		boolean equal(byte valAType, byte *evalAPtr, byte *evalBPtr);
 		
 		// Debug
 		void printRoot();
 		
 	protected:
+		// Methods
+		void *entAddr(byte entType, byte entNum) { return (byte*)_entPtrs[entType] + entNum * _classSize[entType]; }
+		void getOps(byte entType, entOps *ops);		// Copy of the type's entry from the PROGMEM table
+#ifdef HA_COLUMNS
+		boolean createColumns(byte devType, byte column, byte numDevs);
+		unsigned int colAggregate(byte valCalc, byte devType, byte argListNum);
+#endif
+		unsigned int aggregate(byte valCalc, byte devType, byte argListNum);
+		unsigned int compileEval(byte evalNum, byte *code);
+		unsigned int runCode(unsigned int pc);
+		boolean evalBetween(byte schedNum, unsigned int dhmFrom, unsigned int dhmTo);
+		byte evalRef(byte evalNum, byte refNum);
+		boolean evalInput(byte evalNum, unsigned int inputNum, byte *entType, byte *entNum);
+		void dirtyReaders(unsigned int first, unsigned int last);
+		void memoPut(byte evalNum, unsigned int val);
+		unsigned int evalNow();
+		boolean snapFind(HA_snapCursor *cursor);
+		unsigned long refKey(byte devType, byte devNum);
+		
 		// Properties
 		
 		//HA_zone							*zonePtr;
 		
 		// Entities - devices & variables
-		byte _numEnts[NUM_DEV_TYPES + NUM_VAR_TYPES + NUM_ZONE_TYPES];
-		byte _classSize[NUM_DEV_TYPES + NUM_VAR_TYPES + NUM_ZONE_TYPES];
+		byte _numEnts[NUM_ENT_TYPES];
+		byte _classSize[NUM_ENT_TYPES];
+		entGetFn _entGet[NUM_ENT_TYPES];					// From the ops table once the type's array exists; harmless stubs before
+		entPutFn _entPut[NUM_ENT_TYPES];
+		byte *_dirtyBits[NUM_ENT_TYPES];						// NUM_DIRTY_VIEWS bitsets per type, one after the other
+		byte _dirtyTypes[NUM_DIRTY_VIEWS][(NUM_ENT_TYPES + 7) / 8];
 		union {
-			void *_entPtrs[NUM_DEV_TYPES + NUM_VAR_TYPES + NUM_ZONE_TYPES];
+			void *_entPtrs[NUM_ENT_TYPES];
 			struct {		
 				HA_devTouch 		*ptrTouch;
 				HA_devFire 			*ptrFire;
@@ -152,13 +287,63 @@ class HA_root {
 				HA_zone					*ptrZone;
 			} entPtrs;
 		};
+		
+#ifdef HA_COLUMNS
+		byte _colKind[NUM_DEV_TYPES];
+		void *_colCurr[NUM_DEV_TYPES];
+		void *_colPrev[NUM_DEV_TYPES];
+#endif
 
-		// Evaluations & arg lists
+		// Evaluations & arg lists - in SRAM, or read from the PROGMEM tables if loadConfig supplied them
 		byte _numEvals;
 		HA_evaluation				*ptrEvaluation;
+		const byte					*_evalTable;
 		
 		byte _numArgLists;
 		HA_argList					*ptrArgList;
+		const unsigned int	*_argIndex;
+		const byte					*_argTable;
+		
+		byte								*_evalCode;								// Compiled program - see compileEvals
+		unsigned int				*_evalEntry;							// Start of each evaluation in _evalCode
+		unsigned int				_evalCodeLen;
+		evalSchedule				*_evalSched;							// One per EXP_BTW and _NOT_BTW, numbered in the code
+		byte								_numEvalSched;
+		byte								_evalSchedLen;						// Allocated, used again by a recompile
+		boolean							_evalStale;								// Evaluations or arg lists changed since compileEvals
+		
+		byte								*_evalOrder;							// Every evaluation after those it reads - see checkEvals
+		byte								_evalDepth;								// Deepest nesting
+		boolean							_orderStale;							// Evaluations, arg lists or entity arrays changed since checkEvals
+		
+		// Dependency index - see indexEvals.  Evaluations are held by their position in _evalOrder
+		byte								*_evalDirty;							// Bit per position - to run in the next pass
+		byte								*_evalVolatile;						// Bit per position - read the time, so run every pass
+		unsigned int				*_evalLast;								// Result per evaluation
+		unsigned int				*_entReaderIdx;						// Start in _readers for each entity, types one after another, and one past the last
+		unsigned int				*_evalReaderIdx;					// The same for each evaluation, after the entities' readers
+		byte								*_readers;								// Positions of the reading evaluations
+		unsigned int				_depEnts;									// Entities when indexed
+		unsigned int				_depLinks;								// Room in _readers
+		boolean							_depStale;								// Evaluations, arg lists or entity arrays changed since indexEvals
+		
+		// Memo of results within a pass - see memoEvals
+		byte								*_memoStamp;							// Pass each result is from, 0 for none
+		unsigned int				*_memoVal;
+		byte								_memoEpoch;								// This pass
+		boolean							_memoOn;									// In a pass
+		unsigned long				_memoHits;
+		unsigned long				_memoMisses;
+		boolean							_inPass;									// Between beginEvalPass and endEvalPass
+		unsigned int				_passNow;									// dhmNow at the start of the pass
+		
+		// Device reference index - a perfect hash, see indexRefs
+		unsigned int _refCount;								// Devices indexed, or 0 if there is no index
+		unsigned int _refBuckets;
+		unsigned int _refSlots;
+		byte *_refDisp;												// Displacement per bucket
+		byte *_refIndex;											// Type and number of the device in each slot
+		boolean _refStale;										// A ref has changed since the index was built
 		
 		// Channels
 		byte _numChannels;
@@ -0,0 +1,130 @@
+/* Benchmark of CALC_AVG, CALC_AND and CALC_OR over a 128 device configuration
+
+  64 lights (on/off, bit columns) and 64 luminance sensors (2 byte, word columns), with an arg list naming every device
+  of each type.  Each aggregate is timed two ways:
+
+  - Per device: the loop getValA used before HA_COLUMNS - getArg and getEnt for each device, through the device object
+  - Columns: getValA itself, which scans the column directly when HA_COLUMNS is defined (HA_globals.h)
+
+  Build once with HA_COLUMNS commented out as well to see the per device figure with readings held in each object.
+  Timer3 runs unprescaled as a cycle counter, read around each call, so results are in CPU cycles (16 per uS on a
+  Mega).  Interrupts are off while measuring.  Results are printed to Serial at 9600 baud
+
+
+**************************/
+
+
+
+#include "HA_root.h"
+#include "HA_arena.h"
+
+static const byte NUM_EACH = 64;
+static const byte REPEATS = 16;                 // Calls averaged per measurement
+
+static const byte LIGHT_ARGS = 0;               // Arg list numbers
+static const byte LUM_ARGS = 1;
+
+volatile unsigned int sink;                     // Stops the compiler dropping the calls
+
+// ********** The per device loop, as getValA was **********
+
+unsigned int perDevice(byte valCalc, byte devType, byte argList) {
+  unsigned int evalA = 0;
+
+  switch (valCalc) {
+    case CALC_AVG:
+      for (int i = 0; i < root.numArgs(argList); i++) evalA += root.getEnt(devType, root.getArg(argList, i), VAL_CURR);
+      return evalA / root.numArgs(argList);
+    case CALC_AND:
+      evalA = root.getEnt(devType, root.getArg(argList, 0), VAL_CURR);
+      for (int i = 1; i < root.numArgs(argList) && evalA != 0; i++) evalA = root.getEnt(devType, root.getArg(argList, i), VAL_CURR);
+      return evalA;
+    case CALC_OR:
+      evalA = root.getEnt(devType, root.getArg(argList, 0), VAL_CURR);
+      for (int i = 1; i < root.numArgs(argList) && evalA == 0; i++) evalA = root.getEnt(devType, root.getArg(argList, i), VAL_CURR);
+      return evalA;
+  }
+  return 0;
+}
+
+// ********** Cycle counter **********
+
+void startCycles() {
+  TCCR3A = 0;
+  TCCR3B = _BV(CS30);       // No prescale
+  TCNT3 = 0;
+}
+
+unsigned int readCycles() {
+  return TCNT3;
+}
+
+unsigned int timePerDevice(byte valCalc, byte devType, byte argList) {
+  unsigned long total = 0;
+  for (byte i = 0; i < REPEATS; i++) {
+    startCycles();
+    sink = perDevice(valCalc, devType, argList);
+    total += readCycles();
+  }
+  return total / REPEATS;
+}
+
+unsigned int timeColumns(byte valCalc, byte devType, byte argList) {
+  unsigned long total = 0;
+  for (byte i = 0; i < REPEATS; i++) {
+    startCycles();
+    sink = root.getValA(valCalc, devType, argList);
+    total += readCycles();
+  }
+  return total / REPEATS;
+}
+
+void report(const char *name, byte valCalc, byte devType, byte argList) {
+  noInterrupts();
+  unsigned int d = timePerDevice(valCalc, devType, argList);
+  unsigned int c = timeColumns(valCalc, devType, argList);
+  interrupts();
+
+  Serial.print(name);
+  Serial.print('\t');
+  Serial.print(d);
+  Serial.print('\t');
+  Serial.print(c);
+  Serial.print('\t');
+  Serial.println(perDevice(valCalc, devType, argList) == root.getValA(valCalc, devType, argList) ? "same" : "DIFFERENT");
+}
+
+void setup() {
+  char buffer[60];
+
+  Serial.begin(9600);
+
+  if (!root.createEntArray(DEV_TYPE_LIGHT, NUM_EACH) || !root.createEntArray(DEV_TYPE_LUMINANCE, NUM_EACH)
+      || !root.createArgListArray(2) || !root.createArgList(LIGHT_ARGS, NUM_EACH) || !root.createArgList(LUM_ARGS, NUM_EACH)) {
+    Serial.println("No space - raise HA_ARENA_SIZE");
+    return;
+  }
+  arena.report(buffer, 60);
+  Serial.println(buffer);
+
+  for (byte i = 0; i < NUM_EACH; i++) {
+    root.putArg(LIGHT_ARGS, i, i);
+    root.putArg(LUM_ARGS, i, i);
+    root.putEnt(DEV_TYPE_LIGHT, i, VAL_PUSH, ON);                // All on, so AND runs the whole list
+    root.putEnt(DEV_TYPE_LUMINANCE, i, VAL_PUSH, OFF);             // All dark, so OR runs the whole list
+    root.putEnt(DEV_TYPE_LUMINANCE, i, VAL_PUSH, OFF);
+  }
+  root.putEnt(DEV_TYPE_LUMINANCE, NUM_EACH - 1, VAL_PUSH, 500);
+
+  Serial.println("Aggregate cycles per call, 64 devices");
+  Serial.println("calc\tdevice\tcolumns");
+  report("AVG bit", CALC_AVG, DEV_TYPE_LIGHT, LIGHT_ARGS);
+  report("AND bit", CALC_AND, DEV_TYPE_LIGHT, LIGHT_ARGS);
+  report("OR bit", CALC_OR, DEV_TYPE_LIGHT, LIGHT_ARGS);
+  report("AVG word", CALC_AVG, DEV_TYPE_LUMINANCE, LUM_ARGS);
+  report("AND word", CALC_AND, DEV_TYPE_LUMINANCE, LUM_ARGS);
+  report("OR word", CALC_OR, DEV_TYPE_LUMINANCE, LUM_ARGS);
+}
+
+void loop() {
+}
@@ -0,0 +1,61 @@
+/* Configuration from PROGMEM tables
+
+  dining.cfg describes the controller - channels, devices, zones, evaluations and arg lists.  tools/ha_config.py
+  compiles it into dining_config.h, and setup() builds everything with one call to root.loadConfig.  Regenerate the
+  header after editing dining.cfg:
+
+    ../../tools/ha_config.py dining.cfg
+
+  Evaluations and arg lists are read from flash as they run, so the arena holds only state.  loadConfig checks them
+  first - a loop among the evaluations fails it.  Their nesting, the arena report and each evaluation's result are
+  printed to Serial at 9600 baud, the results every 10 seconds.
+
+
+**************************/
+
+
+
+#include "Wakeup.h"
+#include "HA_switcher.h"
+#include "HA_root.h"
+#include "HA_arena.h"
+#include "dining_config.h"
+
+void runEvals() {
+  unsigned int result;
+
+  for (byte i = 0; i < root.numEvals(); i++) {
+    root.runEval(i, &result);
+    Serial.print("eval ");
+    Serial.print(i);
+    Serial.print(" = ");
+    Serial.println(result);
+  }
+}
+
+void setup() {
+  char buffer[60];
+
+  Serial.begin(9600);
+  wakeup.init();
+  initSwitcher();
+
+  if (!root.loadConfig(&DINING_CONFIG)) {
+    Serial.println("Config failed");
+    return;
+  }
+  Serial.print("Evaluations nest ");
+  Serial.print(root.evalDepth());
+  Serial.print(" deep, about ");
+  Serial.print(root.evalStackUse());
+  Serial.println(" bytes of stack");
+  arena.seal();
+  arena.report(buffer, 60);
+  Serial.println(buffer);
+
+  wakeup.wakeMeAfter(runEvals, 10, REPEAT_COUNT | UNITS_SECONDS);
+}
+
+void loop() {
+  wakeup.runAnyPending();
+}
@@ -0,0 +1,83 @@
+/* Generated by ha_config.py from dining.cfg - edit that and regenerate, not this */
+
+#ifndef DINING_config_h
+#define DINING_config_h
+
+#include "HA_config.h"
+
+static const cfgChannel DINING_CHANS[] PROGMEM = {
+	{ CHAN_PROTOCOL_PIO, 1, 0, CHAN_ACCESS_DIRECT, 0, 0, 0, CHAN_ALERT_NONE, 0, 0, 0, 0, 0, 0 },
+	{ CHAN_PROTOCOL_PIO, 16, A0, CHAN_ACCESS_MUX, 22, 23, 24, CHAN_ALERT_NONE, 0, 0, 0, 0, 0, 0 },
+};
+
+static const cfgEntities DINING_ENTS[] PROGMEM = {
+	{ DEV_TYPE_LIGHT, 8 },
+	{ DEV_TYPE_RELAY, 4 },
+	{ DEV_TYPE_LUMINANCE, 4 },
+	{ DEV_TYPE_HEAT, 2 },
+	{ VAR_TYPE_2BYTE, 4 },
+	{ OBJ_TYPE_ZONE, 2 },
+};
+
+static const cfgDevice DINING_DEVS[] PROGMEM = {
+	{ DEV_TYPE_LIGHT, 0, 0, 30, 0 },
+	{ DEV_TYPE_LIGHT, 1, 0, 31, 0 },
+	{ DEV_TYPE_LIGHT, 2, 0, 32, 0 },
+	{ DEV_TYPE_LIGHT, 3, 0, 33, 0 },
+	{ DEV_TYPE_LIGHT, 4, 0, 34, 0 },
+	{ DEV_TYPE_LIGHT, 5, 0, 35, 0 },
+	{ DEV_TYPE_LIGHT, 6, 0, 36, 0 },
+	{ DEV_TYPE_LIGHT, 7, 0, 37, 0 },
+	{ DEV_TYPE_RELAY, 0, 0, 40, 0 },
+	{ DEV_TYPE_RELAY, 1, 0, 41, 0 },
+	{ DEV_TYPE_RELAY, 2, 0, 42, 0 },
+	{ DEV_TYPE_RELAY, 3, 0, 43, 0 },
+	{ DEV_TYPE_LUMINANCE, 0, 1, 0, 0 },
+	{ DEV_TYPE_LUMINANCE, 1, 1, 1, 0 },
+	{ DEV_TYPE_LUMINANCE, 2, 1, 2, 0 },
+	{ DEV_TYPE_LUMINANCE, 3, 1, 3, 0 },
+	{ DEV_TYPE_HEAT, 0, 0, 8, 0 },
+	{ DEV_TYPE_HEAT, 1, 0, 9, 0 },
+};
+
+static const cfgSetting DINING_SETTINGS[] PROGMEM = {
+	{ OBJ_TYPE_ZONE, 0, VAL_REGION, 'D' },
+	{ OBJ_TYPE_ZONE, 0, VAL_ZONE, 1 },
+	{ OBJ_TYPE_ZONE, 0, VAL_HANDLER, 0 },
+	{ OBJ_TYPE_ZONE, 0, VAL_ON_EVENT, 0 },
+	{ OBJ_TYPE_ZONE, 1, VAL_REGION, 'D' },
+	{ OBJ_TYPE_ZONE, 1, VAL_ZONE, 2 },
+	{ OBJ_TYPE_ZONE, 1, VAL_HANDLER, 0 },
+	{ OBJ_TYPE_ZONE, 1, VAL_ON_EVENT, 1 },
+	{ VAR_TYPE_2BYTE, 0, VAL_PUSH, 250 },
+};
+
+static const byte DINING_EVALS[] PROGMEM = {
+	0, 0, (CALC_AVG << OFFSET_MS_NIBBLE) | EXP_NOOP, (DEV_TYPE_LUMINANCE << OFFSET_MS_NIBBLE) | 0,
+	1, 0, (CALC_OR << OFFSET_MS_NIBBLE) | EXP_NOOP, (DEV_TYPE_LIGHT << OFFSET_MS_NIBBLE) | 0,
+	0, 0, (CALC_DEV << OFFSET_MS_NIBBLE) | EXP_LT, (DEV_TYPE_LUMINANCE << OFFSET_MS_NIBBLE) | VAR_TYPE_2BYTE,
+	0, 3, (CALC_DEV << OFFSET_MS_NIBBLE) | EXP_SET, (VAR_TYPE_2BYTE << OFFSET_MS_NIBBLE) | DEV_TYPE_RELAY,
+};
+
+static const unsigned int DINING_ARG_INDEX[] PROGMEM = {
+	0, 4, 12,
+};
+
+static const byte DINING_ARGS[] PROGMEM = {
+	0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 6, 7,
+};
+
+static const HA_config DINING_CONFIG PROGMEM = {
+	CONFIG_VERSION,
+	2, DINING_CHANS,
+	6, DINING_ENTS,
+	18, DINING_DEVS,
+	9, DINING_SETTINGS,
+	0, NULL,
+	4, DINING_EVALS,
+	2, DINING_ARG_INDEX, DINING_ARGS
+};
+
+typedef char DINING_configVersion[CONFIG_VERSION == 1 ? 1 : -1];
+
+#endif
@@ -0,0 +1,88 @@
+/* Compiled evaluations - the rules run as bytecode, through root.compileEvals
+
+  Four heat sensors are compared with their set points (byte variables), averaged, ANDed and ORed through nested
+  evaluations, and the result sets a relay.  The full pass of evaluations is timed 1,000 times decoding each
+  HA_evaluation (the old way) and again after root.compileEvals(), and the times and the program's size printed to
+  Serial at 9600 baud.  The results of the two must match.
+
+  Call compileEvals after the last putEval and putArg and before arena.seal(); a later change to either sends runEval
+  back to decoding until it is called again.
+
+
+**************************/
+
+
+
+#include "Wakeup.h"
+#include "HA_switcher.h"
+#include "HA_root.h"
+#include "HA_arena.h"
+
+static const byte NUM_EVALS = 10;
+
+unsigned long timePasses(unsigned int *total) {
+  unsigned int result;
+  unsigned long started = micros();
+
+  *total = 0;
+  for (int i = 0; i < 1000; i++) {
+    for (byte e = 4; e < NUM_EVALS; e++) {
+      root.runEval(e, &result);
+      *total += result;
+    }
+  }
+  return micros() - started;
+}
+
+void setup() {
+  char buffer[60];
+  unsigned int interpreted, compiled;
+
+  Serial.begin(9600);
+  wakeup.init();
+  initSwitcher();
+
+  if (!root.createChanArray(1) || !root.createEntArray(DEV_TYPE_HEAT, 4) || !root.createEntArray(DEV_TYPE_RELAY, 1)
+      || !root.createEntArray(VAR_TYPE_BYTE, 4) || !root.createArgListArray(2) || !root.createEvalArray(NUM_EVALS)) {
+    Serial.println("No space - raise HA_ARENA_SIZE");
+    return;
+  }
+  root.initChan(0, CHAN_PROTOCOL_PIO, 1, 0);
+  root.initChanAccess(0, CHAN_ACCESS_DIRECT, 0, 0, 0);
+  root.initDev(DEV_TYPE_RELAY, 0, 0, 40, 0);
+  for (byte i = 0; i < 4; i++) {
+    root.putEnt(DEV_TYPE_HEAT, i, VAL_PUSH, (unsigned int)(180 + i * 10));
+    root.putEnt(VAR_TYPE_BYTE, i, VAL_PUSH, (unsigned int)200);
+  }
+
+  root.createArgList(0, 4);												// Evaluations 0-3
+  root.createArgList(1, 2);												// Evaluations 4 and 6
+  for (byte i = 0; i < 4; i++) root.putArg(0, i, i);
+  root.putArg(1, 0, 4);
+  root.putArg(1, 1, 6);
+
+  for (byte i = 0; i < 4; i++) root.putEval(i, CALC_DEV, DEV_TYPE_HEAT, i, EXP_LT, VAR_TYPE_BYTE, i);		// Below set point
+  root.putEval(4, CALC_ANDV, 0, 0, EXP_NOOP, 0, 0);			// All rooms cold
+  root.putEval(5, CALC_AVGV, 0, 0, EXP_NOOP, 0, 0);			// Share of rooms cold
+  root.putEval(6, CALC_ORV, 0, 0, EXP_NOOP, 0, 0);				// Any room cold
+  root.putEval(7, CALC_ORV, 0, 1, EXP_NOOP, 0, 0);
+  root.putEval(8, CALC_EVAL, 0, 7, EXP_SET, DEV_TYPE_RELAY, 0);		// Boiler on if any room cold
+  root.putEval(9, CALC_NOW, 0, 0, EXP_NOOP, 0, 0);
+
+  Serial.print("1,000 passes (us): decoded ");
+  Serial.print(timePasses(&interpreted));
+  if (!root.compileEvals()) Serial.println("Not compiled");
+  Serial.print(", compiled ");
+  Serial.print(timePasses(&compiled));
+  Serial.print(", program ");
+  Serial.print(root.evalCodeLen());
+  Serial.println(interpreted == compiled ? " bytes, same results" : " bytes, RESULTS DIFFER");
+
+  arena.seal();
+  arena.report(buffer, 60);
+  Serial.println(buffer);
+}
+
+void loop() {
+  wakeup.runAnyPending();
+}
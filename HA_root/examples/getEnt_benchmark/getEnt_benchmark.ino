@@ -0,0 +1,118 @@
+/* Benchmark of HA_root::getEnt() cost for every entity type
+
+  Compares the old 17-way switch on entType with the operations table (one indexed call through
+  _entGet).  Timer3 runs unprescaled as a cycle counter, so results are in CPU cycles (16 per uS
+  on a Mega).  Interrupts are off while measuring.
+
+  - Switch column re-creates the old getEnt switch in a subclass, so it reaches the same arrays
+  - Table column calls getEnt() itself, bounds check included (as the switch column)
+  Both include the loop and call overhead, which is the same for each
+
+  Two entities of each type are created; the second is read.  Results are printed to Serial at 9600 baud
+
+
+**************************/
+
+
+
+#include "HA_root.h"
+
+static const byte REPEATS = 64;                 // Calls averaged per measurement
+static const byte NUM_EACH = 2;
+
+const char *TYPE_NAMES[NUM_ENT_TYPES] = { "Touch", "Fire", "Heat", "Lum", "Motion", "Presence", "devRFID", "Open",
+                                          "5APwr", "13APwr", "Lock", "Light", "Relay", "varByte", "var2Byte", "varRFID", "Zone" };
+
+// ********** Copy of the old dispatch, with access to the same arrays  **********
+
+class benchRoot : public HA_root {
+public:
+  unsigned int switchGetEnt(byte entType, byte entNum, byte valType) {
+    if (_numEnts[entType] < entNum) Serial.println("bench: OO bounds");
+
+    switch (entType) {
+      case DEV_TYPE_TOUCH:      return entPtrs.ptrTouch[entNum].get(valType);
+      case DEV_TYPE_FIRE:       return entPtrs.ptrFire[entNum].get(valType);
+      case DEV_TYPE_HEAT:       return entPtrs.ptrHeat[entNum].get(valType);
+      case DEV_TYPE_LUMINANCE:  return entPtrs.ptrLuminance[entNum].get(valType);
+      case DEV_TYPE_MOTION:     return entPtrs.ptrMotion[entNum].get(valType);
+      case DEV_TYPE_PRESENCE:   return entPtrs.ptrPresence[entNum].get(valType);
+      case DEV_TYPE_RFID:       return entPtrs.ptrDevRFID[entNum].get(valType);
+      case DEV_TYPE_OPEN:       return entPtrs.ptrOpen[entNum].get(valType);
+      case DEV_TYPE_5APWR:      return entPtrs.ptr5APower[entNum].get(valType);
+      case DEV_TYPE_13APWR:     return entPtrs.ptr13APower[entNum].get(valType);
+      case DEV_TYPE_LOCK:       return entPtrs.ptrLock[entNum].get(valType);
+      case DEV_TYPE_LIGHT:      return entPtrs.ptrLight[entNum].get(valType);
+      case DEV_TYPE_RELAY:      return entPtrs.ptrRelay[entNum].get(valType);
+      case VAR_TYPE_BYTE:       return entPtrs.ptrByte[entNum].get();
+      case VAR_TYPE_2BYTE:      return entPtrs.ptr2Byte[entNum].get();
+      case VAR_TYPE_RFID:       break;
+      case OBJ_TYPE_ZONE:       return entPtrs.ptrZone[entNum].get(valType);
+    }
+    return 0;
+  }
+};
+
+benchRoot bench;
+volatile unsigned int sink;                     // Stops the compiler dropping the calls
+
+// ********** Cycle counter **********
+
+void startCycles() {
+  TCCR3A = 0;
+  TCCR3B = _BV(CS30);       // No prescale
+  TCNT3 = 0;
+}
+
+unsigned int readCycles() {
+  return TCNT3;
+}
+
+unsigned int timeSwitch(byte entType) {
+  startCycles();
+  for (byte i = 0; i < REPEATS; i++) sink = bench.switchGetEnt(entType, NUM_EACH - 1, VAL_DEVIDX);
+  return readCycles() / REPEATS;
+}
+
+unsigned int timeTable(byte entType) {
+  startCycles();
+  for (byte i = 0; i < REPEATS; i++) sink = bench.getEnt(entType, NUM_EACH - 1, VAL_DEVIDX);
+  return readCycles() / REPEATS;
+}
+
+void setup() {
+  Serial.begin(9600);
+
+  for (byte t = 0; t < NUM_ENT_TYPES; t++) {
+    if (!bench.createEntArray(t, NUM_EACH)) {
+      Serial.print("No space for ");
+      Serial.println(TYPE_NAMES[t]);
+    }
+  }
+
+  Serial.println("getEnt cycles per call");
+  Serial.println("type      switch  table");
+
+  unsigned long totalSwitch = 0, totalTable = 0;
+  for (byte t = 0; t < NUM_ENT_TYPES; t++) {
+    noInterrupts();
+    unsigned int s = timeSwitch(t);
+    unsigned int c = timeTable(t);
+    interrupts();
+
+    totalSwitch += s;
+    totalTable += c;
+    Serial.print(TYPE_NAMES[t]);
+    for (byte pad = strlen(TYPE_NAMES[t]); pad < 10; pad++) Serial.print(' ');
+    Serial.print(s);
+    Serial.print('\t');
+    Serial.println(c);
+  }
+  Serial.print("mean      ");
+  Serial.print(totalSwitch / NUM_ENT_TYPES);
+  Serial.print('\t');
+  Serial.println(totalTable / NUM_ENT_TYPES);
+}
+
+void loop() {
+}
@@ -0,0 +1,128 @@
+/* Reference lookup - text references to entities, through root.findRef
+
+  Lights, relays and heat sensors are given references as usual with putRef, then indexed once with root.indexRefs()
+  before the arena is sealed.  1,000 lookups are timed three ways - getRef on every entity until one matches (the old
+  way), findRef before the index exists (a scan of the reference's type) and findRef through the index - and the times
+  printed to Serial at 9600 baud.
+
+  Type a reference (G1.03.L2, vI.03, D1) and return to look it up.
+
+
+**************************/
+
+
+
+#include "Wakeup.h"
+#include "HA_switcher.h"
+#include "HA_root.h"
+#include "HA_arena.h"
+
+static const byte NUM_LIGHTS = 24;
+static const byte NUM_RELAYS = 8;
+static const byte NUM_HEATS = 8;
+static const char REGIONS[] = "GDSEKB";
+
+char refs[8][10];
+
+boolean scanRef(char *ref, byte *entType, byte *entNum) {		// getRef every entity until one matches
+  char buffer[10];
+
+  for (byte t = 0; t <= OBJ_TYPE_ZONE; t++) {
+    for (byte n = 0; n < root.numEnts(t); n++) {
+      root.getRef(t, n, buffer);
+      if (strcmp(buffer, ref) == 0) {
+        *entType = t;
+        *entNum = n;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void putRefs(byte devType, byte numDevs) {
+  char ref[10];
+  char code[TYPE_CODE_LEN];
+
+  getDevTypeChar(devType, code);
+  for (byte n = 0; n < numDevs; n++) {
+    sprintf(ref, "%c%d.%02d.%s%d", REGIONS[n % 6], n / 6 + 1, n % 4 + 1, code, n % 3 + 1);
+    root.putRef(devType, n, ref);
+  }
+}
+
+unsigned long timeLookups(boolean scan) {
+  byte entType, entNum;
+  unsigned long started = micros();
+
+  for (int i = 0; i < 1000; i++) {
+    if (scan) scanRef(refs[i & 7], &entType, &entNum);
+    else root.findRef(refs[i & 7], &entType, &entNum);
+  }
+  return micros() - started;
+}
+
+void setup() {
+  char buffer[60];
+
+  Serial.begin(9600);
+  wakeup.init();
+  initSwitcher();
+
+  if (!root.createEntArray(DEV_TYPE_LIGHT, NUM_LIGHTS) || !root.createEntArray(DEV_TYPE_RELAY, NUM_RELAYS)
+      || !root.createEntArray(DEV_TYPE_HEAT, NUM_HEATS) || !root.createEntArray(VAR_TYPE_2BYTE, 8)) {
+    Serial.println("No space - raise HA_ARENA_SIZE");
+    return;
+  }
+  putRefs(DEV_TYPE_LIGHT, NUM_LIGHTS);
+  putRefs(DEV_TYPE_RELAY, NUM_RELAYS);
+  putRefs(DEV_TYPE_HEAT, NUM_HEATS);
+
+  for (byte i = 0; i < 8; i++) {						// Spread over the types, with one miss
+    switch (i % 4) {
+      case 0: root.getRef(DEV_TYPE_LIGHT, NUM_LIGHTS - 1 - i, refs[i]); break;
+      case 1: root.getRef(DEV_TYPE_RELAY, i, refs[i]); break;
+      case 2: root.getRef(DEV_TYPE_HEAT, i, refs[i]); break;
+      case 3: strcpy(refs[i], (i == 3) ? "vI.05" : "K8.64.L7"); break;
+    }
+  }
+
+  Serial.print("1,000 lookups (us): getRef scan ");
+  Serial.print(timeLookups(true));
+  Serial.print(", findRef unindexed ");
+  Serial.print(timeLookups(false));
+  if (!root.indexRefs()) Serial.println("No space for the index");
+  Serial.print(", findRef indexed ");
+  Serial.println(timeLookups(false));
+
+  arena.seal();
+  arena.report(buffer, 60);
+  Serial.println(buffer);
+}
+
+void loop() {
+  static char ref[10];
+  static byte len = 0;
+  byte entType, entNum;
+
+  wakeup.runAnyPending();
+
+  int c = Serial.read();
+  if (c < 0) return;
+  if (c != '\r' && c != '\n') {
+    if (len < sizeof(ref) - 1) ref[len++] = c;
+    return;
+  }
+  if (len == 0) return;
+  ref[len] = '\0';
+  len = 0;
+
+  Serial.print(ref);
+  if (root.findRef(ref, &entType, &entNum)) {
+    Serial.print(" = type ");
+    Serial.print(entType);
+    Serial.print(" num ");
+    Serial.println(entNum);
+  }
+  else Serial.println(" not found");
+}
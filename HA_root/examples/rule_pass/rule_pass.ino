@@ -0,0 +1,83 @@
+/* Rule pass - only the evaluations whose inputs have changed, through root.runChangedEvals
+
+  Sixteen rooms, each with a heat sensor, a set point (byte variable) and a radiator relay.  An evaluation per room
+  compares the two and sets the relay; an OR over the rooms runs the boiler.  Once root.indexEvals() has worked out
+  who reads what, a pass every second runs only the rooms whose sensor or set point has changed, and the boiler only
+  if a room's answer changed.  With root.memoEvals(), a room the OR reads that has already run in the pass is not run
+  again.  How many ran, and the memo's hits and misses, are printed to Serial at 9600 baud.
+
+  Type a room number (0-15) and return to raise its set point by a degree.
+
+
+**************************/
+
+
+
+#include "Wakeup.h"
+#include "HA_switcher.h"
+#include "HA_root.h"
+#include "HA_arena.h"
+
+static const byte NUM_ROOMS = 16;
+
+void rulePass() {
+  char buffer[60];
+  byte ran = root.runChangedEvals();
+
+  if (ran == 0) return;
+  Serial.print(ran);
+  Serial.print(" of ");
+  Serial.print(root.numEvals());
+  Serial.print(" ran, boiler ");
+  Serial.println(root.lastEval(NUM_ROOMS) ? "on" : "off");
+  root.memoReport(buffer, 60);
+  Serial.println(buffer);
+}
+
+void setup() {
+  char buffer[60];
+
+  Serial.begin(9600);
+  wakeup.init();
+  initSwitcher();
+
+  if (!root.createChanArray(1) || !root.createEntArray(DEV_TYPE_HEAT, NUM_ROOMS) || !root.createEntArray(DEV_TYPE_RELAY, NUM_ROOMS + 1)
+      || !root.createEntArray(VAR_TYPE_BYTE, NUM_ROOMS) || !root.createArgListArray(1) || !root.createEvalArray(NUM_ROOMS + 2)) {
+    Serial.println("No space - raise HA_ARENA_SIZE");
+    return;
+  }
+  root.initChan(0, CHAN_PROTOCOL_PIO, 1, 0);
+  root.initChanAccess(0, CHAN_ACCESS_DIRECT, 0, 0, 0);
+  root.createArgList(0, NUM_ROOMS);
+
+  for (byte i = 0; i < NUM_ROOMS; i++) {
+    root.initDev(DEV_TYPE_RELAY, i, 0, 22 + i, 0);
+    root.putEnt(VAR_TYPE_BYTE, i, VAL_PUSH, (unsigned int)200);
+    root.putEval(i, CALC_DEV, DEV_TYPE_HEAT, i, EXP_LT, VAR_TYPE_BYTE, i);							// Below set point
+    root.putArg(0, i, i);
+  }
+  root.initDev(DEV_TYPE_RELAY, NUM_ROOMS, 0, 22 + NUM_ROOMS, 0);
+  root.putEval(NUM_ROOMS, CALC_ORV, 0, 0, EXP_NOOP, 0, 0);														// Any room cold
+  root.putEval(NUM_ROOMS + 1, CALC_EVAL, 0, NUM_ROOMS, EXP_SET, DEV_TYPE_RELAY, NUM_ROOMS);	// Boiler
+
+  if (!root.indexEvals()) Serial.println("Not indexed - every pass runs everything");
+  if (!root.memoEvals()) Serial.println("No memo");
+  arena.seal();
+  arena.report(buffer, 60);
+  Serial.println(buffer);
+
+  wakeup.wakeMeAfter(rulePass, 1, REPEAT_COUNT | UNITS_SECONDS);
+}
+
+void loop() {
+  static byte room = 0;
+
+  wakeup.runAnyPending();
+
+  int c = Serial.read();
+  if (c >= '0' && c <= '9') room = room * 10 + c - '0';
+  else if (c == '\r' || c == '\n') {
+    if (room < NUM_ROOMS) root.putEnt(VAR_TYPE_BYTE, room, VAL_PUSH, root.getEnt(VAR_TYPE_BYTE, room, VAL_CURR) + 10);
+    room = 0;
+  }
+}
@@ -0,0 +1,152 @@
+ /*
+	*****************  HA host build  **********************
+
+	Stand-in for the Arduino core, so the HA libraries can be compiled and run on a PC.  Serial and the network
+	classes swallow what is written to them, pins and SPI registers are plain variables, and time comes from the
+	virtual Timer1 in Wakeup/host.  Supersedes Wakeup/host/Arduino.h, so goes first on the include path - see
+	HostCore.h.  Kept in host/ so the Arduino IDE never sees it
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+#include <time.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#include "binary.h"
+
+// Single threaded - interrupts only ever 'happen' inside hostTimer.advance(), and only if the I bit is set
+static const byte SREG_I = 0x80;
+extern byte SREG;
+inline void cli() { SREG &= ~SREG_I; }
+inline void sei() { SREG |= SREG_I; }
+inline void noInterrupts() { cli(); }
+inline void interrupts() { sei(); }
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define BIN 2
+#define MSBFIRST 1
+#define LSBFIRST 0
+static const uint8_t A0 = 54;
+
+#define _BV(b) (1 << (b))
+#define PROGMEM
+#define F(s) s
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bitRead(v, b) (((v) >> (b)) & 1)
+#define bitSet(v, b) ((v) |= (1UL << (b)))
+#define bitClear(v, b) ((v) &= ~(1UL << (b)))
+#define bitWrite(v, b, x) ((x) ? bitSet(v, b) : bitClear(v, b))
+#define time_t ard_time_t												// Time.h has its own
+
+class __FlashStringHelper;
+
+// Output is dropped - a test checks state, not what would have been printed
+struct Print {
+	virtual size_t write(uint8_t) = 0;
+	virtual size_t write(const uint8_t *buf, size_t size) { return size; }
+	size_t write(const char *str) { return strlen(str); }
+	template<class T> size_t print(T) { return 0; }
+	template<class T> size_t print(T, int) { return 0; }
+	template<class T> size_t println(T) { return 0; }
+	template<class T> size_t println(T, int) { return 0; }
+	size_t println() { return 0; }
+};
+
+struct Stream : Print {
+	virtual int available() { return 0; }
+	virtual int read() { return -1; }
+	virtual int peek() { return -1; }
+	virtual void flush() {}
+};
+
+// Serial counts what would have been printed, so a test can see diagnostics turn up where none should
+struct HardwareSerial : Stream {
+	unsigned long prints;
+	size_t write(uint8_t) { return 1; }
+	using Print::write;
+	template<class T> size_t print(T) { prints++; return 0; }
+	template<class T> size_t print(T, int) { prints++; return 0; }
+	template<class T> size_t println(T) { prints++; return 0; }
+	template<class T> size_t println(T, int) { prints++; return 0; }
+	size_t println() { prints++; return 0; }
+	void begin(long) {}
+};
+extern HardwareSerial Serial, Serial1, Serial2, Serial3;
+
+unsigned long micros();														// Simulated clock, see Wakeup/host/WakeupHost.h
+unsigned long millis();
+void delay(unsigned long);
+void delayMicroseconds(unsigned int);
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+int analogRead(uint8_t);
+void analogWrite(uint8_t, int);
+void attachInterrupt(uint8_t, void (*)(), int);
+void detachInterrupt(uint8_t);
+void shiftOut(uint8_t, uint8_t, uint8_t, uint8_t);
+uint8_t shiftIn(uint8_t, uint8_t, uint8_t);
+
+// SPI and Timer3 registers, as used by SPI, Mcp23s17 and HA_channels
+extern volatile uint8_t SPDR, SPSR, SPCR, TCCR3A, TCCR3B, TIFR1, EIMSK;
+extern volatile uint16_t TCNT3;
+#define SPIF 7
+#define SPIE 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+#define CPOL 3
+#define CPHA 2
+#define SPR1 1
+#define SPR0 0
+#define SPI2X 0
+#define CS30 0
+#define SS 53
+#define MOSI 51
+#define MISO 50
+#define SCK 52
+
+#include "WString.h"
+#include "IPAddress.h"
+
+extern byte arduinoMe;
+
+#endif
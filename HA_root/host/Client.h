@@ -0,0 +1,10 @@
+// HA host build - a client that is always connected and writes nowhere.  See HostCore.h
+#pragma once
+#include "Arduino.h"
+
+class Client : public Stream {
+	public:
+		size_t write(uint8_t) { return 1; }
+		using Print::write;
+		virtual operator bool() { return true; }
+};
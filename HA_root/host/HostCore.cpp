@@ -0,0 +1,105 @@
+ /*
+	*****************  HA host build  **********************
+
+	What the Arduino core and the sketch would provide, for the HA libraries on a PC - see HostCore.h
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HostCore.h"
+#include "HA_globals.h"
+#include "HA_root.h"
+#include "HA_arena.h"
+#include "HA_switcher.h"
+#include "Wakeup.h"
+#include "HA_image.h"											// E2END, as the Mega
+#include "EEPROM.h"
+#include "EthernetUdp.h"
+#include <new>
+
+// Core
+HardwareSerial Serial, Serial1, Serial2, Serial3;
+uint8_t hostPins[HOST_PINS];
+volatile uint8_t SPDR, SPSR, SPCR, TCCR3A, TCCR3B, TIFR1, EIMSK;
+volatile uint16_t TCNT3;
+
+void delay(unsigned long ms) {}
+void delayMicroseconds(unsigned int us) {}
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) { if (pin < HOST_PINS) hostPins[pin] = val; }
+int digitalRead(uint8_t pin) { return LOW; }
+int analogRead(uint8_t pin) { return 0; }
+void analogWrite(uint8_t pin, int val) {}
+void attachInterrupt(uint8_t irq, void (*isr)(), int mode) {}
+void detachInterrupt(uint8_t irq) {}
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t order, uint8_t val) {}
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t order) { return 0; }
+
+// Sketch
+extern const char REGIONCODES[NUMREGIONCODES + 1] = { 'G', 'D', 'S', 'E', 'K', 'B', 0 };
+byte arduinoMe = 1;
+char meName[] = "HOST";
+
+unsigned int hostDhm = 0;
+unsigned int dhmNow() { return hostDhm; }
+int year() { return 2026; }
+int month() { return 1; }
+
+void hostReboot() {
+	root.~HA_root();
+	memset((void*)&root, 0, sizeof(root));
+	new (&root) HA_root();
+	arena.~HA_arena();
+	new (&arena) HA_arena();
+	wakeup.init();
+	initSwitcher();
+	memset(hostPins, LOW, sizeof(hostPins));
+}
+
+// Storage
+uint8_t hostEeprom[E2END + 1];
+unsigned long hostEepromWrites = 0;
+
+uint8_t EEPROMClass::read(int addr) {
+	return hostEeprom[addr];
+}
+
+void EEPROMClass::write(int addr, uint8_t val) {
+	hostEeprom[addr] = val;
+	hostEepromWrites++;
+}
+
+EEPROMClass EEPROM;
+SDSlot sdSlots[SD_SLOTS];
+SDClass SD;
+
+// Network - nothing arrives, and everything sent is lost
+EthernetUDP::EthernetUDP() {}
+uint8_t EthernetUDP::begin(uint16_t port) { return 1; }
+uint8_t EthernetUDP::beginMulticast(IPAddress ip, uint16_t port) { return 1; }
+void EthernetUDP::stop() {}
+int EthernetUDP::beginPacket(IPAddress ip, uint16_t port) { return 1; }
+int EthernetUDP::beginPacket(const char *host, uint16_t port) { return 1; }
+int EthernetUDP::endPacket() { return 1; }
+size_t EthernetUDP::write(uint8_t val) { return 1; }
+size_t EthernetUDP::write(const uint8_t *buf, size_t size) { return size; }
+int EthernetUDP::parsePacket() { return 0; }
+int EthernetUDP::available() { return 0; }
+int EthernetUDP::read() { return -1; }
+int EthernetUDP::read(unsigned char *buf, size_t size) { return 0; }
+int EthernetUDP::peek() { return -1; }
+void EthernetUDP::flush() {}
@@ -0,0 +1,59 @@
+ /*
+	*****************  HA host build  **********************
+
+	Description
+	-----------
+
+	Runs HA_root and the libraries under it on a PC, for tests and benchmarks that a Mega can't hold or time.  This
+	directory stands in for the Arduino core (Arduino.h and the few library headers the HA code includes), and
+	HostCore.cpp provides what the sketch and the core would: Serial, pins, the clock of the virtual Timer1 in
+	Wakeup/host, an EEPROM and an SD card in memory, and a settable dhmNow().  Kept in host/ so the Arduino IDE never
+	sees it
+
+	From the repository root, with any options for the test after the output name:
+
+		sh HA_root/host/build.sh HA_root/host/RefBench.cpp refbench
+		./refbench
+
+	The tests:
+		- HA_root/host/RefBench.cpp      findRef against a scan for 1,000 references, and indexRefs on random configs
+		- HA_root/host/SnapTest.cpp      snapshot streams of every type, in JSON and binary, against each entity's reading
+		- HA_image/host/ImageTest.cpp    saved state images through memory, EEPROM and SD, and their rejection
+
+	Each prints PASSED or FAILED and exits 1 on failure.  Run them after any change to the code they cover
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HostCore_h
+#define HostCore_h
+
+#include "Arduino.h"
+#include "SD.h"
+
+#define CHECK(cond, ...) do { if (!(cond)) { fails++; printf("FAIL %s:%d  ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static const uint8_t HOST_PINS = 70;							// As the Mega
+
+extern unsigned int hostDhm;											// What dhmNow() returns
+extern uint8_t hostPins[];												// Last digitalWrite to each pin - LOW after hostReboot(), as at power on
+extern uint8_t hostEeprom[];											// E2END + 1 bytes
+extern unsigned long hostEepromWrites;						// Bytes actually written - EEPROM wears
+
+void hostReboot();																// Fresh root, arena and pins, as after a reset - configuration is lost
+
+#endif
@@ -0,0 +1,12 @@
+// HA host build - every address is 0.0.0.0.  See HostCore.h
+#pragma once
+
+class IPAddress {
+	public:
+		IPAddress() {}
+		IPAddress(uint8_t, uint8_t, uint8_t, uint8_t) {}
+		IPAddress(const uint8_t*) {}
+		uint8_t operator[](int) const { return 0; }
+		uint8_t &operator[](int) { static uint8_t octet; return octet; }
+		operator uint32_t() const { return 0; }
+};
@@ -0,0 +1,24 @@
+// HA host build - a bus with nothing on it.  See HostCore.h
+#pragma once
+#include "Arduino.h"
+
+class OneWire {
+	public:
+		OneWire() {}
+		OneWire(uint8_t) {}
+		template<class... Args> uint8_t init(Args...) { return 1; }
+		template<class... Args> uint8_t readROM(Args...) { return 1; }
+		uint8_t reset() { return 1; }
+		void select(const uint8_t*) {}
+		void skip() {}
+		void write(uint8_t, uint8_t = 0) {}
+		void write_bytes(const uint8_t*, uint16_t, bool = 0) {}
+		uint8_t read() { return 0; }
+		void read_bytes(uint8_t*, uint16_t) {}
+		void write_bit(uint8_t) {}
+		uint8_t read_bit() { return 0; }
+		void depower() {}
+		void reset_search() {}
+		uint8_t search(uint8_t*) { return 0; }
+		static uint8_t crc8(const uint8_t*, uint8_t) { return 0; }
+};
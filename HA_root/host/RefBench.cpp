@@ -0,0 +1,204 @@
+ /*
+	*****************  HA host build  **********************
+
+	Description
+	-----------
+
+	Resolves 1,000 textual references against 1,000 devices - more than any Mega holds, to show how findRef and
+	indexRefs scale - and checks every answer against the old way, getRef on each entity until one matches.  Then
+	random configurations, some with the same ref on several devices, must all index and give the same answers as
+	the scan (the first device with a ref keeps it).  Prints the time of each way and exits 1 on any difference, or
+	if indexRefs takes more than BUILD_LIMIT_MS for the 1,000 devices.  From the repository root:
+
+		sh HA_root/host/build.sh HA_root/host/RefBench.cpp refbench
+		./refbench
+
+	1,000 devices need far more than a Mega's arena, so build.sh gives this test HA_ARENA_SIZE 65536.  Built with
+	less, it stops at the first array that does not fit rather than run on without it
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HostCore.h"
+#include "HA_root.h"
+#include "HA_arena.h"
+
+static const unsigned int NUM_REFS = 1000;
+static const byte REPEATS = 50;												// Of each timed pass over the refs
+static const double BUILD_LIMIT_MS = 50.0;							// indexRefs on 1,000 devices; the scan version took seconds
+static const unsigned int RANDOM_CONFIGS = 500;
+
+// 1,000 devices across the types, and a few variables and zones for findRef to decode
+static const byte TYPES[] = { DEV_TYPE_LIGHT, DEV_TYPE_RELAY, DEV_TYPE_HEAT, DEV_TYPE_PRESENCE, DEV_TYPE_OPEN, DEV_TYPE_LUMINANCE, DEV_TYPE_5APWR };
+static const byte COUNTS[] = { 200, 160, 160, 160, 160, 120, 40 };
+static const byte NUM_VARS = 8;
+static const byte NUM_ZONES = 4;
+static const char REGIONS[] = "GDSEKB";
+
+int fails;
+byte counts[sizeof(TYPES)];
+
+double nowMs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+boolean scanRef(char *ref, byte *entType, byte *entNum) {		// The old way
+	char buf[12];
+
+	for (byte t = 0; t <= OBJ_TYPE_ZONE; t++) {
+		for (byte n = 0; n < root.numEnts(t); n++) {
+			root.getRef(t, n, buf);
+			if (strcmp(buf, ref) == 0) {
+				*entType = t;
+				*entNum = n;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void need(boolean created, const char *what, unsigned int num) {		// Nothing is any use without the arrays
+	if (created) return;
+	printf("FAILED: no arena space for %u %s - HA_ARENA_SIZE is %u, build with build.sh\n", num, what, arena.size());
+	exit(1);
+}
+
+void makeRef(byte devType, byte n, unsigned int seed, char *ref) {		// Unique per device, or from seed if not zero
+	char code[3];
+	char num[3] = "";
+	unsigned int place = seed ? seed : n;
+	int devNum = (devType == DEV_TYPE_OPEN) ? 1 + n % 4 : n % 3;
+
+	getDevTypeChar(devType, code);
+	if (devNum || devType == DEV_TYPE_OPEN) sprintf(num, "%d", devNum);
+	sprintf(ref, "%c%d.%02d.%s%s", REGIONS[place % 6], (place / 6) % 8 + 1, (place / 48) % 64 + 1, code, num);
+}
+
+// Every device given a ref - with dupRange, refs are drawn from that many places so some are shared
+void configure(unsigned int scale, unsigned int dupRange) {
+	char ref[12];
+
+	hostReboot();
+	need(root.createChanArray(1), "channels", 1);
+	root.initChan(0, CHAN_PROTOCOL_PIO, 1, 0);
+	root.initChanAccess(0, CHAN_ACCESS_DIRECT, 0, 0, 0);
+	for (byte i = 0; i < sizeof(TYPES); i++) {
+		counts[i] = COUNTS[i] / scale;
+		need(root.createEntArray(TYPES[i], counts[i]), "devices", counts[i]);
+		for (byte n = 0; n < counts[i]; n++) {
+			root.initDev(TYPES[i], n, 0, n % 40 + 2, 0);
+			makeRef(TYPES[i], n, dupRange ? 1 + rand() % dupRange : 0, ref);
+			root.putRef(TYPES[i], n, ref);
+		}
+	}
+	need(root.createEntArray(VAR_TYPE_2BYTE, NUM_VARS), "variables", NUM_VARS);
+	need(root.createEntArray(OBJ_TYPE_ZONE, NUM_ZONES), "zones", NUM_ZONES);
+	for (byte z = 0; z < NUM_ZONES; z++) {
+		root.putEnt(OBJ_TYPE_ZONE, z, VAL_REGION, (unsigned int)'D');
+		root.putEnt(OBJ_TYPE_ZONE, z, VAL_ZONE, (unsigned int)(z + 1));
+	}
+}
+
+void compare(char refs[][12], unsigned int num, const char *when) {
+	byte scanType, scanNum, findType, findNum;
+
+	for (unsigned int i = 0; i < num; i++) {
+		boolean scanned = scanRef(refs[i], &scanType, &scanNum);
+		boolean found = root.findRef(refs[i], &findType, &findNum);
+		CHECK(scanned == found && (!scanned || (scanType == findType && scanNum == findNum)), "%s: %s scan %d %d/%d, findRef %d %d/%d",
+			when, refs[i], scanned, scanType, scanNum, found, findType, findNum);
+	}
+}
+
+double timeLookups(boolean (*lookup)(char*, byte*, byte*), char refs[][12]) {
+	volatile unsigned int hits = 0;
+	byte entType, entNum;
+	double start = nowMs();
+
+	for (byte r = 0; r < REPEATS; r++) {
+		for (unsigned int i = 0; i < NUM_REFS; i++) hits += lookup(refs[i], &entType, &entNum);
+	}
+	return (nowMs() - start) / REPEATS;
+}
+
+boolean findRef(char *ref, byte *entType, byte *entNum) {
+	return root.findRef(ref, entType, entNum);
+}
+
+int main() {
+	static char refs[NUM_REFS][12];
+	unsigned int devices = 0;
+
+	srand(19);
+	configure(1, 0);
+	for (byte i = 0; i < sizeof(TYPES); i++) devices += counts[i];
+
+	for (unsigned int i = 0; i < NUM_REFS; i++) {						// Devices mostly, then variables, zones and refs to nothing
+		int kind = rand() % 100;
+		if (kind < 85) {
+			byte t = rand() % sizeof(TYPES);
+			root.getRef(TYPES[t], rand() % counts[t], refs[i]);
+		}
+		else if (kind < 90) root.getRef(VAR_TYPE_2BYTE, rand() % NUM_VARS, refs[i]);
+		else if (kind < 95) root.getRef(OBJ_TYPE_ZONE, rand() % NUM_ZONES, refs[i]);
+		else sprintf(refs[i], "K%d.%02d.L%d", rand() % 8 + 1, rand() % 64 + 1, rand() % 7);
+	}
+
+	double scanMs = timeLookups(scanRef, refs);
+	double typeScanMs = timeLookups(findRef, refs);					// No index yet - findRef scans the one type
+	unsigned int used = arena.used();
+	double start = nowMs();
+	CHECK(root.indexRefs(), "indexRefs failed on %u devices", devices);
+	double buildMs = nowMs() - start;
+	unsigned int indexBytes = arena.used() - used;
+	CHECK(buildMs < BUILD_LIMIT_MS, "indexRefs took %.1fms for %u devices, limit %.0fms", buildMs, devices, BUILD_LIMIT_MS);
+	CHECK(arena.highWater() - used <= indexBytes + devices * 16 + 8, "indexRefs peaked at %u bytes", arena.highWater() - used);		// 6 bytes a device while building on the AVR, 16 with 64 bit longs
+	double indexMs = timeLookups(findRef, refs);
+	compare(refs, NUM_REFS, "indexed");
+
+	printf("%u devices: indexRefs %.2fms, %u bytes of arena kept\n", devices, buildMs, indexBytes);
+	printf("%u refs: getRef scan %.3fms, findRef scan of type %.3fms, findRef indexed %.3fms\n", NUM_REFS, scanMs, typeScanMs, indexMs);
+
+	// A changed ref is found by scanning until the index is rebuilt, and the rebuild reuses its space
+	char moved[] = "E8.64.L";
+	byte entType, entNum;
+	root.putRef(DEV_TYPE_LIGHT, 7, moved);
+	CHECK(root.findRef(moved, &entType, &entNum) && entType == DEV_TYPE_LIGHT && entNum == 7, "changed ref not found with index stale");
+	used = arena.used();
+	CHECK(root.indexRefs() && arena.used() == used, "rebuild failed or took more arena (%u to %u)", used, arena.used());
+	CHECK(root.findRef(moved, &entType, &entNum) && entType == DEV_TYPE_LIGHT && entNum == 7, "changed ref not found after rebuild");
+	compare(refs, NUM_REFS, "rebuilt");
+
+	// Random configurations, a third with many devices sharing refs
+	for (unsigned int trial = 0; trial < RANDOM_CONFIGS; trial++) {
+		char ref[12];
+		configure(1 + trial % 8, (trial % 3) ? 3000 : 20);
+		CHECK(root.indexRefs(), "config %u did not index", trial);
+		for (byte i = 0; i < sizeof(TYPES); i++) {
+			for (byte n = 0; n < counts[i]; n++) {
+				root.getRef(TYPES[i], n, ref);
+				compare(&ref, 1, "random config");
+			}
+		}
+	}
+
+	printf("%s (%d failures)\n", fails ? "FAILED" : "PASSED", fails);
+	return fails ? 1 : 0;
+}
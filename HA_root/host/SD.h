@@ -0,0 +1,65 @@
+// HA host build - files held in memory, in a few fixed slots a test can inspect and damage.  See HostCore.h
+#pragma once
+#include "Arduino.h"
+
+#define FILE_READ 0
+#define FILE_WRITE 1
+
+static const byte SD_SLOTS = 4;
+static const unsigned int SD_FILE_SIZE = 4096;
+
+struct SDSlot {
+	char name[16];
+	bool used;
+	unsigned int len;
+	uint8_t data[SD_FILE_SIZE];
+};
+extern SDSlot sdSlots[SD_SLOTS];
+
+class File : public Stream {
+	public:
+		File(SDSlot *slot = NULL) : _slot(slot), _pos(0) {}
+		size_t write(uint8_t val) {
+			if (!_slot || _slot->len >= SD_FILE_SIZE) return 0;					// Card full
+			_slot->data[_slot->len++] = val;
+			return 1;
+		}
+		using Print::write;
+		int read() { return (_slot && _pos < _slot->len) ? _slot->data[_pos++] : -1; }
+		int available() { return _slot ? _slot->len - _pos : 0; }
+		bool seek(unsigned long pos) { _pos = pos; return true; }
+		unsigned long position() { return _pos; }
+		unsigned long size() { return _slot ? _slot->len : 0; }
+		operator bool() { return _slot != NULL; }
+		void close() { _slot = NULL; }
+	private:
+		SDSlot *_slot;
+		unsigned int _pos;
+};
+
+class SDClass {
+	public:
+		bool begin(uint8_t = 0) { return true; }
+		File open(const char *name, uint8_t mode = FILE_READ) {
+			SDSlot *slot = find(name);
+			for (byte i = 0; !slot && mode == FILE_WRITE && i < SD_SLOTS; i++) {
+				if (sdSlots[i].used) continue;
+				slot = &sdSlots[i];
+				slot->used = true;
+				strncpy(slot->name, name, sizeof(slot->name) - 1);
+				slot->len = 0;
+			}
+			return File(slot);
+		}
+		bool exists(const char *name) { return find(name) != NULL; }
+		bool remove(const char *name) {
+			SDSlot *slot = find(name);
+			if (slot) slot->used = false;
+			return slot != NULL;
+		}
+		SDSlot *find(const char *name) {
+			for (byte i = 0; i < SD_SLOTS; i++) if (sdSlots[i].used && !strcmp(sdSlots[i].name, name)) return &sdSlots[i];
+			return NULL;
+		}
+};
+extern SDClass SD;
@@ -0,0 +1,9 @@
+// HA host build - see HostCore.h
+#pragma once
+#include "Arduino.h"
+
+class Server : public Print {
+	public:
+		size_t write(uint8_t) { return 1; }
+		using Print::write;
+};
@@ -0,0 +1,152 @@
+ /*
+	*****************  HA host build  **********************
+
+	Description
+	-----------
+
+	Snapshot streams of HA_root (HA_root.h) on a PC.  Devices, variables and zones are given readings, some zones
+	occupied, and every record of SNAP_ALL and of each single type, in JSON and binary, must carry the reading the
+	entity's own accessor gives - occupancy for a zone.  Chunks the size GET /snapshot uses and the smallest allowed
+	must give the same stream, and nothing may be printed to Serial while it is sent.  Prints FAIL with the file and
+	line and what was seen, and exits 1 if any failed.  From the repository root:
+
+		sh HA_root/host/build.sh HA_root/host/SnapTest.cpp snaptest
+		./snaptest
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HostCore.h"
+#include "HA_root.h"
+
+static const byte TYPES[] = { DEV_TYPE_LIGHT, DEV_TYPE_RELAY, DEV_TYPE_HEAT, VAR_TYPE_BYTE, VAR_TYPE_2BYTE, OBJ_TYPE_ZONE };
+static const byte COUNTS[] = { 6, 2, 3, 2, 2, 4 };
+static const unsigned int STREAM_LEN = 4096;
+static const unsigned int CHUNK_WEB = 256;										// As HA_web's SNAP_CHUNK
+static const unsigned int CHUNK_MIN = SNAP_JSON_MAX + 2;
+
+int fails;
+
+// What a client would have been sent
+class Capture : public Print {
+	public:
+		Capture() : len(0), writes(0) {}
+		size_t write(uint8_t val) { return write(&val, 1); }
+		size_t write(const uint8_t *buf, size_t size) {
+			if (len + size >= STREAM_LEN) return 0;
+			memcpy(data + len, buf, size);
+			len += size;
+			data[len] = '\0';
+			writes++;
+			return size;
+		}
+
+		char data[STREAM_LEN];
+		unsigned int len;
+		unsigned int writes;
+};
+
+void configure() {
+	hostReboot();
+	root.createChanArray(1);
+	root.initChanAccess(0, CHAN_ACCESS_DIRECT, 0, 0, 0);
+	for (byte i = 0; i < sizeof(TYPES); i++) CHECK(root.createEntArray(TYPES[i], COUNTS[i]), "no space for type %d", TYPES[i]);
+
+	for (byte n = 0; n < COUNTS[0]; n++) root.putEnt(DEV_TYPE_LIGHT, n, VAL_PUSH, (unsigned int)(n % 2));
+	for (byte n = 0; n < COUNTS[2]; n++) root.putEnt(DEV_TYPE_HEAT, n, VAL_PUSH, (unsigned int)(1900 + n * 37));
+	for (byte n = 0; n < COUNTS[3]; n++) root.putEnt(VAR_TYPE_BYTE, n, VAL_PUSH, (unsigned int)(17 + n));
+	for (byte n = 0; n < COUNTS[4]; n++) root.putEnt(VAR_TYPE_2BYTE, n, VAL_PUSH, (unsigned int)(50000 + n));
+	root.putEnt(OBJ_TYPE_ZONE, 1, VAL_OCCUPANCY, ON);
+	root.putEnt(OBJ_TYPE_ZONE, 3, VAL_OCCUPANCY, ON);
+	root.putEnt(OBJ_TYPE_ZONE, 2, VAL_TARG_TEMP, (unsigned int)2150);						// Not the zone's reading
+}
+
+// The reading each record should carry, from the type's own accessor rather than VAL_CURR on everything
+unsigned int reading(byte entType, byte entNum) {
+	return root.getEnt(entType, entNum, (entType == OBJ_TYPE_ZONE) ? VAL_OCCUPANCY : VAL_CURR);
+}
+
+unsigned int expected(byte onlyType) {
+	unsigned int num = 0;
+
+	for (byte t = 0; t < NUM_ENT_TYPES; t++) {
+		if (onlyType == SNAP_ALL || onlyType == t) num += root.numEnts(t);
+	}
+	return num;
+}
+
+unsigned int stream(Capture &out, byte entType, byte format, unsigned int chunk) {
+	byte buffer[CHUNK_WEB];
+	unsigned long prints = Serial.prints;
+
+	unsigned int sent = root.snapStream(out, buffer, chunk, entType, format);
+	CHECK(Serial.prints == prints, "type %d format %d: %lu lines printed to Serial while streaming", entType, format, Serial.prints - prints);
+	return sent;
+}
+
+void testJson(byte entType) {
+	Capture web, small;
+	char record[SNAP_JSON_MAX + 1];
+	char code[TYPE_CODE_LEN];
+	unsigned int sent = stream(web, entType, SNAP_JSON, CHUNK_WEB);
+
+	CHECK(sent == expected(entType), "type %d: %u JSON records, expected %u", entType, sent, expected(entType));
+	CHECK(web.len >= 2 && web.data[0] == '[' && web.data[web.len - 1] == ']', "type %d: JSON not an array: %s", entType, web.data);
+	for (byte t = 0; t < NUM_ENT_TYPES; t++) {
+		if (entType != SNAP_ALL && entType != t) continue;
+		getDevTypeChar(t, code);
+		for (byte n = 0; n < root.numEnts(t); n++) {
+			sprintf(record, "{\"t\":\"%s\",\"n\":%d,\"v\":%u,\"s\":%d}", code, n, reading(t, n), (t < NUM_DEV_TYPES) ? root.getEnt(t, n, VAL_STATUS) : 0);
+			CHECK(strstr(web.data, record), "type %d: no %s in %s", entType, record, web.data);
+		}
+	}
+
+	stream(small, entType, SNAP_JSON, CHUNK_MIN);
+	CHECK(strcmp(web.data, small.data) == 0, "type %d: JSON differs in %u byte chunks: %s", entType, CHUNK_MIN, small.data);
+	CHECK(small.writes >= web.writes, "type %d: %u writes in small chunks, %u in large", entType, small.writes, web.writes);
+}
+
+void testBinary(byte entType) {
+	Capture out;
+	unsigned int sent = stream(out, entType, SNAP_BINARY, CHUNK_MIN);
+
+	CHECK(sent == expected(entType) && out.len == sent * SNAP_RECORD_LEN, "type %d: %u binary records in %u bytes, expected %u",
+		entType, sent, out.len, expected(entType));
+	for (unsigned int i = 0; i + SNAP_RECORD_LEN <= out.len; i += SNAP_RECORD_LEN) {
+		byte *rec = (byte*)out.data + i;
+		byte t = rec[0], n = rec[1];
+		unsigned int val = rec[2] | (rec[3] << 8);
+		CHECK(t < NUM_ENT_TYPES && n < root.numEnts(t) && val == reading(t, n), "type %d: record %u is %d/%d = %u, expected %u",
+			entType, i / SNAP_RECORD_LEN, t, n, val, (t < NUM_ENT_TYPES && n < root.numEnts(t)) ? reading(t, n) : 0);
+	}
+}
+
+int main() {
+	configure();
+	CHECK(reading(OBJ_TYPE_ZONE, 1) == ON && reading(OBJ_TYPE_ZONE, 2) == OFF, "zone occupancy not set up");
+	CHECK(root.getEnt(OBJ_TYPE_ZONE, 1, VAL_CURR) == ON, "a zone's VAL_CURR is not its occupancy");
+
+	testJson(SNAP_ALL);
+	testBinary(SNAP_ALL);
+	for (byte i = 0; i < sizeof(TYPES); i++) {
+		testJson(TYPES[i]);
+		testBinary(TYPES[i]);
+	}
+
+	printf("%s (%d failures)\n", fails ? "FAILED" : "PASSED", fails);
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,2 @@
+// HA host build - all in Arduino.h.  See HostCore.h
+#include "Arduino.h"
@@ -0,0 +1,9 @@
+// HA host build - nothing in the HA libraries needs a String's contents.  See HostCore.h
+#pragma once
+
+class String {
+	public:
+		String(const char *str = "") {}
+		const char *c_str() const { return ""; }
+		unsigned int length() const { return 0; }
+};
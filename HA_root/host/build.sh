@@ -0,0 +1,30 @@
+#!/bin/sh
+# HA host build - compiles a test against HostCore, from the repository root.  See HostCore.h
+#
+#	sh HA_root/host/build.sh <test.cpp> <output> [g++ options]
+
+if [ $# -lt 2 ]; then
+	echo "usage: sh HA_root/host/build.sh <test.cpp> <output> [g++ options]" >&2
+	exit 2
+fi
+TEST=$1
+OUT=$2
+shift 2
+
+# Tests that configure more than a Mega holds get a bigger arena; options given after the output name still win
+case "$TEST" in
+	*RefBench.cpp) set -- -DHA_ARENA_SIZE=65536 "$@" ;;
+esac
+
+# host/ directories first, so they stand in for the Arduino core; then every library directory
+INCLUDES="-IHA_root/host -IWakeup/host"
+for dir in */; do INCLUDES="$INCLUDES -I${dir%/}"; done
+
+SOURCES="HA_root/host/HostCore.cpp Wakeup/host/WakeupHost.cpp Wakeup/Wakeup.cpp
+	HA_arena/HA_arena.cpp HA_root/HA_root.cpp HA_image/HA_image.cpp HA_zone/HA_zone.cpp HA_variables/HA_variables.cpp
+	HA_devices/HA_devices.cpp HA_devices/HA_device_bases.cpp HA_devices/HA_devHeat.cpp HA_devices/HA_devMotion.cpp
+	HA_evaluations/HA_evaluations.cpp HA_channels/HA_channels.cpp HA_switcher/HA_switcher.cpp HA_queue/HA_queue.cpp
+	HA_syslog/HA_syslog.cpp HA_globals/HA_globals.cpp Bitstring/Bitstring.cpp Mcp23s17/Mcp23s17.cpp SPI/SPI.cpp"
+
+# -fpermissive and -w for the Arduino-era code; the tests themselves are checked by what they print
+exec g++ -std=gnu++11 -fpermissive -w -O1 -DWAKEUP_HOST "$@" $INCLUDES "$TEST" $SOURCES -o "$OUT"
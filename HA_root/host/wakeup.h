@@ -0,0 +1,2 @@
+// HA host build - the library is lower case in the sketches.  See HostCore.h
+#include "Wakeup.h"
@@ -0,0 +1,309 @@
+#!/usr/bin/env python3
+"""Compile a controller configuration into PROGMEM tables for HA_root::loadConfig (see HA_config.h)
+
+    ha_config.py dining.cfg [-o dining_config.h]
+
+One statement per line; # starts a comment.  Names are written without their prefix - LIGHT for DEV_TYPE_LIGHT,
+AVG for CALC_AVG - and are emitted as the library's own constants, so the tables always match the headers they are
+compiled against.  Anything else (numbers, 'c', A0, FALLING, ON) is passed through as written.
+
+    name DINING                                     Prefix for the generated identifiers (default: from the file name)
+    channel <n> <PROTOCOL> maxpins=<n> [iopin=<p>]
+        [access=<ACCESS> latch=<p> data=<p> clock=<p>]
+        [alert=<ALERT> int=<n> mode=<m> reset=<p> ss=<p> ss0=<p> ss1=<p>]
+    entities <TYPE> <count>                         createEntArray
+    device <TYPE> <num> channel=<c> pin=<p> [handler=<h>]
+    devices <TYPE> <first>-<last> channel=<c> pin=<p>[+] [handler=<h>]     pin+ counts up with the device number
+    set <TYPE> <num> <VAL>=<value> ...              putEnt, in the order given
+    range <chan> <range> intpin=<p> <TYPE> <num>    registerDevRange
+    eval <n> <CALC> <TYPE> <a> <EXP> <TYPE> <b>     Evaluations numbered from 0, in order
+    args <n> <arg> ...                              Arg lists numbered from 0, in order
+
+TYPE is a DEV_TYPE_ name, BYTE, 2BYTE or VARRFID for the VAR_TYPE_s, ZONE, or - where an evaluation has none.
+The configuration is checked here - numbering, counts, ranges and loops among the evaluations - so mistakes fail the
+build rather than the boot.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+CONFIG_VERSION = 1
+
+VAR_TYPES = {'BYTE': 'VAR_TYPE_BYTE', '2BYTE': 'VAR_TYPE_2BYTE', 'VARRFID': 'VAR_TYPE_RFID', 'ZONE': 'OBJ_TYPE_ZONE'}
+DEV_TYPES = ['TOUCH', 'FIRE', 'HEAT', 'LUMINANCE', 'MOTION', 'PRESENCE', 'RFID', 'OPEN', '5APWR', '13APWR', 'LOCK',
+             'LIGHT', 'RELAY']
+
+
+class ConfigError(Exception):
+    pass
+
+
+def number(text, what, limit=255):
+    try:
+        val = int(text, 0)
+    except ValueError:
+        raise ConfigError('%s must be a number, not %s' % (what, text))
+    if not 0 <= val <= limit:
+        raise ConfigError('%s %d out of range 0-%d' % (what, val, limit))
+    return val
+
+
+def ent_type(text, allow_none=False):
+    name = text.upper()
+    if allow_none and name == '-':
+        return '0'
+    if name in VAR_TYPES:
+        return VAR_TYPES[name]
+    if name in DEV_TYPES:
+        return 'DEV_TYPE_' + name
+    raise ConfigError('unknown entity type %s' % text)
+
+
+def constant(prefix, text):
+    if re.match(r'^[A-Za-z]\w*$', text):
+        return prefix + text.upper()
+    return text                                         # A number, or an expression
+
+
+def options(words, allowed=None):
+    opts = {}
+    for word in words:
+        if '=' not in word:
+            raise ConfigError('expected key=value, not %s' % word)
+        key, val = word.split('=', 1)
+        if allowed is not None and key not in allowed:
+            raise ConfigError('unknown option %s' % key)
+        opts[key] = val
+    return opts
+
+
+class Config:
+    def __init__(self, name):
+        self.name = name
+        self.chans = []
+        self.ents = {}                                  # C type name -> count, in order of declaration
+        self.devs = []
+        self.settings = []
+        self.ranges = []
+        self.evals = []
+        self.eval_refs = []                             # (CALC, valA) per evaluation, for the loop check
+        self.arg_lists = []
+
+    def count(self, ctype, num, what):
+        if ctype not in self.ents:
+            raise ConfigError('%s: no entities line for %s' % (what, ctype))
+        if num >= self.ents[ctype]:
+            raise ConfigError('%s: %s %d beyond its %d entities' % (what, ctype, num, self.ents[ctype]))
+
+    def statement(self, words):
+        keyword, args = words[0].lower(), words[1:]
+
+        if keyword == 'name':
+            self.name = args[0]
+
+        elif keyword == 'channel':
+            if number(args[0], 'channel') != len(self.chans):
+                raise ConfigError('channels must be numbered from 0, in order')
+            opts = options(args[2:], ('maxpins', 'iopin', 'access', 'latch', 'data', 'clock',
+                                      'alert', 'int', 'mode', 'reset', 'ss', 'ss0', 'ss1'))
+            self.chans.append([constant('CHAN_PROTOCOL_', args[1]), opts.get('maxpins', '1'), opts.get('iopin', '0'),
+                               constant('CHAN_ACCESS_', opts.get('access', 'DIRECT')), opts.get('latch', '0'),
+                               opts.get('data', '0'), opts.get('clock', '0'),
+                               constant('CHAN_ALERT_', opts.get('alert', 'NONE')), opts.get('int', '0'),
+                               opts.get('mode', '0'), opts.get('reset', '0'), opts.get('ss', '0'),
+                               opts.get('ss0', '0'), opts.get('ss1', '0')])
+
+        elif keyword == 'entities':
+            ctype = ent_type(args[0])
+            if ctype in self.ents:
+                raise ConfigError('second entities line for %s' % ctype)
+            self.ents[ctype] = number(args[1], 'count')
+
+        elif keyword in ('device', 'devices'):
+            ctype = ent_type(args[0])
+            if not ctype.startswith('DEV_TYPE_'):
+                raise ConfigError('%s is not a device' % ctype)
+            first, _, last = args[1].partition('-')
+            first = number(first, 'device')
+            last = number(last, 'device') if last else first
+            opts = options(args[2:], ('channel', 'pin', 'handler'))
+            chan = number(opts.get('channel', '0'), 'channel')
+            if chan >= len(self.chans):
+                raise ConfigError('device on channel %d, which is not configured' % chan)
+            pin = opts.get('pin', '0')
+            step = pin.endswith('+')
+            pin = number(pin.rstrip('+'), 'pin')
+            for num in range(first, last + 1):
+                self.count(ctype, num, 'device')
+                self.devs.append([ctype, str(num), str(chan), str(pin + (num - first if step else 0)),
+                                  opts.get('handler', '0')])
+
+        elif keyword == 'set':
+            ctype = ent_type(args[0])
+            num = number(args[1], 'entity')
+            self.count(ctype, num, 'set')
+            for key, val in options(args[2:]).items():
+                self.settings.append([ctype, str(num), constant('VAL_', key), val])
+
+        elif keyword == 'range':
+            opts = options([a for a in args if '=' in a], ('intpin',))
+            rest = [a for a in args if '=' not in a]
+            chan = number(rest[0], 'channel')
+            if chan >= len(self.chans):
+                raise ConfigError('range on channel %d, which is not configured' % chan)
+            ctype = ent_type(rest[2])
+            num = number(rest[3], 'device')
+            self.count(ctype, num, 'range')
+            self.ranges.append([str(chan), str(number(rest[1], 'range')), opts.get('intpin', '0'), ctype, str(num)])
+
+        elif keyword == 'eval':
+            if number(args[0], 'eval') != len(self.evals):
+                raise ConfigError('evaluations must be numbered from 0, in order')
+            if len(args) != 7:
+                raise ConfigError('eval <n> <CALC> <TYPE> <a> <EXP> <TYPE> <b>')
+            a_type, b_type = ent_type(args[2], True), ent_type(args[5], True)
+            a, b = number(args[3], 'valA'), number(args[6], 'valB')
+            self.eval_refs.append((args[1].upper(), a))
+            self.evals.append([str(a), str(b),
+                               '(%s << OFFSET_MS_NIBBLE) | %s' % (constant('CALC_', args[1]), constant('EXP_', args[4])),
+                               '(%s << OFFSET_MS_NIBBLE) | %s' % (a_type, b_type)])
+
+        elif keyword == 'args':
+            if number(args[0], 'arg list') != len(self.arg_lists):
+                raise ConfigError('arg lists must be numbered from 0, in order')
+            if not 1 <= len(args) - 1 <= 255:
+                raise ConfigError('an arg list holds 1 to 255 args')
+            self.arg_lists.append([number(a, 'arg') for a in args[1:]])
+
+        else:
+            raise ConfigError('unknown statement %s' % keyword)
+
+    def check(self):
+        if len(self.evals) > 255 or len(self.arg_lists) > 255 or len(self.ranges) > 255:
+            raise ConfigError('more than 255 evaluations, arg lists or ranges')
+        if sum(len(a) for a in self.arg_lists) > 65535:
+            raise ConfigError('too many args')
+        self.check_loops()
+
+    def runs(self, num):
+        """The evaluations that evaluation num runs - as HA_root::evalRef"""
+        calc, a = self.eval_refs[num]
+        if calc == 'EVAL':
+            refs = [a]
+        elif calc in ('AVGV', 'ANDV', 'ORV'):
+            if a >= len(self.arg_lists):
+                raise ConfigError('eval %d: no arg list %d' % (num, a))
+            refs = self.arg_lists[a]
+        else:
+            return []
+        for ref in refs:
+            if ref >= len(self.evals):
+                raise ConfigError('eval %d runs eval %d, beyond the last' % (num, ref))
+        return refs
+
+    def check_loops(self):
+        """Refuse evaluations that run themselves through others, as HA_root::checkEvals does at boot"""
+        done, walking, on_path = set(), [], set()
+        for start in range(len(self.evals)):
+            if start in done:
+                continue
+            stack = [(start, iter(self.runs(start)))]
+            walking.append(start)
+            on_path.add(start)
+            while stack:
+                num, refs = stack[-1]
+                ref = next(refs, None)
+                if ref is None:
+                    done.add(num)
+                    on_path.discard(walking.pop())
+                    stack.pop()
+                elif ref in on_path:
+                    loop = walking[walking.index(ref):] + [ref]
+                    raise ConfigError('evals loop %s' % ' > '.join(str(n) for n in loop))
+                elif ref not in done:
+                    walking.append(ref)
+                    on_path.add(ref)
+                    stack.append((ref, iter(self.runs(ref))))
+
+    def header(self, source):
+        n = self.name
+        out = ['/* Generated by ha_config.py from %s - edit that and regenerate, not this */' % source, '',
+               '#ifndef %s_config_h' % n, '#define %s_config_h' % n, '', '#include "HA_config.h"', '']
+
+        def table(ctype, suffix, rows):
+            if not rows:
+                return 'NULL'
+            out.append('static const %s %s_%s[] PROGMEM = {' % (ctype, n, suffix))
+            for row in rows:
+                out.append('\t{ %s },' % ', '.join(row))
+            out.extend(['};', ''])
+            return '%s_%s' % (n, suffix)
+
+        def array(ctype, suffix, vals, per_line):
+            if not vals:
+                return 'NULL'
+            out.append('static const %s %s_%s[] PROGMEM = {' % (ctype, n, suffix))
+            for i in range(0, len(vals), per_line):
+                out.append('\t%s,' % ', '.join(str(v) for v in vals[i:i + per_line]))
+            out.extend(['};', ''])
+            return '%s_%s' % (n, suffix)
+
+        chans = table('cfgChannel', 'CHANS', self.chans)
+        ents = table('cfgEntities', 'ENTS', [[t, str(c)] for t, c in self.ents.items()])
+        devs = table('cfgDevice', 'DEVS', self.devs)
+        settings = table('cfgSetting', 'SETTINGS', self.settings)
+        ranges = table('cfgRange', 'RANGES', self.ranges)
+        evals = array('byte', 'EVALS', [v for e in self.evals for v in e], 4)
+        index, offset = [], 0
+        for arg_list in self.arg_lists:
+            index.append(offset)
+            offset += len(arg_list)
+        index.append(offset)
+        arg_index = array('unsigned int', 'ARG_INDEX', index if self.arg_lists else [], 16)
+        args = array('byte', 'ARGS', [a for arg_list in self.arg_lists for a in arg_list], 16)
+
+        out.append('static const HA_config %s_CONFIG PROGMEM = {' % n)
+        out.append('\tCONFIG_VERSION,')
+        out.append('\t%d, %s,' % (len(self.chans), chans))
+        out.append('\t%d, %s,' % (len(self.ents), ents))
+        out.append('\t%d, %s,' % (len(self.devs), devs))
+        out.append('\t%d, %s,' % (len(self.settings), settings))
+        out.append('\t%d, %s,' % (len(self.ranges), ranges))
+        out.append('\t%d, %s,' % (len(self.evals), evals))
+        out.append('\t%d, %s, %s' % (len(self.arg_lists), arg_index, args))
+        out.extend(['};', '', 'typedef char %s_configVersion[CONFIG_VERSION == %d ? 1 : -1];' % (n, CONFIG_VERSION),
+                    '', '#endif', ''])
+        return '\n'.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compile a controller configuration into PROGMEM tables')
+    parser.add_argument('source')
+    parser.add_argument('-o', '--output', help='header to write (default: <name>_config.h beside the source)')
+    opts = parser.parse_args()
+
+    base = os.path.splitext(os.path.basename(opts.source))[0]
+    config = Config(re.sub(r'\W', '_', base).upper())
+    with open(opts.source) as f:
+        for line_num, line in enumerate(f, 1):
+            words = line.split('#', 1)[0].split()
+            if not words:
+                continue
+            try:
+                config.statement(words)
+            except (ConfigError, IndexError) as e:
+                sys.exit('%s:%d: %s' % (opts.source, line_num, e if isinstance(e, ConfigError) else 'too few values'))
+    try:
+        config.check()
+    except ConfigError as e:
+        sys.exit('%s: %s' % (opts.source, e))
+
+    output = opts.output or os.path.join(os.path.dirname(opts.source), base + '_config.h')
+    with open(output, 'w') as f:
+        f.write(config.header(os.path.basename(opts.source)))
+
+
+if __name__ == '__main__':
+    main()
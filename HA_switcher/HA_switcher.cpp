@@ -29,206 +29,128 @@
 #include "HA_root.h"
 
 
-contextTable wakeupContext[MAXSLEEPERS];
+contextTable wakeupContext[NUM_CONTEXTS];
 
 int _numContexts;
+static byte _freeContext;							// Head of list of free slots, linked through arg
+static volatile unsigned int _badContexts;		// Bad context numbers seen.  Counted, not printed - often under ISR
 
+static const byte NO_CONTEXT = 0xFF;	// End of free list
 
-void initSwitcher() {
-	for (int i = 0; i < MAXSLEEPERS; i++) wakeupContext[i].objType = DEV_TYPE_NULL;		// Initialise
-	_numContexts = 0;
-}
+static boolean switcherHook(void (*sleeper)(void*), void *context, boolean hold);
 
-int saveContext(X *objPtr, XMemPtr fPtr, byte arg, byte repeated) {	
-	noInterrupts();	
-	
-	// If space, then find slot
-	if (_numContexts < MAXSLEEPERS) {
-		int i = 0;
-		while (i < MAXSLEEPERS && wakeupContext[i].objType != DEV_TYPE_NULL) i++;
-
-		if (i < MAXSLEEPERS) {
-			_numContexts++;
-			wakeupContext[i].objType = DEV_TYPE_RELAY;
-			wakeupContext[i].X.objPtr = objPtr;
-			wakeupContext[i].X.fPtr = fPtr;
-			wakeupContext[i].arg = (arg & 0x7F) | repeated;
-			Serial.print("Context = ");
-			Serial.println(i);
-		}
-		interrupts();
 
-		return i;
+void initSwitcher() {
+	for (int i = 0; i < NUM_CONTEXTS; i++) {
+		wakeupContext[i].refs = 0;
+		wakeupContext[i].arg = (i + 1 < NUM_CONTEXTS) ? i + 1 : NO_CONTEXT;
 	}
-	else {
-		interrupts();
-		return -1;
+	_freeContext = 0;
+	_numContexts = 0;
+	_badContexts = 0;
+	wakeup.setContextHook(switcherHook);
+}
+
+int saveContext(void *objPtr, contextThunk thunk, unsigned int arg) {
+	byte oldSREG = SREG;
+	cli();																// Only while the slot is taken off the free list
+	byte i = _freeContext;
+	if (i != NO_CONTEXT) {
+		_freeContext = wakeupContext[i].arg;
+		wakeupContext[i].refs = 1;
+		_numContexts++;
 	}
-}
-
-int saveContext(HA_devHeat *objPtr, HA_devHeatMemPtr fPtr, byte arg, byte repeated) {	
-	noInterrupts();	
-	
-	// If space, then find slot
-	if (_numContexts < MAXSLEEPERS) {
-		int i = 0;
-		while (i < MAXSLEEPERS && wakeupContext[i].objType != DEV_TYPE_NULL) i++;
-
-		if (i < MAXSLEEPERS) {
-			_numContexts++;
-			wakeupContext[i].objType = DEV_TYPE_HEAT;
-			wakeupContext[i].HA_devHeat.objPtr = objPtr;
-			wakeupContext[i].HA_devHeat.fPtr = fPtr;
-			wakeupContext[i].arg = (arg & 0x7F) | repeated;
-		}
-		
-		interrupts();
+	SREG = oldSREG;
 
-		return i;
-	}
-	else {
-		interrupts();
-		return -1;
-	}
+	if (i == NO_CONTEXT) return -1;
+	wakeupContext[i].thunk = thunk;				// Slot is ours, and not yet passed to wakeup
+	wakeupContext[i].objPtr = objPtr;
+	wakeupContext[i].arg = arg;
+	return i;
 }
 
-int saveContext(HA_devOpen *objPtr, HA_devOpenMemPtr fPtr, byte arg, byte repeated) {	
-	noInterrupts();	
-	
-	// If space, then find slot
-	if (_numContexts < MAXSLEEPERS) {
-		int i = 0;
-		while (i < MAXSLEEPERS && wakeupContext[i].objType != DEV_TYPE_NULL) i++;
-
-		if (i < MAXSLEEPERS) {
-			_numContexts++;
-			wakeupContext[i].objType = DEV_TYPE_OPEN;
-			wakeupContext[i].HA_devOpen.objPtr = objPtr;
-			wakeupContext[i].HA_devOpen.fPtr = fPtr;
-			wakeupContext[i].arg = (arg & 0x7F) | repeated;
-		}
-		
-		interrupts();
-
-		return i;
-	}
-	else {
-		interrupts();
-		return -1;
-	}
+wakeHandle wakeContextAfter(int contextNum, unsigned long delay, byte flags, unsigned int slack) {
+	wakeHandle handle = wakeup.wakeMeAfter(switcher, delay, (void*)contextNum, flags, slack);
+	if (handle == NO_WAKEUP) freeContext(contextNum);
+	return handle;
 }
-/*
-int saveContext(HA_channel *objPtr, HA_channelMemPtr fPtr, byte arg, byte repeated) {	
-	noInterrupts();	
-	
-	// If space, then find slot
-	if (_numContexts < MAXSLEEPERS) {
-		int i = 0;
-		while (i < MAXSLEEPERS && wakeupContext[i].objType != DEV_TYPE_NULL) i++;
-
-		if (i < MAXSLEEPERS) {
-			_numContexts++;
-			wakeupContext[i].objType = OBJ_TYPE_CHANNEL;
-			wakeupContext[i].HA_channel.objPtr = objPtr;
-			wakeupContext[i].HA_channel.fPtr = fPtr;
-			wakeupContext[i].arg = (arg & 0x7F) | repeated;
-		}
-		
-		interrupts();
 
-		return i;
-	}
-	else {
-		interrupts();
-		return -1;
-	}
-}
-*/
-int saveContext(HA_zone *objPtr, HA_zoneMemPtr fPtr, byte arg, byte repeated) {	
-	noInterrupts();	
+boolean updateContext(int contextNum, void *objPtr, contextThunk thunk, unsigned int arg) {	
+	if (contextNum < 0 || contextNum >= NUM_CONTEXTS || wakeupContext[contextNum].refs == 0) return false;
 	
-	// If space, then find slot
-	if (_numContexts < MAXSLEEPERS) {
-		int i = 0;
-		while (i < MAXSLEEPERS && wakeupContext[i].objType != DEV_TYPE_NULL) i++;
-
-		if (i < MAXSLEEPERS) {
-			_numContexts++;
-			wakeupContext[i].objType = OBJ_TYPE_ZONE;
-			wakeupContext[i].HA_zone.objPtr = objPtr;
-			wakeupContext[i].HA_zone.fPtr = fPtr;
-			wakeupContext[i].arg = (arg & 0x7F) | repeated;
-		}
-		
-		interrupts();
-
-		return i;
-	}
-	else {
-		interrupts();
-		return -1;
-	}
+	byte oldSREG = SREG;
+	cli();
+	wakeupContext[contextNum].thunk = thunk;
+	wakeupContext[contextNum].objPtr = objPtr;
+	wakeupContext[contextNum].arg = arg;
+	SREG = oldSREG;
+	return true;
 }
 
-boolean updateContext(int contextNum, HA_devHeat *objPtr, HA_devHeatMemPtr fPtr, byte arg, byte repeated) {	
-	if (wakeupContext[contextNum].objType == DEV_TYPE_HEAT) {
-		wakeupContext[contextNum].HA_devHeat.objPtr = objPtr;
-		wakeupContext[contextNum].HA_devHeat.fPtr = fPtr;
-		wakeupContext[contextNum].arg = (arg & 0x7F) | repeated;
-		return true;
+boolean holdContext(int contextNum) {
+	boolean held = false;
+	
+	byte oldSREG = SREG;
+	cli();
+	if (contextNum >= 0 && contextNum < NUM_CONTEXTS && wakeupContext[contextNum].refs > 0 && wakeupContext[contextNum].refs < 0xFF) {
+		wakeupContext[contextNum].refs++;
+		held = true;
 	}
-	else return false;
+	SREG = oldSREG;
+	return held;
 }
 
 void freeContext(unsigned int context) {
 	byte contextNum = context & 0x00ff;
-	if (contextNum > MAXSLEEPERS) {
-		Serial.println("Bad context");
+	
+	byte oldSREG = SREG;
+	cli();
+	if (contextNum >= NUM_CONTEXTS || wakeupContext[contextNum].refs == 0) {
+		_badContexts++;
+		SREG = oldSREG;
 		return;
 	}
-	
-	noInterrupts();
-	wakeupContext[contextNum].objType = DEV_TYPE_NULL;
-	_numContexts--;
-	interrupts();
+	if (--wakeupContext[contextNum].refs == 0) {			// Last reference - back on the free list
+		wakeupContext[contextNum].arg = _freeContext;
+		_freeContext = contextNum;
+		_numContexts--;
+	}
+	SREG = oldSREG;
+}
+
+static boolean switcherHook(void (*sleeper)(void*), void *context, boolean hold) {		// From WAKEUP, often under ISR.  Other sleepers' contexts aren't ours
+	if (sleeper != switcher) return true;
+	if (hold) return holdContext((unsigned int)context & 0x00ff);		// Refused at 0xFF refs - WAKEUP then drops the wake, so never releases it
+	freeContext((unsigned int)context);
+	return true;
 }
 
-byte getContextObj(int contextNum) {
-	return wakeupContext[contextNum].objType;
+unsigned int badContexts() {
+	byte oldSREG = SREG;
+	cli();
+	unsigned int bad = _badContexts;
+	SREG = oldSREG;
+	return bad;
 }
 
+void sramReport(char *buffer, int maxLen) {
+	snprintf(buffer, maxLen, "sram wakeup=%u (sleepers=%u pending=%u) contexts=%u (%u) bad=%u", 
+		sizeof(wakeup), MAXSLEEPERS, MAXPENDING, sizeof(wakeupContext), NUM_CONTEXTS, badContexts());
+}
 
 
 void switcher(void* context) {
 	byte contextNum = (unsigned int)context & 0x00ff;
-	byte arg = wakeupContext[contextNum].arg & 0x7f;
-	byte repeated = wakeupContext[contextNum].arg >> 7;
-	byte objType = wakeupContext[contextNum].objType;
-	
-	if (!repeated) freeContext(contextNum);
-		
-	switch (objType) {
-		case DEV_TYPE_RELAY: 
-			callMem(*(wakeupContext[contextNum].X.objPtr), wakeupContext[contextNum].X.fPtr)(arg);
-			break;
-		case DEV_TYPE_HEAT: 
-			callMem(*(wakeupContext[contextNum].HA_devHeat.objPtr), wakeupContext[contextNum].HA_devHeat.fPtr)(arg);
-			break;
-		case DEV_TYPE_OPEN: 
-			callMem(*(wakeupContext[contextNum].HA_devOpen.objPtr), wakeupContext[contextNum].HA_devOpen.fPtr)(arg);
-			break;
-		case OBJ_TYPE_CHANNEL: 
-			callMem(*(wakeupContext[contextNum].HA_channel.objPtr), wakeupContext[contextNum].HA_channel.fPtr)(arg);
-			break;
-		case OBJ_TYPE_ZONE: 
-			callMem(*(wakeupContext[contextNum].HA_zone.objPtr), wakeupContext[contextNum].HA_zone.fPtr)(arg);
-			break;
-		default: 
-			Serial.print("sw: Wrong type ");
-			Serial.print(objType);
-			Serial.print(" context = ");
-			Serial.println(contextNum);
+	if (contextNum >= NUM_CONTEXTS || wakeupContext[contextNum].refs == 0) {
+		byte oldSREG = SREG;
+		cli();
+		_badContexts++;
+		SREG = oldSREG;
+		return;
 	}
+	
+	// The wake being run holds a reference until this returns, so the slot can't be reused underneath the call
+	wakeupContext[contextNum].thunk(wakeupContext[contextNum].objPtr, wakeupContext[contextNum].arg);
 }
 
 /*  Class-specific versions of switcher
@@ -246,18 +168,20 @@ void switcher(HA_devHeat *object, HA_devHeatMemPtr fPtr) {
 
 // ********** Function to test switcher and member function pointers
 
-void X::f(byte arg) {
+void X::f(unsigned int arg) {
 	int context;
 	static byte value = 20;
   Serial.print("Val received = ");
   Serial.println(arg);
   delay(500);
-  XMemPtr fPtr = &X::f;
   
 	if (++value < 30) {
 	  // Set this as the class member to invoke
-		if ((context = saveContext(this, fPtr, value)) < 0) Serial.println("out of stack");
-		else switcher((void*)context);	
+		if ((context = saveContext(this, MEMBER_THUNK(X, f), value)) < 0) Serial.println("out of stack");
+		else {
+			switcher((void*)context);
+			freeContext(context);
+		}
 	}
 	else value = 20;
 }
@@ -36,10 +36,10 @@
 
 class X {
 public:
-  void f(byte arg);
+  void f(unsigned int arg);
 };
 
-typedef void (X::*XMemPtr)(byte arg);
+typedef void (X::*XMemPtr)(unsigned int arg);
 
 //void switcher(X *object, XMemPtr fPtr);
 
@@ -49,57 +49,48 @@ typedef void (X::*XMemPtr)(byte arg);
 // and http://publib.boulder.ibm.com/infocenter/lnxpcomp/v8v101/index.jsp?topic=%2Fcom.ibm.xlcpp8l.doc%2Flanguage%2Fref%2Fstrct.htm
 // Could define as a class, but then 'switcher' would have to be static with other functions as members - all too complicated
 
-void initSwitcher();
+// Any class can be woken through the switcher: saveContext takes the object and a thunk - a plain function that casts
+// the object back and calls the member - so the switcher needs no knowledge of the class.  MEMBER_THUNK(Class, member)
+// makes one for any member taking an unsigned int, eg saveContext(this, MEMBER_THUNK(HA_zone, handleOccupancyTimeout))
+//
+// Contexts are reference counted.  saveContext returns one reference, which wakeContextAfter (or wakeMeAfter with
+// switcher) hands to the new sleeper.  WAKEUP then reports, through its context hook, each wake queued and each
+// sleeper leaving, so the slot is freed once a one-shot has run or a sleeper is cancelled - never before.
+// Anyone keeping a context number for longer takes a reference with holdContext, and gives it back with freeContext
 
-int saveContext(X *object, XMemPtr fPtr, byte arg = 0, byte repeated = 0);
-int saveContext(HA_devHeat *object, HA_devHeatMemPtr fPtr, byte arg = 0, byte repeated = 0);
-int saveContext(HA_devOpen *object, HA_devOpenMemPtr fPtr, byte arg = 0, byte repeated = 0);
-//int saveContext(HA_channel *object, HA_channelMemPtr fPtr, byte arg = 0, byte repeated = 0);
-int saveContext(HA_zone *object, HA_zoneMemPtr fPtr, byte arg = 0, byte repeated = 0);
+typedef void (*contextThunk)(void *objPtr, unsigned int arg);
 
-boolean updateContext(int contextNum, HA_devHeat *objPtr, HA_devHeatMemPtr fPtr, byte arg = 0, byte repeated = 0);
+template <class T, void (T::*member)(unsigned int)>
+void memberThunk(void *objPtr, unsigned int arg) {
+	(static_cast<T*>(objPtr)->*member)(arg);
+}
 
-void freeContext(unsigned int context);
+#define MEMBER_THUNK(Class, member)		memberThunk<Class, &Class::member>
 
-byte getContextObj(int contextNum);
+void initSwitcher();																																// After wakeup.init()
+
+int saveContext(void *objPtr, contextThunk thunk, unsigned int arg = 0);		// Context number holding one reference, or -1 if none free
+wakeHandle wakeContextAfter(int contextNum, unsigned long delay, byte flags, unsigned int slack = 0);		// Hand reference to a new switcher sleeper.  If no bunk, reference is dropped and NO_WAKEUP returned
+boolean updateContext(int contextNum, void *objPtr, contextThunk thunk, unsigned int arg = 0);
+boolean holdContext(int contextNum);																								// Extra reference
+void freeContext(unsigned int context);																							// Drop a reference; slot freed with the last
+unsigned int badContexts();																												// Frees and wakes of a context number not in use - counted rather than printed, as often under ISR
+
+void sramReport(char *buffer, int maxLen);		// One line - sizes this build was given for WAKEUP and the context table, and the SRAM each takes
 
 void switcher(void *context);				// Callback function called on wakeup.  Context is index into instance of contextTable, which then gives 
-																		// - the object and member function pointers
-																		// - 7 bit optional argument
-																		// - 1 bit repeat flag
+																		// - the object and the thunk calling its member function
+																		// - argument to pass
 
 struct contextTable {
-	byte objType;
-	union {
-		struct {
-			X 									*objPtr;
-			XMemPtr							fPtr;
-		} X;
-		struct {
-			HA_devHeat 					*objPtr;
-			HA_devHeatMemPtr 		fPtr;
-		} HA_devHeat;		
-		struct {
-			HA_devOpen 					*objPtr;
-			HA_devOpenMemPtr 		fPtr;
-		} HA_devOpen;	
-		struct {
-			HA_channel 					*objPtr;
-			HA_channelMemPtr 		fPtr;
-		} HA_channel;	
-		struct {
-			HA_zone 						*objPtr;
-			HA_zoneMemPtr 			fPtr;
-		} HA_zone;	
-	};
-	byte arg;
+	contextThunk thunk;
+	void *objPtr;
+	unsigned int arg;									// Passed to the member; next free slot while free
+	byte refs;												// 0 while slot is free
 };
 
-
 extern int _numContexts;
-extern contextTable wakeupContext[MAXSLEEPERS];
-
-const static byte REPEATED = 0x80;
+extern contextTable wakeupContext[NUM_CONTEXTS];
 
 #define callMem(object, fPtr) ((object).*(fPtr))	// Macro to simplify invoking objects and member functions
 
@@ -141,6 +141,14 @@ void HA_syslog::sendLog(char sev, char *tag, unsigned int num, char *format) {
 	sendLog(sev, tag, buffer);
 }
 
+void HA_syslog::sendWakeStats(char sev) {
+#ifdef WAKEUP_STATS
+	char buffer[100];
+	
+	for (byte i = 0; wakeup.statsLine(i, buffer, 100); i++) sendLog(sev, "Wake", buffer);
+#endif
+}
+
 /* Create one global object */
 HA_syslog syslog;
 
@@ -31,6 +31,7 @@
 #include <EthernetUdp.h>
 #define UDP_TX_PACKET_MAX_SIZE 128			// Override the default 24
 #include "HA_queue.h"
+#include "Wakeup.h"
 
 /*
 #define SYSLOG_DEBUG 7
@@ -82,6 +83,7 @@ class HA_syslog {
 			void sendLog(char sev, char *tag, int num);
 			void sendLog(char sev, char* tag, float num);
 			void sendLog(char sev, char *tag, unsigned int num, char *format);
+			void sendWakeStats(char sev);											// One message per sleeper callback timed by WAKEUP, then totals
 
 	    
 	private:
@@ -132,24 +132,16 @@ boolean HA_temperature::init(byte pin, byte targetPrecision, byte pollingFreq) {
 
             releaseBus(_sensorID);          // Release sensor bus
 
-            // Schedule 'immediate' initial reading - cancel any prior instruction
-            wakeup.cancelWakeup((void (*)(void*))scheduleTempC, IMMEDIATE_READ_MS, (void*)_sensorID, TREAT_AS_NORMAL);
+            // Start reading thread with 'immediate' initial reading - restarts any prior thread.  The thread then schedules regular reads itself
+            s_pollingFreq[_sensorID] = pollingFreq;
+            wakeThreadInit(&s_thread[_sensorID], resumeTempC, (void*)_sensorID, CONV_SLACK_MS);
             
-            if (!wakeup.wakeMeAfter((void (*)(void*))scheduleTempC, IMMEDIATE_READ_MS, (void*)_sensorID, TREAT_AS_NORMAL)) {
-                logError(0xA4);
-                RESTORE_CONTEXT
-                return false;
-            }
-
-            // Schedule regular temperature reads
-            wakeup.cancelWakeup((void (*)(void*))scheduleTempC, pollingFreq * 1000, (void*)_sensorID, TREAT_AS_NORMAL | REPEAT_COUNT);
-            
-            if (wakeup.wakeMeAfter((void (*)(void*))scheduleTempC, pollingFreq * 1000, (void*)_sensorID, TREAT_AS_NORMAL | REPEAT_COUNT)) {
+            if (wakeThreadStart(&s_thread[_sensorID], IMMEDIATE_READ_MS)) {
                 RESTORE_CONTEXT
                 return true;
             }
             else {
-                logError(0xA5);
+                logError(0xA4);
                 RESTORE_CONTEXT
                 return false;
             }
@@ -181,133 +173,135 @@ byte HA_temperature::s_nextSensorID = 0;
 
 volatile byte HA_temperature::s_sensorInUse = 0;
 volatile byte HA_temperature::s_DS18S20 = 0;
-volatile byte HA_temperature::s_conversionState = 0;
 volatile byte HA_temperature::s_sensorError = 0;
 
 unsigned int HA_temperature::s_convTime[NUM_TEMP_SENSORS];
 volatile float HA_temperature::s_tempC[NUM_TEMP_SENSORS];    
+byte HA_temperature::s_pollingFreq[NUM_TEMP_SENSORS];
+wakeThread HA_temperature::s_thread[NUM_TEMP_SENSORS];                   // Statics, so start stopped
 
 OneWire HA_temperature::oneWire[NUM_TEMP_SENSORS];
 
 
 
-void HA_temperature::scheduleTempC(byte sensorID) {
+void HA_temperature::resumeTempC(void *sensorID) {
 
     SAVE_CONTEXT("sTempC")
+    readTempC((byte)(unsigned int)sensorID);            // Thread returns at every wait, so context is saved and restored here rather than in the thread
+    RESTORE_CONTEXT
+}
+
+void HA_temperature::readTempC(byte sensorID) {
 
     /*
-    Main background read routine to get temperature - takes around 800ms in elapsed time.  Is a static as function pointer needs to be passed to wakeup and this is too complicated if a member of a class
+    Main background read routine to get temperature - takes around 800ms in elapsed time, then waits for the next poll.  Is a static 
+    as function pointer needs to be passed to wakeup and this is too complicated if a member of a class
 
-    Has two states held in relevant bit in s_conversionState
-    - reset sensor (unset) - triggered to a schedule set in scheduleTempReadingsFor() and initiate conversion
-    - get temperature (set) - triggered once previous state completes
+    A wakeThread (see Wakethread.h), so reads top to bottom, but returns at each WT_AWAIT and is carried on by wakeup.  Local
+    variables don't survive an await - the scratchpad is only used between two of them
+    - reset sensor and initiate conversion
+    - wait for conversion, then get temperature
+    - wait for next poll
 
-    If error, then reset state and wait for repeat run
+    If error, then release the bus and wait for the next poll
     */
 
-    // Select appropriate stage of processing depending on how far through the read process has got
-    switch (getBit(s_conversionState, sensorID)) {
+    wakeThread *wt = &s_thread[sensorID];
+    byte scratchpad[9];
+    float tempC;
 
-        case RESET_SENSOR:                    // Initial state
+    WT_BEGIN(wt);
 
-            // Bail if sensor already in use
-            if (!reserveBus(sensorID)) {
-                logError(0xe0);
-                RESTORE_CONTEXT
-                return;
-            }
+    for (;;) {
+
+        // Skip this read if sensor already in use
+        if (!reserveBus(sensorID)) logError(0xe0);
+        else {
 
             // Reset bus and start conversion
             oneWire[sensorID].reset();
             oneWire[sensorID].skip();
             oneWire[sensorID].write(STARTCONVO);
 
-            // Next step will be to read the result . . .
-            setBit(&s_conversionState, sensorID, GET_TEMP);
-
-            // . .  which happens in s_convTime ms.  If error, then reset state and release bus
-            //int convTime = (getBit(s_DS18S20, sensorID)) ? T_CONV_DS18S20 : T_CONV_DS18B20[targetPrecision - 9];   // Index into array for DS18B20
+            // Result is ready in s_convTime ms.  If no wakeup to be had, then give up on this read and release bus
+            wt->slack = CONV_SLACK_MS;
+            WT_AWAIT_DELAY(wt, s_convTime[sensorID]);
 
-            wakeup.cancelWakeup((void (*)(void*))scheduleTempC, s_convTime[sensorID], (void*)sensorID, TREAT_AS_NORMAL);
-            
-            if (!wakeup.wakeMeAfter((void (*)(void*))scheduleTempC, s_convTime[sensorID], (void*)sensorID, TREAT_AS_NORMAL)) {
+            if (WT_WAIT_FAILED(wt)) {
                 logError(0xAE);
-                setBit(&s_conversionState, sensorID, RESET_SENSOR);
                 releaseBus(sensorID);
             }
+            else {
 
-            RESTORE_CONTEXT
-
-            break;
-
-        case GET_TEMP: {                  // Get result of conversion
-
-            byte scratchpad[9];
-            float tempC;
-
-            // Get the data into buffer
-            if (readScratchPad(sensorID, scratchpad)) {
+                // Get the data into buffer
+                if (readScratchPad(sensorID, scratchpad)) {
 
-                // Load the temperature to single variable and add extra resolution if needed
-                int reading = (((int)scratchpad[TEMP_MSB]) << 8) | scratchpad[TEMP_LSB];
+                    // Load the temperature to single variable and add extra resolution if needed
+                    int reading = (((int)scratchpad[TEMP_MSB]) << 8) | scratchpad[TEMP_LSB];
 
-                if (getBit(s_DS18S20, sensorID)) {			                    // Fixed 9 bit resolution expandable using 'extended resolution temperature' algorithm
-                    reading = reading >> 1;                                 // Truncate 0.5C bit 
-                    tempC = (float)reading - 0.25 + ((float)(16 - scratchpad[COUNT_REMAIN]) / 16); 
-                }
-                else {
-                    switch (scratchpad[CONFIGURATION]) {
-                        case TEMP_12_BIT: tempC = (float)reading * 0.0625; break;
-                        case TEMP_11_BIT: tempC = (float)(reading >> 1) * 0.125; break;
-                        case TEMP_10_BIT: tempC = (float)(reading >> 2) * 0.25; break;
-                        case TEMP_9_BIT: 
-                        default: tempC = (float)(reading >> 3) * 0.5; break;
+                    if (getBit(s_DS18S20, sensorID)) {			                    // Fixed 9 bit resolution expandable using 'extended resolution temperature' algorithm
+                        reading = reading >> 1;                                 // Truncate 0.5C bit 
+                        tempC = (float)reading - 0.25 + ((float)(16 - scratchpad[COUNT_REMAIN]) / 16); 
+                    }
+                    else {
+                        switch (scratchpad[CONFIGURATION]) {
+                            case TEMP_12_BIT: tempC = (float)reading * 0.0625; break;
+                            case TEMP_11_BIT: tempC = (float)(reading >> 1) * 0.125; break;
+                            case TEMP_10_BIT: tempC = (float)(reading >> 2) * 0.25; break;
+                            case TEMP_9_BIT: 
+                            default: tempC = (float)(reading >> 3) * 0.5; break;
+                        }
                     }
-                }
 
 #ifdef DEBUG
-                byte bufPosn = 0;
-                const byte BUFLEN = 64;
-                char buffer[BUFLEN];
-                #define BUF_ADD bufPosn += snprintf(buffer + bufPosn, BUFLEN - bufPosn, 
-                
-                BUF_ADD "Sensor %u (%s). Scratchpad: ", sensorID, (getBit(s_DS18S20, sensorID)) ? "18S" : "18B");
-                for (int i = 0; i < 9; i++) BUF_ADD "%02x", scratchpad[i]);
-                BUF_ADD " reading: %u\0", (unsigned int)tempC);
-                Serial.println(buffer);
-                SENDLOGM('D', buffer);
+                    byte bufPosn = 0;
+                    const byte BUFLEN = 64;
+                    char buffer[BUFLEN];
+                    #define BUF_ADD bufPosn += snprintf(buffer + bufPosn, BUFLEN - bufPosn, 
+                    
+                    BUF_ADD "Sensor %u (%s). Scratchpad: ", sensorID, (getBit(s_DS18S20, sensorID)) ? "18S" : "18B");
+                    for (int i = 0; i < 9; i++) BUF_ADD "%02x", scratchpad[i]);
+                    BUF_ADD " reading: %u\0", (unsigned int)tempC);
+                    Serial.println(buffer);
+                    SENDLOGM('D', buffer);
 #endif
-            }
-            else {
-                tempC = ERR_TEMP;
-            }
-            
-            // Take stock
-            if (tempC == ERR_TEMP) {                            // Allow one transient error without reporting it       
-                if (!getBit(s_sensorError, sensorID)) {
-                    setBit(&s_sensorError, sensorID, true);
                 }
                 else {
-                    logError(0xe1);
+                    tempC = ERR_TEMP;
                 }
+                
+                // Take stock
+                if (tempC == ERR_TEMP) {                            // Allow one transient error without reporting it       
+                    if (!getBit(s_sensorError, sensorID)) {
+                        setBit(&s_sensorError, sensorID, true);
+                    }
+                    else {
+                        logError(0xe1);
+                    }
+                }
+                else {                                              // Got a good reading; record it and clear error flag
+                        noInterrupts();                             // Avoid clash with getTempC() when writing float
+                        s_tempC[sensorID] = tempC;
+                        interrupts();
+                        setBit(&s_sensorError, sensorID, false);
+                }
+
+                // All done - hand back the bus to others
+                releaseBus(sensorID);
             }
-            else {                                              // Got a good reading; record it and clear error flag
-                    noInterrupts();                             // Avoid clash with getTempC() when writing float
-                    s_tempC[sensorID] = tempC;
-                    interrupts();
-                    setBit(&s_sensorError, sensorID, false);
-            }
+        }
 
-            // All done.  Wakeup will automatically repeat the process, so just need to set the state and hand back the bus to others
-            setBit(&s_conversionState, sensorID, RESET_SENSOR);
-            releaseBus(sensorID);
+        // Wait for next poll, less the conversion time so reads still start every pollingFreq secs.  If no wakeup to be had, the thread stops until init is called again
+        wt->slack = POLL_SLACK_MS;
+        WT_AWAIT_DELAY(wt, s_pollingFreq[sensorID] * 1000UL - s_convTime[sensorID]);
 
-            break;
+        if (WT_WAIT_FAILED(wt)) {
+            logError(0xA5);
+            WT_EXIT(wt);
         }
-        default: logError(0xD0);
     }
 
-    RESTORE_CONTEXT
+    WT_END(wt);
 }
 
 // I2C bus reservation/release routines
@@ -27,6 +27,7 @@
 #include <inttypes.h>
 #include "OneWire.h"
 #include "wakeup.h"
+#include "Wakethread.h"
 #include "TimerOne.h"            // NB: modified version of public TimerOne library
 #include "HA_globals.h"
 
@@ -78,13 +79,13 @@ const static int MAX_TEMP = 95;           // Max allowable temp for sensors
 const static int ERR_TEMP = 99;           // To indicate error reading
 const static int RESET_TEMP = 85;         // Power-on reset temperature
  
-// Bit states for s_conversionState
-const static byte RESET_SENSOR = 0;
-const static byte GET_TEMP = 1;
-
 // Delay between initialisation and first read request
 #define IMMEDIATE_READ_MS 10
 
+// Slack allowed on wakeups, so they can share a timerISR with other sleepers
+const static unsigned int CONV_SLACK_MS = 50;     // Reading a little after conversion completes does no harm
+const static unsigned int POLL_SLACK_MS = 250;    // Polling is every few seconds at most
+
 
 
 class HA_temperature
@@ -108,27 +109,29 @@ class HA_temperature
     // Flags - bit-wise, indexed by sensorID.  NB: limit of 8 sensors
     static volatile byte s_sensorInUse;                      // To allow co-operative access to sensor bus
     static volatile byte s_DS18S20;                          // Bit set if DS18S20, which needs additional processing
-    static volatile byte s_conversionState;                  // Controls state/process path through scheduleTempC
     static volatile byte s_sensorError;                      // Allows up to one transient error before flagging ERR_TEMP
 
     // Values
     static unsigned int s_convTime[NUM_TEMP_SENSORS];
     static volatile float s_tempC[NUM_TEMP_SENSORS];              // Holds the latest temperature from the sensor - can be updated via ISR, hence volatile
+    static byte s_pollingFreq[NUM_TEMP_SENSORS];                  // Seconds between reads
+    static wakeThread s_thread[NUM_TEMP_SENSORS];                 // Runs readTempC - waits for conversion, then for next poll
 
     byte _sensorID;                                 // One per class member
 
     // Underlying comms bus to access temperature sensor
     static OneWire oneWire[NUM_TEMP_SENSORS];                    
 
-    static void scheduleTempC(byte sensorID);                // Main processing loop - re-entrant two-state processing using wakeup to avoid blocking
+    static void resumeTempC(void *sensorID);                 // Called by wakeup to carry on with readTempC
+    static void readTempC(byte sensorID);                    // Main processing loop - a wakeThread, so waits without blocking
 
     static boolean reserveBus(byte sensorID);               // Used to control semaphore access to the bus
     static void releaseBus(byte sensorID);
 
-    static boolean getBit(volatile byte flags, byte sensorID);                    // Used to get/set the main processing (scheduleTempC) state
+    static boolean getBit(volatile byte flags, byte sensorID);                    // Used to get/set the per-sensor flags
     static void setBit(volatile byte* flags, byte sensorID, boolean state);
 
-    static byte readPrecision(byte sensorID);               // Helper functions in support of scheduleTempC
+    static byte readPrecision(byte sensorID);               // Helper functions in support of readTempC
     static boolean readScratchPad(byte sensorID, byte* scratchpad);
     static boolean readScratch(OneWire *wire, byte* scratchpad);
   
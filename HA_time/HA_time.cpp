@@ -79,7 +79,7 @@ boolean initialiseTime(unsigned int port, unsigned int refreshIntervalSecs) {
 	setBSTThresholds();
   
 	// Kickoff regular refresh of time 
-	wakeup.wakeMeAfter(refreshTime, REFRESH_CYCLE, (void*)NULL, TREAT_AS_ISR | REPEAT_COUNT);						
+	wakeup.wakeMeAfter(refreshTime, REFRESH_CYCLE, (void*)NULL, TREAT_AS_ISR | REPEAT_COUNT, REFRESH_SLACK);						
   
 	RESTORE_CONTEXT
   
@@ -218,7 +218,7 @@ void calcTime() {																							// Decide on and store the reading, then
 			
 	// Schedule next search
 	_context.mode = NEW_SEARCH;
-	wakeup.wakeMeAfter(askNtpServers, _refreshIntervalSecs, (void*)NULL, TREAT_AS_NORMAL | UNITS_SECONDS);	
+	wakeup.setPriority(wakeup.wakeMeAfter(askNtpServers, _refreshIntervalSecs, (void*)NULL, TREAT_AS_NORMAL | UNITS_SECONDS), PRIORITY_LOW);		// Can wait for more urgent sleepers
 	
 	// Reset refresh cycle
 	wakeup.resetWakeup(refreshTime, REFRESH_CYCLE, (void*)NULL, TREAT_AS_ISR | REPEAT_COUNT);
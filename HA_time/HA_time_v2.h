@@ -40,6 +40,7 @@ static const unsigned int REFRESH_INTERVAL_SECS 	= 300;														// Check NT
 static const byte MAX_RETRIES											= 20;
 static const unsigned int RETRY_DELAY							= 1000 / MAX_RETRIES;							// Allow up to 1s for NTP server to provide time
 static const unsigned int REFRESH_CYCLE						= 1000;														// Refresh every 1s
+static const unsigned int REFRESH_SLACK						= 20;															// ms refresh can be late by, to share a timerISR.  Phase is kept, so no drift
 
 static const unsigned long CURRENT_YEAR 					= (2013 - 1970) * SECS_PER_YEAR;  // used for sense test
 static const unsigned long EXPIRY_YEAR 						= (2050 - 1970) * SECS_PER_YEAR;  // Used for sense test
@@ -21,6 +21,7 @@
 
 
 #include "HA_variables.h"
+#include "HA_arena.h"
 
           
 
@@ -68,6 +69,7 @@ boolean HA_varMultiByte::create(byte bufLen) {		// To be called directly if cons
 		return true;
 	}
 	else {
+		if (arena.sealed()) arena.refuse(bufLen);		// Heap frozen by seal()
 		_bufLen = 0; 
 		return false;
 	}
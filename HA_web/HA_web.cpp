@@ -22,6 +22,9 @@
 
 
 #include "HA_web.h"
+#include "HA_switcher.h"
+#include "HA_arena.h"
+#include "HA_root.h"
 
 
 EthernetServer server(80);
@@ -60,6 +63,8 @@ void HA_web::processHTTP(EthernetClient client)  {
 	                SENDLOG('D', "Ajax get = ", URLline);
 	                handleAjaxGet (client, dataStart + 6, dataStart[5]);    // Ajax Get, usually 'C'heck to see if any change since last time
                 }
+                else if (strstr(URLline, "GET /wakestats") == URLline) serveWakeStats(client, strstr(URLline, "?clear") != 0);
+                else if (strstr(URLline, "GET /snapshot") == URLline) serveSnapshot(client, URLline);
                 else if ((dataStart = strstr(URLline,"?")) != 0) handleHTTPCmd(client,dataStart+1);               // Was a GET after a Form submit - handle the submitted text                }
                 else {
 	                SENDLOG('I', "Client line = ", URLline);
@@ -174,6 +179,10 @@ void HA_web::serveFile(EthernetClient client, char *clientLine) {
     // close the file:
     myFile.close();
   } 
+  else if (arena.heapShort(SD_FILE_HEAP)) {								// No room for SD's SdFile - see HA_HEAP_RESERVE
+  	client.write("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n");
+  	SENDLOG('W', "No heap to open file ", fileName)
+  }
   else SENDLOG('W', "Error opening file ", fileName); 
   
   RESTORE_CONTEXT
@@ -205,7 +214,15 @@ void HA_web::handleAjaxGet(EthernetClient client, char* actionline, char type){
 	  case 'C':																						// Check if any changes since last
 			SENDLOG('I', "Ajax", "check");
 			
-			if (changeList.size() > 0) {
+			byte entType, entNum;
+			if (root.nextDirty(DIRTY_WEB, &entType, &entNum)) {			// Entities first - latest value of each changed one
+				char devType[5];
+				getDevTypeChar(entType, devType);
+				devStatus = (entType < NUM_DEV_TYPES) ? root.getEnt(entType, entNum, VAL_STATUS) : 0;
+				
+				sprintf (responseText, "%s%s%s%d%s%d%s%d%s", devTypeSt, devType, devNumSt, entNum, devValSt, root.getEnt(entType, entNum, VAL_CURR), devStatusSt, devStatus, endSt);  
+			}
+			else if (changeList.size() > 0) {									// Then anything queued - time, heartbeat
 				byte devTypeB = changeList.get();	
 				byte devNum;
 				unsigned int devVal;
@@ -263,6 +280,54 @@ void HA_web::handleHTTPCmd(EthernetClient client, char* actionline){        // U
   */
 }
 
+void HA_web::serveWakeStats(EthernetClient client, boolean clear) {
+	SAVE_CONTEXT("Web4")
+	
+	client.write("HTTP/1.1 200 OK\r\nServer: Arduino-");
+  client.print(arduinoMe);
+  client.write("\r\nConnection: close\r\nContent-Type: text/plain\r\n\r\n");
+  
+	char buffer[100];
+	
+	sramReport(buffer, 100);
+	client.write(buffer);
+	client.write("\r\n");
+	arena.report(buffer, 100);
+	client.write(buffer);
+	client.write("\r\n");
+#ifdef WAKEUP_STATS
+	client.write("callback runs overruns run-avg/max-uS latency-max-uS latency-histogram(<256uS,<1ms,<4ms...)\r\n");
+  for (byte i = 0; wakeup.statsLine(i, buffer, 100); i++) {
+  	client.write(buffer);
+  	client.write("\r\n");
+  }
+  if (clear) wakeup.clearStats();
+#else
+	client.write("WAKEUP_STATS not enabled\r\n");
+#endif
+	
+	stopClient(client);
+	RESTORE_CONTEXT
+}
+
+void HA_web::serveSnapshot(EthernetClient client, char *URLline) {
+	SAVE_CONTEXT("Web5")
+	
+	char *typeStart = strstr(URLline, "type=");
+	byte entType = typeStart ? atoi(typeStart + 5) : SNAP_ALL;
+	byte format = strstr(URLline, "bin") ? SNAP_BINARY : SNAP_JSON;
+	byte buffer[SNAP_CHUNK];
+	
+	client.write("HTTP/1.1 200 OK\r\nServer: Arduino-");
+  client.print(arduinoMe);
+  client.write("\r\nConnection: close\r\nContent-Type: ");
+  client.write((format == SNAP_JSON) ? "application/json\r\n\r\n" : "application/octet-stream\r\n\r\n");
+  
+	if (entType == SNAP_ALL || entType < NUM_ENT_TYPES) root.snapStream(client, buffer, SNAP_CHUNK, entType, format);
+	
+	stopClient(client);
+	RESTORE_CONTEXT
+}
 
 void HA_web::stopClient(EthernetClient client) {
   delay(2);
@@ -31,6 +31,7 @@
 #include <SPI.h>
 #include <SD.h>
 #include "HA_queue.h"
+#include "Wakeup.h"
 //#include "HA_device_bases.h"
 
 
@@ -47,10 +48,13 @@ class HA_web {
 		void serveFile(EthernetClient client, char *clientLine);											// Retrieve file from SD card and serve to browser
 		void handleAjaxGet(EthernetClient client, char* actionline, char type);       // Used to process Ajax GET; actionline points to first char after 'R', 'T' or 'P' 
 		void handleHTTPCmd(EthernetClient client, char* actionline);
+		void serveWakeStats(EthernetClient client, boolean clear);										// Plain text WAKEUP telemetry, for GET /wakestats (add ?clear to start again)
+		void serveSnapshot(EthernetClient client, char *URLline);											// Every entity's reading, for GET /snapshot (?type=n for one type, &bin for binary)
 		void stopClient(EthernetClient client);
 		
 		static const unsigned int HTTP_BUFSIZE = 100;
 		static const unsigned int ELEM_BUFSIZE = 15;
+		static const unsigned int SNAP_CHUNK = 256;																		// Bytes per write - one packet, well inside the W5100 socket buffer
 };
 
 //extern EthernetServer server;
@@ -31,10 +31,11 @@
 
 void HA_zone::put(byte type, unsigned int val) {
 	byte oldOccupancy = get(VAL_OCCUPANCY);
+	boolean isState = (type == VAL_OCCUPANCY || type == VAL_TARG_TEMP || type == VAL_ACT_TEMP || type == VAL_LUMINANCE);
+	unsigned int oldVal = isState ? get(type) : 0;
 	
 	// Vars used for countdown
 	int contextNum;
-	HA_zoneMemPtr fPtr = &HA_zone::handleOccupancyTimeout;
 	
 	switch (type) {
 		case VAL_REGION: 						_regionZone &= ~MASK_REGION; _regionZone |= (((strchr(REGIONCODES, (char)val) - REGIONCODES) << OFFSET_REGION) & MASK_REGION); break;
@@ -48,17 +49,18 @@ void HA_zone::put(byte type, unsigned int val) {
 			
 			if (val == ON) {
 				if (oldOccupancy == ON) {																																	// Was ON previously, which means countdown already started, so needs resetting
-					wakeup.resetWakeup(switcher, ZONE_OCCUPANCY_TIMEOUT, (void*)_context, UNITS_SECONDS);		// Context was saved when counter first started
+					wakeup.resetWakeup(_occupancyTimer);																											// Handle was saved when counter first started
 				}
 				else {			
 					// Set a delay after which the zone is deemed unoccupied 
-					if ((contextNum = saveContext(this, fPtr)) < 0) {  		// Set 'this' as the object instance and handleOccupancyTimeout as the member function 
+					if ((contextNum = saveContext(this, MEMBER_THUNK(HA_zone, handleOccupancyTimeout))) < 0) {  		// Set 'this' as the object instance and handleOccupancyTimeout as the member function 
 					 	Serial.println("out of stack");
 					  break;
 				 	}
 				 	else _context = contextNum; 								// Save to allow for reset later, if occupancy repeated
 	
-			  	if (!wakeup.wakeMeAfter(switcher, ZONE_OCCUPANCY_TIMEOUT, (void*)_context, TREAT_AS_NORMAL | UNITS_SECONDS)) Serial.println("Queue full");  	// Queue timeout
+			  	_occupancyTimer = wakeContextAfter(_context, ZONE_OCCUPANCY_TIMEOUT, TREAT_AS_NORMAL | UNITS_SECONDS);  	// Queue timeout.  Context freed once it has run
+			  	if (_occupancyTimer == NO_WAKEUP) Serial.println("Queue full");
 		  		
 		  		// React to On event - enable device or list of devices
 		  		handleEvent(ON);
@@ -83,9 +85,12 @@ void HA_zone::put(byte type, unsigned int val) {
 		case VAL_ACT_TEMP:					_actualTemp = val; break;
 		case VAL_LUMINANCE:					_luminance = val; break;
 		case VAL_CONTEXT:						_context = val; break;
-		case VAL_DEVIDX:						_zoneNum = val; break;
+		case VAL_DEVIDX:						_zoneNum = val; _occupancyTimer = NO_WAKEUP; break;				// Set once by HA_root on creation, so also a chance to initialise
 		default:										Serial.print("Bad type1:"); 
 	}
+	
+	// Zones mark their own changes, as devices do - occupancy also changes from handleOccupancyTimeout, not just putEnt
+	if (isState && get(type) != oldVal) root.markDirty(OBJ_TYPE_ZONE, _zoneNum);
 }
 
 unsigned int HA_zone::get(byte type) {
@@ -95,6 +100,7 @@ unsigned int HA_zone::get(byte type) {
 		case VAL_REGION_ZONE:				return _regionZone;
 		case VAL_HANDLER:						return (_flags & MASK_HANDLER) >> OFFSET_HANDLER;
 		case VAL_ON_EVENT:					return _onEvent; 
+		case VAL_CURR:																															// A zone's reading, for the web page and snapshots
 		case VAL_OCCUPANCY:					return (_flags & MASK_OCCUPANCY) >> OFFSET_OCCUPANCY;
 		case VAL_TARG_TEMP:					return _targetTemp;
 		case VAL_ACT_TEMP:					return _actualTemp;
@@ -103,9 +109,10 @@ unsigned int HA_zone::get(byte type) {
 		case VAL_DEVIDX:						return _zoneNum;
 		default:										Serial.print("Bad type2:");
 	}
+	return 0;
 }
 
-void HA_zone::handleOccupancyTimeout(byte dummy) {			// Called on completion of occupancy timeout
+void HA_zone::handleOccupancyTimeout(unsigned int dummy) {			// Called on completion of occupancy timeout
   put(VAL_OCCUPANCY, OFF); 
 }
 
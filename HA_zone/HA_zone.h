@@ -31,6 +31,7 @@
 #include "HA_globals.h"
 #include "HA_device_bases.h"
 #include "HA_variables.h"
+#include "wakeup.h"
 
 
 
@@ -45,7 +46,7 @@ public:
 	void getSnapshot();
   	
 protected:		
-	void handleOccupancyTimeout(byte dummy);			// Called by switcher on expiry of occupancy timer - turns light off
+	void handleOccupancyTimeout(unsigned int dummy);			// Called by switcher on expiry of occupancy timer - turns light off
 	void handleEvent(byte state);														// Sets one or more relays on or off, dependent on event
 
 	// Properties
@@ -55,6 +56,7 @@ protected:
 	unsigned int _actualTemp;
 	unsigned int _luminance;
 	byte  _context;											// Index in contextTable (see HA_switcher.h) for occupancy counter
+	wakeHandle _occupancyTimer;					// Handle to occupancy countdown, for reset on each motion event
 	byte _onEvent;											// Argument to use when occupancy changes.  Either a direct relay number (if Handler == 0), or ArgList number containing a list of relays (if Handler == 1)
 	byte _zoneNum;
 	
@@ -72,7 +74,7 @@ protected:
 };
 
 
-typedef void (HA_zone::*HA_zoneMemPtr)(byte);
+typedef void (HA_zone::*HA_zoneMemPtr)(unsigned int);
 
 
 extern const char REGIONCODES[NUMREGIONCODES + 1];
@@ -14,6 +14,12 @@
  *	  Error only material at very short durations (1us == 16-1 clockticks, so 0.937us)
  *  - Amended DDR assignment (in pwm()) to reflect Mega
  *  - Amended read() to replace switch statement with array lookup
+ *  Modified Oct 2026 by Andrew Richards for drift-free use by WAKEUP:
+ *  - read() shifts by the prescaler before dividing, so no longer truncates to 2^scale us (up to 1ms at /1024)
+ *  - Add getPeriod() to return period actually programmed, after rounding to the prescaler
+ *  - Add adjustPeriod() to change TOP of a running timer without losing the count
+ *  - Add overflowPending(), and clear a stale overflow flag in start(), so a restart with interrupts disabled
+ *    doesn't lose (or repeat) a period
  *  This is free software. You can redistribute it and/or modify it under
  *  the terms of Creative Commons Attribution 3.0 United States License. 
  *  To view a copy of this license, visit http://creativecommons.org/licenses/by/3.0/us/ 
@@ -44,16 +50,25 @@ void TimerOne::initialize(long microseconds)
 }
 
 
+unsigned char TimerOne::scaleFor(long microseconds, long *cycles)    // AR added - split out of setPeriod() for use by adjustPeriod()
+{
+  unsigned char bits;
+  
+  *cycles = (F_CPU / 2000000) * microseconds;                                  // the counter runs backwards after TOP, interrupt is at BOTTOM so divide microseconds by 2
+  if(*cycles < RESOLUTION)              bits = _BV(CS10);                      // no prescale, full xtal
+  else if((*cycles >>= 3) < RESOLUTION) bits = _BV(CS11);                      // prescale by /8
+  else if((*cycles >>= 3) < RESOLUTION) bits = _BV(CS11) | _BV(CS10);          // prescale by /64
+  else if((*cycles >>= 2) < RESOLUTION) bits = _BV(CS12);                      // prescale by /256
+  else if((*cycles >>= 2) < RESOLUTION) bits = _BV(CS12) | _BV(CS10);          // prescale by /1024
+  else        *cycles = RESOLUTION - 1, bits = _BV(CS12) | _BV(CS10);          // request was out of bounds, set as maximum
+  return bits;
+}
+
 void TimerOne::setPeriod(long microseconds)             // AR modified for atomic access
 {
+  long cycles;
   
-  long cycles = (F_CPU / 2000000) * microseconds;                                // the counter runs backwards after TOP, interrupt is at BOTTOM so divide microseconds by 2
-  if(cycles < RESOLUTION)              clockSelectBits = _BV(CS10);              // no prescale, full xtal
-  else if((cycles >>= 3) < RESOLUTION) clockSelectBits = _BV(CS11);              // prescale by /8
-  else if((cycles >>= 3) < RESOLUTION) clockSelectBits = _BV(CS11) | _BV(CS10);  // prescale by /64
-  else if((cycles >>= 2) < RESOLUTION) clockSelectBits = _BV(CS12);              // prescale by /256
-  else if((cycles >>= 2) < RESOLUTION) clockSelectBits = _BV(CS12) | _BV(CS10);  // prescale by /1024
-  else        cycles = RESOLUTION - 1, clockSelectBits = _BV(CS12) | _BV(CS10);  // request was out of bounds, set as maximum
+  clockSelectBits = scaleFor(microseconds, &cycles);
   
   oldSREG = SREG;                               
   cli();                                                        // Disable interrupts for 16 bit register access
@@ -64,6 +79,35 @@ void TimerOne::setPeriod(long microseconds)             // AR modified for atomi
   TCCR1B |= clockSelectBits;                                          // reset clock select register, and starts the clock
 }
 
+bool TimerOne::adjustPeriod(long microseconds)       // AR added - new TOP for a running timer, keeping the count.  Only valid while counting up from BOTTOM, ie from the overflow interrupt
+{
+  long cycles;
+  bool done = false;
+  
+  if(scaleFor(microseconds, &cycles) != clockSelectBits) return false;  // Changing prescaler mid-count would rescale the ticks already counted
+  
+  oldSREG = SREG;
+  cli();
+  if(TCNT1 < cycles) {                                                // Too late if count already past new TOP
+    ICR1 = pwmPeriod = cycles;
+    done = true;
+  }
+  SREG = oldSREG;
+  return done;
+}
+
+unsigned long TimerOne::getPeriod()                     // AR added - period in microseconds actually programmed, after rounding to the prescaler
+{
+  const char scaleLookup[] = { 0, 0, 3, 6, 8, 10 };
+  
+  return ((unsigned long)pwmPeriod << (scaleLookup[clockSelectBits] + 1)) / (F_CPU / 1000000L);    // Up and down, so 2 * TOP ticks
+}
+
+bool TimerOne::overflowPending()         // AR added - overflow has happened but its interrupt not yet run (eg interrupts disabled)
+{
+  return (TIFR1 & _BV(TOV1)) != 0;
+}
+
 void TimerOne::setPwmDuty(char pin, int duty)
 {
   unsigned long dutyCycle = pwmPeriod;
@@ -136,6 +180,7 @@ void TimerOne::start()  				// AR modified
   oldSREG = SREG;                       // AR - save status register
   cli();                                // AR - Disable interrupts
   TCNT1 = 1;                    		// AR set to 1 (rather than 0) to avoid phantom interrupt
+  TIFR1 = _BV(TOV1);                    // AR - count restarted, so an overflow not yet serviced is stale.  Written 1 clears it
   SREG = oldSREG;                       // AR - Restore status register
   
   TCCR1B |= clockSelectBits;
@@ -170,7 +215,7 @@ unsigned long TimerOne::read()          //returns the value of the timer in micr
 
         //if we are counting down add the top value to how far we have counted down
         tmp = (  (tcnt1>tmp) ? (tmp) : (long)(ICR1-tcnt1)+(long)ICR1  );                // AR amended to add casts and reuse previous TCNT1
-        return ((tmp*1000L)/(F_CPU /1000L))<<scale;
+        return (tmp<<scale)/(F_CPU/1000000L);                                            // AR amended to shift before dividing - at most 131070<<10, so no overflow
 }
  
 
@@ -5,6 +5,7 @@
  *  Modified June 2009 by Michael Polli and Jesse Tane to fix a bug in setPeriod() which caused the timer to stop
  *  Modified June 2011 by Lex Talionis to add a function to read the timer
  *  Modified Oct 2011 by Andrew Richards to add startBottom() function
+ *  Modified Oct 2026 by Andrew Richards to add adjustPeriod(), getPeriod() and overflowPending() functions
  *
  *  This is free software. You can redistribute it and/or modify it under
  *  the terms of Creative Commons Attribution 3.0 United States License. 
@@ -42,6 +43,9 @@ class TimerOne
     void attachInterrupt(void (*isr)(), long microseconds=-1);
     void detachInterrupt();
     void setPeriod(long microseconds);
+    bool adjustPeriod(long microseconds);
+    unsigned long getPeriod();
+    bool overflowPending();
     void setPwmDuty(char pin, int duty);
     void (*isrCallback)();
     
@@ -49,6 +53,7 @@ class TimerOne
   
   	// methods
   	void startBottom();
+  	unsigned char scaleFor(long microseconds, long *cycles);
 };
 
 extern TimerOne Timer1;
@@ -0,0 +1,114 @@
+ /*
+	*****************  WAKETHREAD  **********************
+
+	Description
+	-----------
+
+	Stackless coroutines ('protothreads') run by WAKEUP, so a multi-step protocol can be written as straight-line
+	code - start conversion, wait 750ms, read result - without blocking loop() and without a state variable per step.
+
+	A thread is a normal sleeper function.  WT_BEGIN/WT_END wrap its body in a switch on the line number it last
+	waited at (the 'local continuation', after Adam Dunkels' protothreads), so each time WAKEUP calls it the
+	body carries on from where it left off.  An await records the line, asks WAKEUP to call the thread again, and
+	returns.  The cost is one wakeThread struct per thread and one bunk while it waits - there is no stack per thread
+
+	Rules that come with no stack:
+		- local variables do NOT survive an await.  Keep anything needed afterwards in statics (or the context)
+		- awaits must not sit inside a switch statement within the thread body, and only one await per source line
+		- the body must return void and must not return in between WT_BEGIN and WT_END other than via WT_EXIT
+		- thread is resumed with the context given to wakeThreadInit, from runAnyPending (never as an ISR)
+
+	Primitives
+	----------
+
+		- WT_AWAIT_DELAY(wt, ms)                   carry on after ms.  WT_WAIT_FAILED(wt) afterwards if no bunk was free
+		- WT_AWAIT_UNTIL(wt, condition, pollMs)    carry on once condition is true, testing it every pollMs.  If no bunk
+		                                           is free it carries on regardless, with condition false
+		- WT_AWAIT_AVAILABLE(wt, stream, n, pollMs)  carry on once stream has at least n bytes to read (Serial, EthernetClient ...)
+		- WT_EXIT(wt)                              stop the thread; wakeThreadStart will start it again from the top
+
+		- wakeThreadInit                           set up a thread before first use
+		- wakeThreadStart                          start (or restart) the thread from the top after a delay.  False if no bunk free
+		- wakeThreadStop                           cancel any wait and stop the thread
+		- WT_RUNNING(wt)                           true from start until it ends or is stopped
+
+	Version history
+	---------------
+
+	Version 1.0 Oct 2026 - Initial release, Andrew Richards
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef Wakethread_h
+#define Wakethread_h
+
+#include "Arduino.h"
+#include "Wakeup.h"
+
+static const unsigned int WT_STOPPED		= 0;							// Local continuation values that are never line numbers
+static const unsigned int WT_STARTED		= 1;
+
+struct wakeThread {
+	unsigned int lc;												// Line to carry on from - WT_STOPPED, WT_STARTED or the line of the last await
+	wakeHandle timer;												// Wakeup that will resume the thread.  NO_WAKEUP if the last await couldn't get a bunk
+	void (*resume)(void*);									// Sleeper WAKEUP calls to run the thread - normally a wrapper round the body
+	void *context;													// Passed to resume
+	unsigned int slack;											// Slack for every wait, see WAKEUP::wakeMeAfter
+};
+
+// ************ Macro definitions *******************
+
+#define WT_BEGIN(wt)													switch ((wt)->lc) { default: return; case WT_STARTED:
+#define WT_END(wt)														} (wt)->lc = WT_STOPPED; (wt)->timer = NO_WAKEUP;
+#define WT_EXIT(wt)														do { (wt)->lc = WT_STOPPED; (wt)->timer = NO_WAKEUP; return; } while (0)
+#define WT_AWAIT_DELAY(wt, ms)								do { (wt)->lc = __LINE__; if (wakeThreadSleep((wt), (ms))) return; case __LINE__:; } while (0)
+#define WT_AWAIT_UNTIL(wt, condition, pollMs)	do { (wt)->lc = __LINE__; case __LINE__: if (!(condition) && wakeThreadSleep((wt), (pollMs))) return; } while (0)
+#define WT_AWAIT_AVAILABLE(wt, stream, n, pollMs)		WT_AWAIT_UNTIL((wt), (stream).available() >= (int)(n), (pollMs))
+#define WT_WAIT_FAILED(wt)										((wt)->timer == NO_WAKEUP)
+#define WT_RUNNING(wt)												((wt)->lc != WT_STOPPED)
+
+// *********** Functions ******************
+
+inline void wakeThreadInit(wakeThread *wt, void (*resume)(void*), void *context, unsigned int slack = 0) {
+	wt->lc = WT_STOPPED;
+	wt->timer = NO_WAKEUP;
+	wt->resume = resume;
+	wt->context = context;
+	wt->slack = slack;
+}
+
+inline boolean wakeThreadSleep(wakeThread *wt, unsigned long delay) {			// Used by the await macros.  False if no bunk free
+	return (wt->timer = wakeup.wakeMeAfter(wt->resume, delay, wt->context, TREAT_AS_NORMAL, wt->slack)) != NO_WAKEUP;
+}
+
+inline void wakeThreadStop(wakeThread *wt) {					// A wake already queued for runAnyPending finds the thread stopped, and does nothing
+	wakeup.cancelWakeup(wt->timer);
+	wt->timer = NO_WAKEUP;
+	wt->lc = WT_STOPPED;
+}
+
+inline boolean wakeThreadStart(wakeThread *wt, unsigned long delay) {
+	wakeThreadStop(wt);
+	wt->lc = WT_STARTED;
+	if (wakeThreadSleep(wt, delay)) return true;
+	wt->lc = WT_STOPPED;
+	return false;
+}
+
+#endif
@@ -17,23 +17,96 @@
 		  - as an ordinary function available to run after the defined delay.  The function is run in 
 			response to a poll by the main program calling runAnyPending()
 	
-	Comments use a lighthearted analogy of 'sleepers' in 'bunks'.  New sleepers are put in the first free bunk
-	starting from the bottom (index 0).  When a sleeper wakes and leaves, the topmost sleeper is moved to the 
-	newly-vacant bunk, thus optimising access to free bunks above
+	Comments use a lighthearted analogy of 'sleepers' in 'bunks'.  New sleepers are put in any free bunk and stay
+	there until they leave.  Each bunk records the absolute time on the WAKEUP clock at which its sleeper is due,
+	and a binary min-heap of bunk numbers keeps the lightest sleeper on top.  timerISR therefore only looks at the
+	sleepers that are due, and putting to sleep, cancelling and waking cost O(log n) rather than a walk of every bunk
+	
+	The WAKEUP clock (_now) advances by one heartbeat per timerISR and by syncClock() whenever the heartbeat is 
+	restarted early.  Deadlines are only ever compared as distances ahead of _now, so the clock wrapping after 49
+	days does no harm provided no deadline is more than 49 days away (see MAX_DAYS)
+	
+	Repeating sleepers are drift-free: the next deadline is the previous deadline plus the period, never the time
+	the sleeper happened to be woken.  Any uS by which real time runs ahead of _now (interrupt latency, sub-ms time
+	when the heartbeat is restarted, rounding of the Timer1 period) is carried in _lostUs and taken off the next
+	Timer1 period.  Where the prescaler allows, the next period is set without stopping Timer1 (adjustPeriod), so
+	the time taken by timerISR itself doesn't count at all.  Where Timer1 has to be restarted (a new prescaler, or a
+	sleeper added or rearmed), syncClock measures _lostUs afresh from micros() against _baseMicros - the micros()
+	reading at which the WAKEUP clock read _now, which only ever moves on by whole ms as _now does.  Timer0 is never
+	restarted, so the time a restart takes is paid once, on that heartbeat, and never carried into the next; adding up
+	Timer1 readings instead leaked a few uS at every restart.  (micros() stops if interrupts are held off for more than
+	a ms, and a restart after that is late by the time it lost - once.)  If real time gets a whole ms or more ahead,
+	the clock jumps forward and repeating sleepers may find they have missed periods - CATCHUP_ flags say what to do:
+		- CATCHUP_SKIP (default)  wake once, next deadline is the next one in phase
+		- CATCHUP_COALESCE        wake once, next deadline is a full period after this wake
+		- CATCHUP_BURST           wake for every missed period in turn, all in the same timerISR.  Wakes that
+		                          find the pending ring full are dropped and counted (pendingOverflows)
+	
+	Normal sleepers that have woken wait in a ring for runAnyPending().  timerISR is the only writer of _pendHead and
+	runAnyPending the only writer of _pendTail; both are bytes, so read and written atomically, and each side
+	only touches a slot after the other has finished with it.  The main loop can therefore drain the ring without
+	disabling interrupts.  If the ring is full the sleeper is dropped and counted (pendingOverflows) rather than
+	overwriting one already queued
+	
+	There is one ring per priority (setPriority, default PRIORITY_NORMAL).  timerISR queues sleepers in deadline
+	order, so runAnyPending takes the highest priority ring with anything in it, oldest first, and looks again after
+	every sleeper in case something more urgent has woken meanwhile.  Given a budget in uS, runAnyPending stops 
+	starting new sleepers once it is used up and leaves the rest for the next call, so a slow web request can't hold
+	up the channel daemons for long.  A sleeper that has started always runs to completion
+	
+	wakeMeAfter returns a handle (bunk number plus the bunk's generation) which the caller can keep to cancel,
+	reset or reschedule the sleeper without a search.  Sleepers never move bunk, and the generation changes
+	whenever a bunk is vacated, so a handle to a sleeper that has left (or to an identical sleeper that left 
+	earlier) is simply refused.  The older calls that match on callback, delay and context are still available
+	
+	Each sleeper can be given some slack - ms it doesn't mind being woken late by.  The heartbeat is then set to the
+	earliest time by which some sleeper has run out of slack, and every sleeper due by then is woken in the same
+	timerISR, rather than each one getting its own (much like Linux timer slack).  Slack doesn't move the phase of
+	a repeating sleeper, as the next deadline is still worked out from the last one.  isrsLastHour() and 
+	isrsSavedLastHour() show how many timerISR runs there were, and how many more there would have been without slack
+	
+	Timer1 is reached only through WAKEUP_TIMER.  Defining WAKEUP_HOST swaps in a virtual Timer1 (host/WakeupHost.h)
+	that runs on a simulated clock, so scheduling can be replayed on a PC - days of heartbeats in a fraction of a
+	second, and the same result every time.  Wakes come within two Timer1 ticks of the deadline (128uS at the 
+	longest heartbeats - the period is rounded to the prescaler, and TimerOne::start() begins the count at 1), plus
+	the 4uS resolution of micros() and the few uS a restart takes on the heartbeat after one, and
+	a sleeper's first deadline is on the ms grid of the WAKEUP clock, so up to 1ms short of the delay asked for
+	
+	With WAKEUP_STATS defined, timerISR stamps each normal sleeper with micros() as it is queued, and runAnyPending
+	times it again at dispatch and on return.  For each callback (up to MAXSTATS) a histogram of the latency in
+	between, the worst latency, and the total and worst run time are kept, so MAXPENDING, polling intervals and 
+	budgets can be tuned from real figures.  statsLine() formats one callback per line, ready for syslog or a web page.
+	TREAT_AS_ISR sleepers aren't timed - they run straight away, and timing them would lengthen the ISR
+	
+	setContextHook() lets whoever hands out contexts (the HA switcher) know when WAKEUP is finished with one.  A sleeper
+	holds its context from wakeMeAfter until it leaves its bunk (one-shot woken, or cancelled) - the caller's reference
+	passes to it, so there is no hook call on the way in.  Each wake holds the context again from being queued until
+	the sleeper has run, so a context can be freed as soon as the last reference goes, even if a cancel lands between
+	a wake and its dispatch.  The hook returns false if it can't give a hold, and that wake is then lost (counted as
+	an overflow, as for a full queue), so there is never a release for a hold that wasn't granted.  The hook is called
+	with interrupts disabled, except for the release after runAnyPending.  Only sleepers given a context are reported
+	
+	Bunks (MAXSLEEPERS) and the pending queue per priority (MAXPENDING) take most of WAKEUP's SRAM - about 19 bytes
+	a bunk and 27 a pending slot.  They come from WAKEUP_SLEEPERS and WAKEUP_PENDING, which each controller sets in 
+	HA_globals.h; anything else gets 12 and 8.  sizeof(wakeup) is what a build actually uses
 	
 	Functions available
     -------------------
     
     - init                 Must be called before first use of WAKEUP class
-    - wakeMeAfter          Request a nominated function to be called in the future. Returns false if no slots free.  Arguments:
+    - wakeMeAfter          Request a nominated function to be called in the future. Returns NO_WAKEUP if no slots free.  Arguments:
         - sleeper          The function to be called
-        - ms               The delay, in mS.  If positive then one-shot.  If negative then repeats after reset
+        - delay            The delay, in mS unless a UNITS_ flag given
         - context          A pointer to data providing the called function with the context for the call
-        - treatAsISR       A flag indicating whether the function is to be called as an extended Interrupt Service Routine
-                           (fast, but limited processing allowed) or as a normal function in response to a poll by the main
-                           programme (speed of response depends on polling frequency, but much more can be done safely
-    - runAnyPending        Called by the main program (frequently) to allow normal sleepers to run (once they've woken)
+        - flags            TREAT_AS_ISR if the function is to be called as an extended Interrupt Service Routine
+                           (fast, but limited processing allowed), otherwise as a normal function in response to a poll by the main
+                           programme (speed of response depends on polling frequency, but much more can be done safely.
+                           REPEAT_COUNT to repeat, UNITS_ and CATCHUP_ flags as described in Wakeup.h
+        - slack            Optional mS the wake may be late by, to share timerISR with other sleepers
+    - runAnyPending        Called by the main program (frequently) to allow normal sleepers to run (once they've woken).  Optional
+                           budget in uS; returns true if sleepers were left for next time
     - freeSlots            Returns the number of sleeper slots left    
+    - statsLine            Text for one callback's telemetry (WAKEUP_STATS only).  clearStats starts again
     
 	
 	Version history
@@ -44,6 +117,22 @@
 											 - change long ms to unsigned long ms
 											 - specify repeating timer with additional flag, rather than negative ms
 											 - specify units with additional flags - ms, secs, min, hours, days
+	Version 1.2 Oct 2026 - Sleepers held against absolute deadlines in a binary min-heap
+											 - timerISR only touches sleepers that are due; insert, cancel and expiry are O(log n)
+											 - TREAT_AS_ISR sleepers without context now called (previously cast but not invoked)
+											 - repeating sleepers keep a fixed phase; lost uS carried forward, and restarts timed from micros(),
+											   instead of CODEOVERHEAD guesswork
+											 - CATCHUP_ flags for missed periods of repeating sleepers
+											 - normal sleepers queued in a lock-free ring (first in, first out), with overflow count
+											 - wakeMeAfter returns a generation-checked handle; cancel, reset and reschedule by handle
+											 - optional slack per sleeper to batch wakes, with counts of timerISR runs saved per hour
+											 - priority classes for normal sleepers, and time budget for runAnyPending
+											 - latency histogram and run time per normal sleeper (WAKEUP_STATS)
+											 - timer reached through WAKEUP_TIMER; virtual Timer1 for host builds (WAKEUP_HOST)
+											 - delay out of range for its units refused, rather than taken as ms
+											 - sleeper added, reset or rescheduled while a heartbeat overflow is pending no longer loses that heartbeat
+											 - bunks and pending queues sized per build (WAKEUP_SLEEPERS, WAKEUP_PENDING)
+											 - setContextHook reports the lifetime of each sleeper's context
 	
 	Licensing
 	---------
@@ -65,263 +154,621 @@
 
 
 #include "Wakeup.h"
+
+// Timer backend.  Anything with TimerOne's initialize, attachInterrupt, start, stop and read, plus adjustPeriod,
+// getPeriod and overflowPending, will do.  WAKEUP_HOST builds against the virtual Timer1 in host/, for running on a PC
+#ifdef WAKEUP_HOST
+#include "WakeupHost.h"
+#define WAKEUP_TIMER hostTimer
+#else
 #include "TimerOne.h"
 #include "HA_globals.h"
+#define WAKEUP_TIMER Timer1
+#endif
 
 
 void WAKEUP::init() {		// Constructor not possible due to dependency on Timer1
   _numSleepers = 0;			// No sleepers
-  _numPending = 0;
+  for (int p = 0; p < NUM_PRIORITIES; p++) _pendHead[p] = _pendTail[p] = 0;
+  _pendOverflows = 0;
+  _hourStart = 0;
+  _isrs = _isrsSaved = _lastHourIsrs = _lastHourSaved = 0;
   _inISR = false;
-  Timer1.initialize();
+  _now = 0;
+  _lostUs = 0;
+  _baseMicros = 0;
+  
+  // All bunks empty - chain them into the free list
+  for (int i = 0; i < MAXSLEEPERS; i++) {
+  	_bunks[i].heapPos = (i + 1 < MAXSLEEPERS) ? i + 1 : NO_BUNK;
+  	_bunks[i].generation = 1;
+  }
+  _freeBunk = 0;
+  
+#ifdef WAKEUP_STATS
+  clearStats();
+#endif
+  
+  WAKEUP_TIMER.initialize();
 }
 
-boolean WAKEUP::wakeMeAfter( void (*sleeper)(), unsigned long delay, byte flags) {
+wakeHandle WAKEUP::wakeMeAfter( void (*sleeper)(), unsigned long delay, byte flags, unsigned int slack) {
 	flags &= ~HAS_CONTEXT;
-	return addSleeper( (void(*)(void*)) sleeper, delay, NULL, flags);
+	return addSleeper( (void(*)(void*)) sleeper, delay, NULL, flags, slack);
 }
 
-boolean WAKEUP::wakeMeAfter( void (*sleeper)(void*), unsigned long delay, void *context, byte flags) {
+wakeHandle WAKEUP::wakeMeAfter( void (*sleeper)(void*), unsigned long delay, void *context, byte flags, unsigned int slack) {
 	byte passFlags = HAS_CONTEXT | flags;
-	return addSleeper(sleeper, delay, context, passFlags);
+	return addSleeper(sleeper, delay, context, passFlags, slack);
 }
 
-boolean WAKEUP::addSleeper( void (*sleeper)(void*), unsigned long delay, void *context, byte flags) {
+wakeHandle WAKEUP::addSleeper( void (*sleeper)(void*), unsigned long delay, void *context, byte flags, unsigned int slack) {
 //	SAVE_CONTEXT("Wkup");
 //	SENDLOG('N', "Delay = ", delay);
-  unsigned long msSinceLast;
   unsigned long ms = adjustDelay(delay, flags);			// Adjust for units
+  byte bunk;
    
   // Check the time requested and if there is a free bunk to store the sleeper
-  if (ms == 0 || _numSleepers >= MAXSLEEPERS) return false;
+  if (ms == 0 || _numSleepers >= MAXSLEEPERS) return NO_WAKEUP;
 
-  _oldSREG = SREG;
+  byte oldSREG = SREG;
   cli();
   
-  // If any already sleeping, then get the count from start of heartbeat and deduct from all active timers
-  if (_numSleepers > 0 && (msSinceLast = msElapsed()) > 0) {
-    for (int i = 0; i < _numSleepers; i++) _bunks[i].timeToWake -= msSinceLast; 
+  // Bring the clock up to date - heartbeat restarts below, so time since last heartbeat would otherwise be lost
+  if (_numSleepers > 0) syncClock();
+  else {																		// Clock starts again from here
+  	_lostUs = 0;
+  	_baseMicros = micros();
   }
 
-  // Put new sleeper into top bunk and set alarm clock
-  _bunks[_numSleepers].sleepDuration = ms;					// Save the delay to inform timerISR
-  _bunks[_numSleepers].callback = sleeper;					// Put sleeper into bunk
-  _bunks[_numSleepers].flags = flags;								// MSB == context flag; LSB = ISR flag
-  _bunks[_numSleepers].context = context;						// Save its context
-  _bunks[_numSleepers].timeToWake = ms;							// Set the delay 
+  // Take a bunk from the free list and put new sleeper into it
+  bunk = _freeBunk;
+  _freeBunk = _bunks[bunk].heapPos;
+  
+  _bunks[bunk].sleepDuration = ms;					// Save the delay for repeats and resets
+  _bunks[bunk].slack = slack;
+  _bunks[bunk].priority = PRIORITY_NORMAL;
+  _bunks[bunk].callback = sleeper;					// Put sleeper into bunk
+  _bunks[bunk].flags = flags;								// MSB == context flag; LSB = ISR flag
+  _bunks[bunk].context = context;						// Save its context
+  _bunks[bunk].wakeAt = _now + ms;					// Set the alarm clock
 
+  // Add to bottom of heap and let it rise to its place
+  _heap[_numSleepers] = bunk;
+  _bunks[bunk].heapPos = _numSleepers;
   _numSleepers++; 
-  
-  SREG = _oldSREG;  
+  siftUp(_numSleepers - 1);
   
   startHeartbeat();    // Set counter going with an appropriate heartbeat
   
+  wakeHandle handle = ((wakeHandle)_bunks[bunk].generation << 8) | bunk;
+  
+  SREG = oldSREG;  
+  
  // printBunks();
      
  // RESTORE_CONTEXT
   
-  return true;  
+  return handle;  
 }
 /*
 void WAKEUP::printBunks() {
 	Serial.print("Heartbeat: ");
 	Serial.print(_heartbeat);
+	Serial.print("ms. Clock: ");
+	Serial.print(_now);
 	Serial.print("ms. ");
 	
 	Serial.print(_numSleepers);
 	Serial.print(" sleepers & ");
-	Serial.print(_numPending);
+	Serial.print((byte)(_pendHead[PRIORITY_NORMAL] - _pendTail[PRIORITY_NORMAL]));
 	Serial.println(" pending");
 	
-	for (int i = 0; i < _numSleepers; i++) {
-		Serial.print("Sleeper: ");
+	for (unsigned int i = 0; i < _numSleepers; i++) {
+		byte bunk = _heap[i];
+		Serial.print("Heap: ");
 		Serial.print(i);
 		
+		Serial.print(", bunk: ");
+		Serial.print(bunk);
+		
 		Serial.print(", callback: ");
-		Serial.print((unsigned int)_bunks[i].callback);
+		Serial.print((unsigned int)_bunks[bunk].callback);
 		
 		Serial.print(", duration: ");
-		Serial.print(_bunks[i].sleepDuration);
+		Serial.print(_bunks[bunk].sleepDuration);
 		
-		Serial.print("ms, ttw: ");
-		Serial.print(_bunks[i].timeToWake);
+		Serial.print("ms, wake at: ");
+		Serial.print(_bunks[bunk].wakeAt);
 		
 		Serial.print("ms, flags: ");
-		Serial.print(_bunks[i].flags, BIN);
+		Serial.print(_bunks[bunk].flags, BIN);
 		
 		Serial.print(", context: ");
-		Serial.println((unsigned int)_bunks[i].context, HEX);
+		Serial.println((unsigned int)_bunks[bunk].context, HEX);
 	}
 	
-	for (int i = 0; i < _numPending; i++) {
+	for (byte p = 0; p < NUM_PRIORITIES; p++) for (byte i = _pendTail[p]; i != _pendHead[p]; i++) {
+		byte slot = i & (MAXPENDING - 1);
 		Serial.print("Pending: ");
-		Serial.print(i);
+		Serial.print(p);
+		Serial.print("/");
+		Serial.print(slot);
 		
 		Serial.print(", callback: ");
-		Serial.print((unsigned int)_pending[i].callback);
+		Serial.print((unsigned int)_pending[p][slot].callback);
 		
 		Serial.print(", flags: ");
-		Serial.print(_pending[i].flags, BIN);
+		Serial.print(_pending[p][slot].flags, BIN);
 		
 		Serial.print(", context: ");
-		Serial.println((unsigned int)_pending[i].context, HEX);
+		Serial.println((unsigned int)_pending[p][slot].context, HEX);
 	}
 	
 }
 */
 
-void WAKEUP::startHeartbeat() {      // Set heartbeat to longest required to wake lightest sleeper
+long WAKEUP::nextHeartbeat() {      // Set heartbeat to longest required to wake lightest sleeper.  Lightest sleeper is always on top of heap
+  long us;
+  
   _heartbeat = MAXHEARTBEAT;
   
-  _oldSREG = SREG;
+  byte oldSREG = SREG;
   cli();
-  for (int i = 0; i < _numSleepers; i++) {
-	  if (_bunks[i].timeToWake > 0 && _bunks[i].timeToWake < _heartbeat) _heartbeat = _bunks[i].timeToWake;
+  if (_numSleepers > 0) {
+  	unsigned long timeToWake = wakeWindow(0, 0xFFFFFFFF);			// With slack - the earliest time any due sleeper runs out of it
+  	if (timeToWake < _heartbeat) _heartbeat = (timeToWake > 0) ? timeToWake : 1;
   }
-  SREG = _oldSREG;
+  us = _heartbeat * 1000 - _lostUs;				// Real time already ahead of the clock, so shorten the period to match
+  SREG = oldSREG;
+
+  return (us < MINPERIOD) ? MINPERIOD : us;
+}
+
+unsigned long WAKEUP::wakeWindow(byte heapPos, unsigned long latest) {		// Interrupts disabled.  Visits only sleepers due before 'latest', so rarely more than a handful
+	byte bunk = _heap[heapPos];
+	unsigned long wakeAt = _bunks[bunk].wakeAt - _now;
+	
+	if (wakeAt >= latest) return latest;							// Heap order, so nothing below here is due any sooner
+	if (wakeAt + _bunks[bunk].slack < latest) latest = wakeAt + _bunks[bunk].slack;
+	
+	unsigned int child = (heapPos << 1) + 1;
+	if (child < _numSleepers) latest = wakeWindow(child, latest);
+	if (child + 1 < _numSleepers) latest = wakeWindow(child + 1, latest);
+	return latest;
+}
 
-  Timer1.start();
-  Timer1.attachInterrupt(timerISRWrapper, _heartbeat * 1000 - (_numSleepers * CODEOVERHEAD));
+void WAKEUP::startHeartbeat() {
+  // Set period before zeroing the count, otherwise ticks counted at the old prescaler are read at the new one
+  WAKEUP_TIMER.attachInterrupt(timerISRWrapper, nextHeartbeat());
+  WAKEUP_TIMER.start();
+  _periodUs = WAKEUP_TIMER.getPeriod();
 }
 
 
 void WAKEUP::stopHeartbeat() {
-  Timer1.stop();
+  WAKEUP_TIMER.stop();
 }
 
-unsigned int WAKEUP::msElapsed() {
-  return Timer1.read() / 1000;
+void WAKEUP::syncClock() {			// Interrupts disabled, at least one sleeper.  The heartbeat is restarted straight after
+	long us = (long)(micros() - _baseMicros);			// Real time since the clock read _now, whatever Timer1 has been through.  Heartbeats are
+																								// at most MAXHEARTBEAT, so well inside micros() wrapping at 71 minutes
+	
+	// Move whole ms onto the clock, but never past the lightest sleeper - it's timerISR's job to wake it
+	if (us >= 1000) {
+		unsigned long ms = us / 1000;
+		unsigned long timeToWake = _bunks[_heap[0]].wakeAt - _now;
+		if (ms > timeToWake) ms = timeToWake;
+		_now += ms;
+		_baseMicros += ms * 1000;
+		us -= (long)ms * 1000;
+	}
+	_lostUs = us;
 }
 
 unsigned int WAKEUP::freeSlots() {
   return MAXSLEEPERS - _numSleepers;
 }
 
-unsigned long WAKEUP::adjustDelay(unsigned long delay, byte flags) {
-	if ((flags & UNITS_SECONDS) && (delay <= MAX_SECONDS)) return delay * 1000;
-	if ((flags & UNITS_MINUTES) && (delay <= MAX_MINUTES)) return delay * 1000 * 60;
-	if ((flags & UNITS_HOURS) && (delay <= MAX_HOURS)) return delay * 1000 * 60 * 60;
-	if ((flags & UNITS_DAYS) && (delay <= MAX_DAYS)) return delay * 1000 * 60 * 60 * 24;
-	return delay;
+unsigned int WAKEUP::pendingOverflows() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int overflows = _pendOverflows;
+  SREG = oldSREG;
+  return overflows;
 }
 
-void WAKEUP::runAnyPending() {
+unsigned int WAKEUP::isrsLastHour() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int isrs = _lastHourIsrs;
+  SREG = oldSREG;
+  return isrs;
+}
+
+unsigned int WAKEUP::isrsSavedLastHour() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int saved = _lastHourSaved;
+  SREG = oldSREG;
+  return saved;
+}
+
+unsigned long WAKEUP::adjustDelay(unsigned long delay, byte flags) {		// 0 if out of range, so refused like a zero delay
+	switch (flags & MASK_UNITS) {
+		case 0:								return delay;
+		case UNITS_SECONDS:	if (delay <= MAX_SECONDS) return delay * 1000; break;
+		case UNITS_MINUTES:	if (delay <= MAX_MINUTES) return delay * 1000 * 60; break;
+		case UNITS_HOURS:		if (delay <= MAX_HOURS) return delay * 1000 * 60 * 60; break;
+		case UNITS_DAYS:		if (delay <= MAX_DAYS) return delay * 1000 * 60 * 60 * 24; break;
+	}
+	return 0;
+}
+
+boolean WAKEUP::runAnyPending(unsigned long budgetUs) {
 	void (*callback)(void*);
 	void *context;
 	byte flags;
+	unsigned long started = micros();
+	byte p;
 
-	// Provided this isn't being called from sleeper running under timerISR, then process all pending sleepers
-	if (_inISR == false) while (_numPending > 0) {			// Queue could grow dynamically as new sleepers awake	
-		_oldSREG = SREG;					
-		cli();							
-		_numPending--;					// timerISR can change, so disable interrupts & take snapshot here
-		flags = _pending[_numPending].flags;
-		callback = _pending[_numPending].callback;
-		context = _pending[_numPending].context;
-		SREG = _oldSREG;
+	for (;;) {
+		// Highest priority with anything waiting - queues could grow dynamically as new sleepers awake
+		for (p = 0; p < NUM_PRIORITIES; p++) if (_pendTail[p] != _pendHead[p]) break;
+		if (p == NUM_PRIORITIES) return false;
+		
+		// Not from a sleeper running under timerISR, and not once budget is used up - leave the rest for next time
+		if (_inISR || (budgetUs > 0 && micros() - started >= budgetUs)) return true;
+		
+		byte slot = _pendTail[p] & (MAXPENDING - 1);
+		callback = _pending[p][slot].callback;				// timerISR won't touch this slot until _pendTail moves on, so no need to disable interrupts
+		context = _pending[p][slot].context;
+		flags = _pending[p][slot].flags;
+#ifdef WAKEUP_STATS
+		unsigned long dispatched = micros();
+		unsigned long latencyUs = dispatched - _pending[p][slot].wokeUs;
+#endif
+		_pendTail[p]++;																// Hand slot back to timerISR
 		
 		// Call sleeper as normal function call - take as long as you like
 		callback(context); 
+#ifdef WAKEUP_STATS
+		recordStats(callback, latencyUs, micros() - dispatched);
+#endif
+		contextHeld(callback, context, flags, false);
+	}
+}
+
+#ifdef WAKEUP_STATS
+void WAKEUP::recordStats(void (*callback)(void*), unsigned long latencyUs, unsigned long runUs) {
+	byte i;
+	
+	for (i = 0; i < _numStats; i++) if (_stats[i].callback == callback) break;
+	if (i == _numStats) {
+		if (_numStats == MAXSTATS) {
+			_untracked++;
+			return;
+		}
+		memset(&_stats[i], 0, sizeof(_stat));
+		_stats[i].callback = callback;
+		_numStats++;
+	}
+	
+	_stats[i].runs++;
+	_stats[i].totalRunUs += runUs;
+	if (runUs > _stats[i].maxRunUs) _stats[i].maxRunUs = runUs;
+	if (runUs > OVERRUN_US && _stats[i].overruns < 0xFFFF) _stats[i].overruns++;
+	if (latencyUs > _stats[i].maxLatencyUs) _stats[i].maxLatencyUs = latencyUs;
+	
+	byte bucket = 0;																// <256uS, then each bucket 4 times the last
+	for (latencyUs >>= 8; latencyUs > 0 && bucket < LATENCY_BUCKETS - 1; latencyUs >>= 2) bucket++;
+	if (_stats[i].latency[bucket] < 0xFFFF) _stats[i].latency[bucket]++;
+}
+
+boolean WAKEUP::statsLine(byte index, char *buffer, int maxLen) {		// Callback is a word address on AVR - double it to look up in the .map file
+	int len;
+	
+	if (index > _numStats) return false;
+	if (index == _numStats) {												// Finish with the totals
+		snprintf(buffer, maxLen, "untracked=%lu overflows=%u isrs/h=%u saved/h=%u", _untracked, pendingOverflows(), isrsLastHour(), isrsSavedLastHour());
+		return true;
+	}
+	
+	_stat *s = &_stats[index];
+	len = snprintf(buffer, maxLen, "%04x n=%lu ovr=%u run=%lu/%lu lat=%lu hist=", (unsigned int)(uintptr_t)s->callback, s->runs, s->overruns, 
+									s->runs ? s->totalRunUs / s->runs : 0, s->maxRunUs, s->maxLatencyUs);
+	for (byte b = 0; b < LATENCY_BUCKETS && len > 0 && len < maxLen; b++) {
+		len += snprintf(buffer + len, maxLen - len, b ? ",%u" : "%u", s->latency[b]);
+	}
+	return true;
+}
+
+void WAKEUP::clearStats() {
+	_numStats = 0;
+	_untracked = 0;
+}
+#endif
+
+// **************  Heap maintenance - interrupts must be disabled  *************
+
+boolean WAKEUP::earlier(byte bunkA, byte bunkB) {			// Distances ahead of _now, so correct across clock wrap
+	return (_bunks[bunkA].wakeAt - _now) < (_bunks[bunkB].wakeAt - _now);
+}
+
+void WAKEUP::heapSwap(byte posA, byte posB) {
+	byte bunkA = _heap[posA];
+	byte bunkB = _heap[posB];
+	
+	_heap[posA] = bunkB;
+	_heap[posB] = bunkA;
+	_bunks[bunkB].heapPos = posA;
+	_bunks[bunkA].heapPos = posB;
+}
+
+void WAKEUP::siftUp(byte heapPos) {
+	while (heapPos > 0) {
+		byte parent = (heapPos - 1) >> 1;
+		if (!earlier(_heap[heapPos], _heap[parent])) break;
+		heapSwap(heapPos, parent);
+		heapPos = parent;
 	}
 }
 
+void WAKEUP::siftDown(byte heapPos) {
+	for (;;) {
+		unsigned int child = (heapPos << 1) + 1;						// int - can exceed a byte at the bottom of a large heap
+		if (child >= _numSleepers) break;
+		if (child + 1 < _numSleepers && earlier(_heap[child + 1], _heap[child])) child++;		// Pick lighter of the two children
+		if (!earlier(_heap[child], _heap[heapPos])) break;
+		heapSwap(heapPos, child);
+		heapPos = child;
+	}
+}
+
+void WAKEUP::heapRemove(byte heapPos) {
+	byte bunk = _heap[heapPos];
+	
+	// Move bottom of heap into the gap and let it find its level - could need to go either way
+	_numSleepers--;
+	if (heapPos < _numSleepers) {
+		_heap[heapPos] = _heap[_numSleepers];
+		_bunks[_heap[heapPos]].heapPos = heapPos;
+		siftDown(heapPos);
+		siftUp(heapPos);
+	}
+	
+	// Return bunk to free list, invalidating any handles to the sleeper that has just left
+	contextHeld(_bunks[bunk].callback, _bunks[bunk].context, _bunks[bunk].flags, false);
+	_bunks[bunk].heapPos = _freeBunk;
+	_freeBunk = bunk;
+	if (++_bunks[bunk].generation == 0) _bunks[bunk].generation = 1;
+}
+
+int WAKEUP::findSleeper(void (*sleeper)(void*), unsigned long ms, void *context) {
+	for (unsigned int i = 0; i < _numSleepers; i++) {
+		byte bunk = _heap[i];
+	  if ((_bunks[bunk].callback == sleeper) && (_bunks[bunk].sleepDuration == ms) && (_bunks[bunk].context == context)) return i;
+	}
+	return -1;
+}
+
+int WAKEUP::findHandle(wakeHandle handle) {
+	byte bunk = handle & 0xFF;
+	
+	if (bunk >= MAXSLEEPERS || _bunks[bunk].generation != (handle >> 8)) return -1;
+	
+	// Generation of an empty bunk matches the next handle it will issue, so check it's actually in the heap
+	byte heapPos = _bunks[bunk].heapPos;
+	return (heapPos < _numSleepers && _heap[heapPos] == bunk) ? heapPos : -1;
+}
+
+void WAKEUP::rearm(byte heapPos) {
+	syncClock();														// Bring clock up to date, as heartbeat is restarted below
+	_bunks[_heap[heapPos]].wakeAt = _now + _bunks[_heap[heapPos]].sleepDuration;
+	siftDown(heapPos);															// Usually later, but a reschedule can move it either way
+	siftUp(heapPos);
+	
+	// Recalculate the heartbeat
+	startHeartbeat();
+}
+
 // **************  Interrupt Service Routine  *************
 
 void WAKEUP::timerISR() {							// Runs every heartbeat 
-  unsigned int runNowPtr = MAXPENDING;		                // Pointer to top end of _pending to use as temporary scratchpad
+  byte numRunNow = 0;									// TREAT_AS_ISR sleepers in _runNow
+  boolean first = true;
+  unsigned long lastWakeAt = 0;							// Deadline of previous sleeper woken - each different one would have been its own timerISR
+#ifdef WAKEUP_STATS
+  unsigned long wokeUs = micros();					// Stamped on every normal sleeper queued this time
+#endif
+  
+  // How far real time at this interrupt is ahead of the end of the heartbeat.  Normally just Timer1 rounding, but
+  // whole ms if interrupts were held off too long - in which case catch up now, and let CATCHUP_ flags sort out repeats
+  long aheadUs = _lostUs + (long)_periodUs - (long)_heartbeat * 1000;
+  unsigned long dueBy = _heartbeat;
+  if (aheadUs >= 1000) {
+  	dueBy += aheadUs / 1000;
+  	aheadUs %= 1000;
+  }
   
-  // Go through each.  If countdown has finished then put on pending queue and shuffle bunks (if needed)
-  for (int i = 0; i < _numSleepers; i++) {
+  // Take sleepers off the top of the heap for as long as they are due within this heartbeat.  The rest aren't looked at
+  while (_numSleepers > 0) {
+  	byte bunk = _heap[0];
+  	if (_bunks[bunk].wakeAt - _now > dueBy) break;		// Lightest sleeper not yet due, so none are
+  	
+  	if (!first && _bunks[bunk].wakeAt != lastWakeAt) _isrsSaved++;
+  	lastWakeAt = _bunks[bunk].wakeAt;
+  	first = false;
 	  
-	  if (_bunks[i].timeToWake < MAXHEARTBEAT) {				// If getting close to wakeup then convert to signed value before decrementing
-		  long timeToWake = (long)(_bunks[i].timeToWake) - _heartbeat;		
-		  _bunks[i].timeToWake -= _heartbeat;
-		
-			if (timeToWake <= 0) {  
-				// Put in pending queue, either to wake in a few moments or from main program using runAnyPending
-			  if (_bunks[i].flags & TREAT_AS_ISR) {							// Wake later in this function
-	  			if (--runNowPtr <= _numPending) runNowPtr++;		// If runAnyPending not run fast enough then bottom-up and top-down queues may clash, so check
-	  			_pending[runNowPtr].flags = _bunks[i].flags;
-				  _pending[runNowPtr].callback = _bunks[i].callback;
-				  _pending[runNowPtr].context = _bunks[i].context;
-			  }
-			  else {													// Wake in response to runAnyPending
-					_pending[_numPending].flags = _bunks[i].flags;
-				  _pending[_numPending].callback = _bunks[i].callback;
-				  _pending[_numPending].context = _bunks[i].context;
-				  if (++_numPending >= runNowPtr) _numPending--;			
-			  }
-		  
-		  	// Tidy up bunks
-	      if (_bunks[i].flags & REPEAT_COUNT) {					
-		      _bunks[i].timeToWake =_bunks[i].sleepDuration;			// Repeating sleeper, just reset countdown
-	      }
-	      else {						// One-shot sleeper.  If others left, take sleeper in topmost bunk and move to the newly-vacant bunk
-		      _numSleepers--;			
-	      	if (_numSleepers > 0) {				// Move topmost sleeper into this bunk (v rarely might be the same one, but safe so ignore)
-			      _bunks[i].callback = _bunks[_numSleepers].callback;
-			      _bunks[i].flags = _bunks[_numSleepers].flags;
-			      _bunks[i].sleepDuration = _bunks[_numSleepers].sleepDuration;
-			      _bunks[i].timeToWake = _bunks[_numSleepers].timeToWake;
-			      _bunks[i].context = _bunks[_numSleepers].context;
-			      i--;								// Decrement loop counter to ensure this sleeper isn't missed
-		      }
-	      }
-      }
+		// Put in pending queue, either to wake in a few moments or from main program using runAnyPending
+	  // Each wake holds the context, and is lost if the hold is refused - so it is only released if it was granted
+	  if (_bunks[bunk].flags & TREAT_AS_ISR) {							// Wake later in this function
+	  	if (numRunNow < MAXRUNNOW && contextHeld(_bunks[bunk].callback, _bunks[bunk].context, _bunks[bunk].flags, true)) {
+				_runNow[numRunNow].flags = _bunks[bunk].flags;
+			  _runNow[numRunNow].callback = _bunks[bunk].callback;
+			  _runNow[numRunNow].context = _bunks[bunk].context;
+			  numRunNow++;
+			}
+			else _pendOverflows++;
+	  }
+	  else {																											// Wake in response to runAnyPending, if there's room
+	  	byte p = _bunks[bunk].priority;
+	  	if ((byte)(_pendHead[p] - _pendTail[p]) < MAXPENDING && contextHeld(_bunks[bunk].callback, _bunks[bunk].context, _bunks[bunk].flags, true)) {
+		  	byte slot = _pendHead[p] & (MAXPENDING - 1);
+				_pending[p][slot].flags = _bunks[bunk].flags;
+			  _pending[p][slot].callback = _bunks[bunk].callback;
+			  _pending[p][slot].context = _bunks[bunk].context;
+#ifdef WAKEUP_STATS
+			  _pending[p][slot].wokeUs = wokeUs;
+#endif
+			  _pendHead[p]++;																					// Publish only once slot is filled
+			}
+			else _pendOverflows++;																	// runAnyPending not run fast enough, or context refused a hold
+	  }
+  
+  	// Tidy up bunks
+    if (_bunks[bunk].flags & REPEAT_COUNT) {					// Repeating sleeper, just reset alarm from the last one (not from now) and let it sink
+    	unsigned long period = _bunks[bunk].sleepDuration;
+    	unsigned long wakeAt = _bunks[bunk].wakeAt + period;
+    	
+    	if (wakeAt - _now <= dueBy) switch (_bunks[bunk].flags & MASK_CATCHUP) {			// Already due again, so periods have been missed
+    		case CATCHUP_BURST:		break;																								// Comes straight back round this loop
+    		case CATCHUP_COALESCE:	wakeAt = _now + dueBy + period; break;
+    		default:							wakeAt += ((_now + dueBy - wakeAt) / period + 1) * period;			// CATCHUP_SKIP - next deadline in phase
+    	}
+      _bunks[bunk].wakeAt = wakeAt;
+      siftDown(0);
     }
-    else _bunks[i].timeToWake -= _heartbeat;
+    else heapRemove(0);						// One-shot sleeper - leaves its bunk
+  }
+  
+  // Advance the clock to the end of this heartbeat.  Every sleeper left is now strictly in the future
+  _now += dueBy;
+  _baseMicros += dueBy * 1000;
+  _lostUs = aheadUs;
+  
+  // Keep count for the hour
+  _isrs++;
+  if (_now - _hourStart >= 3600000UL) {
+  	_lastHourIsrs = _isrs;
+  	_lastHourSaved = _isrsSaved;
+  	_isrs = _isrsSaved = 0;
+  	_hourStart = _now;
   }
   
-  // Start the heartbeat if sleepers left
-  if (_numSleepers == 0) stopHeartbeat(); else startHeartbeat();
+  // Start the next heartbeat if sleepers left.  Timer1 has already started counting it, so just move TOP if possible;
+  // otherwise restart, with the lost time measured from micros() rather than added up from Timer1
+  if (_numSleepers == 0) stopHeartbeat(); 
+  else if (WAKEUP_TIMER.adjustPeriod(nextHeartbeat())) _periodUs = WAKEUP_TIMER.getPeriod();
+  else {
+  	syncClock();
+  	startHeartbeat();
+  }
   
   // Run the TREAT_AS_ISR sleepers that were woken - be quick (and block runAnyPending() from being run)
   _inISR = true;
-  for (int i = runNowPtr; i < MAXPENDING; i++) {
-	  if (_pending[i].flags & HAS_CONTEXT) _pending[i].callback(_pending[i].context); else (void (*)())(_pending[i].callback);
+  for (byte i = 0; i < numRunNow; i++) {
+	  if (_runNow[i].flags & HAS_CONTEXT) _runNow[i].callback(_runNow[i].context); else _runNow[i].callback2();
+	  contextHeld(_runNow[i].callback, _runNow[i].context, _runNow[i].flags, false);
   }
   _inISR = false;
 }
 
 boolean WAKEUP::cancelWakeup(void (*sleeper)(void*), unsigned long delay, void *context, byte flags) {
+	int heapPos;
+	
 	// Adjust delay for units
 	delay = adjustDelay(delay, flags);
 	
-  // Go through each looking for a match
-  for (int i = 0; i < _numSleepers; i++) {
-	  if ((_bunks[i].callback == sleeper) && (_bunks[i].sleepDuration == delay) && (_bunks[i].context == context)) {
-	  	// Found the sleeper, so decrement then overwrite with sleeper in topmost bunk (provided one available)
-      _numSleepers--;			
-    	if (_numSleepers > 0) {				// Move topmost sleeper into this bunk (v rarely might be the same one, but safe so ignore)
-	      _bunks[i].callback = _bunks[_numSleepers].callback;
-	      _bunks[i].flags = _bunks[_numSleepers].flags;
-	      _bunks[i].sleepDuration = _bunks[_numSleepers].sleepDuration;
-	      _bunks[i].timeToWake = _bunks[_numSleepers].timeToWake;
-	      _bunks[i].context = _bunks[_numSleepers].context;
-      }
-      return true;
-    }
-  }
-  return false;
+	byte oldSREG = SREG;
+	cli();
+	
+  // Look for a match and, if found, take sleeper out of the heap - no need to restart heartbeat, an early wake is harmless
+	if ((heapPos = findSleeper(sleeper, delay, context)) >= 0) heapRemove(heapPos);
+	
+	SREG = oldSREG;
+	
+	return heapPos >= 0;
 }
 
 boolean WAKEUP::resetWakeup(void (*sleeper)(void*), unsigned long delay, void *context, byte flags) {
+	int heapPos;
+	
 	// Adjust delay for units
 	delay = adjustDelay(delay, flags);
 	
-  // Go through each looking for a match
-  for (int i = 0; i < _numSleepers; i++) {
-	  if ((_bunks[i].callback == sleeper) && (_bunks[i].sleepDuration == delay) && (_bunks[i].context == context)) {
-	  	// Found the sleeper: reset the time to wake
-    	_bunks[i].timeToWake = _bunks[i].sleepDuration;
-    	
-    	// Recalculate the heartbeat and return
-    	startHeartbeat();
-    	
-      return true;
-    }
-  }
-  return false;
+	byte oldSREG = SREG;
+	cli();
+	
+  // Look for a match and, if found, reset the alarm clock to the original delay from now
+	if ((heapPos = findSleeper(sleeper, delay, context)) >= 0) rearm(heapPos);
+  
+  SREG = oldSREG;
+  
+  return heapPos >= 0;
+}
+
+boolean WAKEUP::cancelWakeup(wakeHandle handle) {
+	int heapPos;
+	
+	byte oldSREG = SREG;
+	cli();
+	if ((heapPos = findHandle(handle)) >= 0) heapRemove(heapPos);
+	SREG = oldSREG;
+	
+	return heapPos >= 0;
+}
+
+boolean WAKEUP::resetWakeup(wakeHandle handle) {
+	int heapPos;
+	
+	byte oldSREG = SREG;
+	cli();
+	if ((heapPos = findHandle(handle)) >= 0) rearm(heapPos);
+	SREG = oldSREG;
+	
+	return heapPos >= 0;
+}
+
+boolean WAKEUP::rescheduleWakeup(wakeHandle handle, unsigned long delay, byte flags) {
+	int heapPos;
+	unsigned long ms = adjustDelay(delay, flags);
+	
+	if (ms == 0) return false;
+	
+	byte oldSREG = SREG;
+	cli();
+	if ((heapPos = findHandle(handle)) >= 0) {
+		_bunks[_heap[heapPos]].sleepDuration = ms;
+		rearm(heapPos);
+	}
+	SREG = oldSREG;
+	
+	return heapPos >= 0;
+}
+
+boolean WAKEUP::setPriority(wakeHandle handle, byte priority) {
+	int heapPos;
+	
+	if (priority >= NUM_PRIORITIES) return false;
+	
+	byte oldSREG = SREG;
+	cli();
+	if ((heapPos = findHandle(handle)) >= 0) _bunks[_heap[heapPos]].priority = priority;
+	SREG = oldSREG;
+	
+	return heapPos >= 0;
+}
+
+void WAKEUP::setContextHook(boolean (*hook)(void (*sleeper)(void*), void *context, boolean hold)) {
+	byte oldSREG = SREG;
+	cli();
+	_contextHook = hook;
+	SREG = oldSREG;
+}
+
+boolean WAKEUP::contextHeld(void (*callback)(void*), void *context, byte flags, boolean hold) {
+	return (_contextHook && (flags & HAS_CONTEXT)) ? _contextHook(callback, context, hold) : true;
 }
 
 WAKEUP wakeup;
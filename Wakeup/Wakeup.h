@@ -14,6 +14,20 @@
 											 - change long ms to unsigned long ms
 											 - specify repeating timer with additional flag, rather than negative ms
 											 - specify units with additional flags - ms, secs, min, hours, days
+	Version 1.2 Oct 2026 - Sleepers held against absolute deadlines in a binary min-heap
+											 - timerISR only touches sleepers that are due; insert, cancel and expiry are O(log n)
+											 - repeating sleepers keep a fixed phase (next deadline = previous deadline + period)
+											 - CATCHUP_ flags choose what happens to missed periods
+											 - units encoded in 3 bits rather than 4 to make room for CATCHUP_ flags
+											 - normal sleepers queued in a lock-free ring; runAnyPending no longer disables interrupts
+											 - wakeMeAfter returns a handle for O(1) cancel, reset and reschedule
+											 - optional slack per sleeper, so nearby deadlines share one timerISR
+											 - priority classes for normal sleepers; runAnyPending takes an optional time budget
+											 - optional telemetry (WAKEUP_STATS): latency histogram and run time per normal sleeper
+											 - timer reached through WAKEUP_TIMER, so WAKEUP_HOST can run it on a PC against a virtual Timer1
+											 - delay out of range for its units refused (was taken as ms)
+											 - MAXSLEEPERS and MAXPENDING set per build from WAKEUP_SLEEPERS and WAKEUP_PENDING
+											 - setContextHook, so an owner of contexts knows when a sleeper has finished with one
 	
 	Licencing
 	---------
@@ -39,11 +53,26 @@
 #include "Arduino.h"
 
 //#include "HA_syslog.h"     
+#ifndef WAKEUP_HOST
+#include "HA_globals.h"																						// Per controller WAKEUP_SLEEPERS and WAKEUP_PENDING
+#endif
+
+#ifndef WAKEUP_SLEEPERS
+#define WAKEUP_SLEEPERS 12																				// Defaults, if the build doesn't size WAKEUP itself
+#endif
+#ifndef WAKEUP_PENDING
+#define WAKEUP_PENDING 8
+#endif
+
+//#define WAKEUP_STATS																						// Keep latency and run time of normal sleepers.  Off by default - costs ~400 bytes of SRAM
+																													// and a micros() per wake.  Define here or in HA_globals.h to turn on
 
-static const byte MAXSLEEPERS 					= 12;							// Max 64k, but unworkable (out of memory and would take too long). Tested with 256; 16-32 generally enough
-static const byte MAXPENDING 						= 8;							// Needs to be large enough to hold max number of sleepers woken in one go, assuming prompt clearance by runAnyPending()
+static const byte MAXSLEEPERS 					= WAKEUP_SLEEPERS;	// Max 254 (bunk indices are bytes).  ISR cost grows with log2 of this, so limit is SRAM not latency
+static const byte MAXPENDING 						= WAKEUP_PENDING;	// Normal sleepers awaiting runAnyPending(), per priority.  Must be a power of 2 (max 128).  Overflows are counted, see pendingOverflows()
+static const byte MAXRUNNOW							= 4;							// TREAT_AS_ISR sleepers woken in one heartbeat
 static const unsigned int MAXHEARTBEAT 	= 8350;						// in ms.  Round down from absolute max of 8,388,480 us (Timer1 limit)   4,294,967,295
-static const byte CODEOVERHEAD 					= 8; 							// Logic analyser-determined to allow for duration of WAKEUP code; calibrated @ 10mS with 8 sleepers
+static const byte CODEOVERHEAD 					= 8; 							// uS per sleeper allowed for by v1.1.  No longer used by WAKEUP, which times restarts from micros(); kept for examples/ISR_benchmark
+static const byte MINPERIOD							= 50;							// uS.  Shortest Timer1 period used while catching up on lost time
 static const unsigned long MAX_SECONDS	= 4294967;				// Base units always held as ms in unsigned long (4,294,967,295 ms)
 static const unsigned long MAX_MINUTES	= 71582;					// MAX_SECONDS / 60
 static const unsigned int MAX_HOURS			= 1193;						// MAX_HOURS / 60
@@ -52,36 +81,84 @@ static const unsigned int MAX_DAYS			= 49;							// MAX_DAYS / 24
 static const byte TREAT_AS_NORMAL 			= 0;							// Queue for execution after call to runAnyPending; runs with interrupts enabled
 static const byte TREAT_AS_ISR 					= B00000001;			// Run immediately timer expires with interrupts DISABLED
 static const byte REPEAT_COUNT					= B00000010; 			// Repeat when triggered
-static const byte UNITS_SECONDS 				= B00000100;			// Default is ms
+static const byte UNITS_SECONDS 				= B00000100;			// Default is ms.  Units are a 3 bit field, so use only one
 static const byte UNITS_MINUTES					= B00001000;
-static const byte UNITS_HOURS						= B00010000;
-static const byte UNITS_DAYS						= B00100000;
+static const byte UNITS_HOURS						= B00001100;
+static const byte UNITS_DAYS						= B00010000;
+static const byte MASK_UNITS						= B00011100;
+static const byte CATCHUP_SKIP					= 0;							// Default.  Repeating sleeper that has missed periods wakes once, then carries on in phase
+static const byte CATCHUP_COALESCE			= B00100000;			// Wakes once for all missed periods, then repeats from that wake (phase moves)
+static const byte CATCHUP_BURST					= B01000000;			// Wakes once for every missed period, back to back, until caught up
+static const byte MASK_CATCHUP					= B01100000;
 static const byte HAS_CONTEXT 					= B10000000;			// Whether to pass context field on call or not
 
+static const byte PRIORITY_HIGH					= 0;							// Normal sleepers run highest priority first, then in order of deadline
+static const byte PRIORITY_NORMAL				= 1;							// Default
+static const byte PRIORITY_LOW					= 2;
+static const byte NUM_PRIORITIES				= 3;							// Each has its own queue of MAXPENDING, so costs SRAM
+
+static const byte MAXSTATS							= 8;							// Different callbacks tracked by WAKEUP_STATS.  Later ones are only counted as untracked
+static const byte LATENCY_BUCKETS				= 8;							// Histogram of uS from wake to dispatch: <256, <1024, <4096 ... each 4 times the last, last is open ended
+static const unsigned int OVERRUN_US		= 5000;						// Sleeper running longer than this counts as an overrun
+
+typedef unsigned int wakeHandle;													// Returned by wakeMeAfter.  Low byte is bunk, high byte its generation
+static const wakeHandle NO_WAKEUP				= 0;							// Never issued - wakeMeAfter failed, or no sleeper yet
+
 class WAKEUP {
 public:
   void init();																																										// Must be called at startup
-  boolean wakeMeAfter( void (*sleeper)(), unsigned long delay, byte flags);												// Function to wake after delay.  Flags determine whether one-shot or repeat, and whether woken as ISR or normal
-  boolean wakeMeAfter( void (*sleeper)(void*), unsigned long delay, void *context, byte flags);		// As above, but with context to be passed to sleeper on wakeup
-  void runAnyPending();																																						// Called by the main program to run any pending sleepers
+  wakeHandle wakeMeAfter( void (*sleeper)(), unsigned long delay, byte flags, unsigned int slack = 0);									// Function to wake after delay.  Flags determine whether one-shot or repeat, and whether woken as ISR or normal.  NO_WAKEUP if no bunk free
+  wakeHandle wakeMeAfter( void (*sleeper)(void*), unsigned long delay, void *context, byte flags, unsigned int slack = 0);	// As above, but with context to be passed to sleeper on wakeup.  Slack is ms the wake may be late by, to share an ISR
+  boolean runAnyPending(unsigned long budgetUs = 0);																								// Called by the main program to run pending sleepers.  Stops once budget (if not 0) used, returning true if any left
   unsigned int freeSlots();																																				// Returns number of bunks available
+  unsigned int pendingOverflows();																																// Returns number of woken sleepers dropped because queue was full
+  unsigned int isrsLastHour();																																		// timerISR runs in the last complete hour on the WAKEUP clock
+  unsigned int isrsSavedLastHour();																																// Extra timerISR runs there would have been in that hour without slack
   void timerISR();																																								// Called every _heartbeat.  Must be public to allow call by timerISRWrapper()
   boolean cancelWakeup(void (*sleeper)(void*), unsigned long delay, void *context, byte flags);								// Cancels wakeup call and removes sleeper
   boolean resetWakeup(void (*sleeper)(void*), unsigned long delay, void *context, byte flags);								// Resets wakeup call to original
+  boolean cancelWakeup(wakeHandle handle);																												// As above, by handle.  False if sleeper has already left (one-shot woken, or cancelled)
+  boolean resetWakeup(wakeHandle handle);
+  boolean rescheduleWakeup(wakeHandle handle, unsigned long delay, byte flags);										// Replace delay (and units) and restart the wait from now.  Handle stays valid
+  boolean setPriority(wakeHandle handle, byte priority);																					// PRIORITY_ for a normal sleeper.  Takes effect from its next wake
+  void setContextHook(boolean (*hook)(void (*sleeper)(void*), void *context, boolean hold));		// Told when WAKEUP takes (hold) or drops a reference to a sleeper's context - see Wakeup.cpp
+#ifdef WAKEUP_STATS
+  boolean statsLine(byte index, char *buffer, int maxLen);																				// One line of text per callback seen by runAnyPending.  False once past the last
+  void clearStats();
+#endif
  
 private:
   // Methods
-  boolean addSleeper( void (*sleeper)(void*), unsigned long delay, void *context, byte flags);	
+  wakeHandle addSleeper( void (*sleeper)(void*), unsigned long delay, void *context, byte flags, unsigned int slack);	
   void printBunks();
-  void startHeartbeat();						// Starts timer based on shortest time to wake
+  long nextHeartbeat();							// Sets _heartbeat from shortest time to wake, and returns Timer1 period needed in uS
+  unsigned long wakeWindow(byte heapPos, unsigned long latest);		// Latest time (ahead of _now) all sleepers due before 'latest' can share a wake
+  void startHeartbeat();						// Restarts timer based on shortest time to wake
   void stopHeartbeat();							// Stops timer (when no sleepers)
-  unsigned int msElapsed();					// Duration in mS since last heartbeat
+  void syncClock();									// Bring _now and _lostUs up to date from micros(), before the heartbeat is restarted
   unsigned long adjustDelay(unsigned long delay, byte flags);			// Adjust delay to reflect units
+  
+  // Heap maintenance - all called with interrupts disabled
+  boolean earlier(byte bunkA, byte bunkB);				// True if bunkA wakes before bunkB
+  void heapSwap(byte posA, byte posB);						// Swap two heap entries and update their back-pointers
+  void siftUp(byte heapPos);											// Restore heap order after a deadline moves earlier
+  void siftDown(byte heapPos);										// Restore heap order after a deadline moves later
+  void heapRemove(byte heapPos);									// Take bunk out of heap and return it to free list
+  int findSleeper(void (*sleeper)(void*), unsigned long ms, void *context);		// Heap position of matching sleeper, or -1
+  int findHandle(wakeHandle handle);							// Heap position of sleeper the handle was issued for, or -1.  O(1)
+  void rearm(byte heapPos);												// Restart sleeper's wait from now and recalculate heartbeat
+  boolean contextHeld(void (*callback)(void*), void *context, byte flags, boolean hold);	// Pass to _contextHook, if sleeper has a context.  False if a hold was refused
+#ifdef WAKEUP_STATS
+  void recordStats(void (*callback)(void*), unsigned long latencyUs, unsigned long runUs);		// Called by runAnyPending after each sleeper
+#endif
 
   // Properties - many can be changed via an ISR, so need to be volatile
-  byte _oldSREG;													// Temporary store of status register
   boolean _inISR;													// Blocks use of runAnyPending by sleepers running under ISR
   volatile unsigned long _heartbeat;			// mS frequency of checking timeToWake 
+  volatile unsigned long _now;						// mS on the WAKEUP clock at start of current heartbeat.  Free running; wraps every 49 days
+  volatile long _lostUs;									// uS real time was ahead of _now when current heartbeat started.  Taken off the next Timer1 period, so never accumulates
+  volatile unsigned long _baseMicros;			// micros() when the WAKEUP clock read _now.  Restarts are timed from it - see syncClock
+  volatile unsigned long _periodUs;				// uS Timer1 period actually running, after rounding to the prescaler
   
   volatile unsigned int _numSleepers;			// Number of sleepers - if zero then turn off heartbeat
   struct _bunk {													// 'Bunk' holding sleeper or empty
@@ -91,11 +168,17 @@ private:
 		};
   	void *context;												// For sleeper to interpret as appropriate when woken
 		byte flags; 													// See constants above
-  	unsigned long sleepDuration;					// Requested delay in mS; if negative then repeating
-  	unsigned long timeToWake;							// Loaded with _sleepDuration and then decremented by time since last heartbeat
-  }  volatile _bunks[MAXSLEEPERS];				// Dynamically reshuffled for performance - first _numSleepers slots are always valid
+		byte heapPos;													// Position in _heap while asleep; next free bunk while empty
+		byte generation;											// Bumped whenever bunk is vacated, so old handles no longer match.  Never 0
+		byte priority;												// Queue used when woken, if TREAT_AS_NORMAL
+  	unsigned long sleepDuration;					// Requested delay in mS
+  	unsigned int slack;										// mS wake may be delayed by to share timerISR with other sleepers.  Keep below sleepDuration for repeats
+  	unsigned long wakeAt;									// Absolute deadline on the WAKEUP clock.  Compared relative to _now, so wrap is harmless
+  }  volatile _bunks[MAXSLEEPERS];				// Sleepers stay in the same bunk until they leave
+  
+  volatile byte _heap[MAXSLEEPERS];				// Bunk indices, binary min-heap on wakeAt.  _heap[0] is next to wake; first _numSleepers valid
+  volatile byte _freeBunk;								// Head of list of empty bunks, linked through heapPos
 
-  volatile unsigned int _numPending;			// Updated in ISR and non-ISR code     
   struct _pend {													// A sleeper that has been woken and is ready to go
   	union {
 			void (*callback)(void*);							// Callback function ('sleeper')
@@ -103,9 +186,39 @@ private:
 		};				
 		void *context;
 		byte flags;
-  } volatile _pending[MAXPENDING];				// Top end also used as temporary scratchpad by timerISR
+#ifdef WAKEUP_STATS
+		unsigned long wokeUs;									// micros() when timerISR queued it
+#endif
+  } volatile _pending[NUM_PRIORITIES][MAXPENDING];		// Ring of normal sleepers per priority.  Single producer (timerISR), single consumer (runAnyPending)
+  volatile byte _pendHead[NUM_PRIORITIES];	// Free running, masked to index.  Only timerISR writes it
+  volatile byte _pendTail[NUM_PRIORITIES];	// Free running, masked to index.  Only runAnyPending writes it
+  volatile unsigned int _pendOverflows;		// Woken sleepers dropped - ring or _runNow full
+  
+  unsigned long _hourStart;								// WAKEUP clock at start of the hour being counted
+  unsigned int _isrs, _isrsSaved;					// timerISR runs, and those saved by slack, so far this hour
+  volatile unsigned int _lastHourIsrs, _lastHourSaved;		// Same for the last complete hour
+  
+  _pend _runNow[MAXRUNNOW];								// Scratchpad for TREAT_AS_ISR sleepers woken this heartbeat
+  
+  boolean (*_contextHook)(void (*sleeper)(void*), void *context, boolean hold);	// NULL unless set.  Not cleared by init, so may be set before it
+
+#ifdef WAKEUP_STATS
+  struct _stat {													// Telemetry for one callback.  Only runAnyPending writes it, so not volatile
+  	void (*callback)(void*);
+  	unsigned long runs;
+  	unsigned int overruns;								// Runs longer than OVERRUN_US
+  	unsigned long totalRunUs;							// Wraps after 71 minutes of run time - clearStats() well before then
+  	unsigned long maxRunUs;
+  	unsigned long maxLatencyUs;
+  	unsigned int latency[LATENCY_BUCKETS];	// Counts stick at 65535
+  } _stats[MAXSTATS];
+  byte _numStats;
+  unsigned long _untracked;								// Runs of callbacks that found _stats full
+#endif
 
-  	
+  static const byte NO_BUNK = 0xFF;				// End of free list
+  typedef char pendingIsPowerOf2[(MAXPENDING & (MAXPENDING - 1)) == 0 ? 1 : -1];		// Compile error if not - ring indices are masked
+  typedef char sleepersFitInByte[WAKEUP_SLEEPERS > 0 && WAKEUP_SLEEPERS < NO_BUNK ? 1 : -1];		// Compile error if not - bunk indices are bytes, NO_BUNK reserved
 };
 
 extern WAKEUP wakeup;
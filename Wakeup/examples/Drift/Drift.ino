@@ -0,0 +1,69 @@
+/* Long-run drift of a repeating WAKEUP sleeper
+
+  A 1000ms repeating TREAT_AS_ISR sleeper logs micros() on each wake.  Once a minute the cumulative difference
+  between the wakes and an ideal 1000ms grid is printed, so drift shows as a trend rather than jitter.
+  micros() runs off the same crystal (Timer0), so crystal error cancels out and only WAKEUP's own drift is left.
+
+  A 7ms repeating sleeper runs alongside, so heartbeats alternate between prescalers.  A one-shot is added every 10s,
+  so Timer1 is restarted through syncClock(), which times each restart from micros()
+
+  Expect a few tens of uS of jitter and no trend.  A steady trend means restarts are leaking time again - see
+  Wakeup/host/DriftTest.cpp, which also replays this without the 7ms sleeper, where every heartbeat is a restart.
+  v1.1 drifted by several seconds a day under the same load.
+  Results are printed to Serial at 9600 baud
+
+
+**************************/
+
+
+
+#include "Wakeup.h"
+#include "TimerOne.h"
+
+volatile unsigned long lastMicros;
+volatile long driftUs;                   // Cumulative - each wake adds its error against 1000ms
+volatile unsigned long wakes;
+
+void sleeperSecond(void *context) {
+  unsigned long now = micros();
+
+  if (wakes++ > 0) driftUs += (long)(now - lastMicros) - 1000000L;     // Deltas, so micros() wrapping every 71 mins is harmless
+  lastMicros = now;
+}
+
+void sleeperNull(void *context) {
+}
+
+void setup(void) {
+  Serial.begin(9600);
+
+  wakeup.init();
+  wakeup.wakeMeAfter(sleeperSecond, 1000, NULL, TREAT_AS_ISR | REPEAT_COUNT);
+  wakeup.wakeMeAfter(sleeperNull, 7, NULL, TREAT_AS_ISR | REPEAT_COUNT);
+
+  Serial.println("Minutes\tWakes\tDrift uS");
+}
+
+void loop() {
+  static unsigned long lastAdd = 0;
+  static unsigned long lastPrint = 0;
+
+  if (millis() - lastAdd >= 10000) {
+    lastAdd = millis();
+    wakeup.wakeMeAfter(sleeperNull, 1234, NULL, TREAT_AS_ISR);
+  }
+
+  if (millis() - lastPrint >= 60000) {
+    lastPrint = millis();
+    noInterrupts();
+    unsigned long w = wakes;
+    long d = driftUs;
+    interrupts();
+
+    Serial.print(lastPrint / 60000);
+    Serial.print("\t");
+    Serial.print(w);
+    Serial.print("\t");
+    Serial.println(d);
+  }
+}
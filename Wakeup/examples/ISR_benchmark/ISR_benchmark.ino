@@ -0,0 +1,125 @@
+/* Benchmark of WAKEUP::timerISR() cost against number of sleepers
+
+  Compares the v1.1 core (every bunk decremented on every heartbeat) with the v1.2 heap core
+  (only sleepers that are due are touched).  Timer3 runs unprescaled as a cycle counter, so
+  results are in CPU cycles (16 per uS on a Mega).  Interrupts are off while measuring.
+
+  - Legacy column re-creates the v1.1 bunk walk on a private array of the same layout; one sleeper
+    due per heartbeat, the rest counting down
+  - Heap column calls wakeup.timerISR() directly with the same mix: one repeating 10ms sleeper
+    due, the rest sleeping for 10s
+
+  Sleeper counts above MAXSLEEPERS are skipped - raise WAKEUP_SLEEPERS (HA_globals.h) to see the full table.
+  Results are printed to Serial at 9600 baud
+
+
+**************************/
+
+
+
+#include "Wakeup.h"
+#include "TimerOne.h"
+
+static const int COUNTS[] = { 1, 8, 16, 32, 64, 128 };
+static const byte NUM_COUNTS = sizeof(COUNTS) / sizeof(COUNTS[0]);
+static const byte REPEATS = 16;                 // Heartbeats averaged per measurement
+static const unsigned long HEARTBEAT = 10;      // ms
+
+// ********** Copy of v1.1 bunk layout, walk and heartbeat restart - no queueing  **********
+
+struct legacyBunk {
+  void (*callback)(void*);
+  void *context;
+  byte flags;
+  unsigned long sleepDuration;
+  unsigned long timeToWake;
+} volatile legacyBunks[128];
+
+void legacyNull() {
+}
+
+void legacyISR(int numSleepers, unsigned long heartbeat) {
+  for (int i = 0; i < numSleepers; i++) {
+    if (legacyBunks[i].timeToWake < MAXHEARTBEAT) {
+      long timeToWake = (long)(legacyBunks[i].timeToWake) - heartbeat;
+      legacyBunks[i].timeToWake -= heartbeat;
+      if (timeToWake <= 0) legacyBunks[i].timeToWake = legacyBunks[i].sleepDuration;
+    }
+    else legacyBunks[i].timeToWake -= heartbeat;
+  }
+
+  // v1.1 startHeartbeat() walked the bunks again to find the lightest sleeper
+  heartbeat = MAXHEARTBEAT;
+  for (int i = 0; i < numSleepers; i++) {
+    if (legacyBunks[i].timeToWake > 0 && legacyBunks[i].timeToWake < heartbeat) heartbeat = legacyBunks[i].timeToWake;
+  }
+  Timer1.start();
+  Timer1.attachInterrupt(legacyNull, heartbeat * 1000 - (numSleepers * CODEOVERHEAD));
+}
+
+// ********** Cycle counter **********
+
+void startCycles() {
+  TCCR3A = 0;
+  TCCR3B = _BV(CS30);       // No prescale
+  TCNT3 = 0;
+}
+
+unsigned int readCycles() {
+  return TCNT3;
+}
+
+void sleeperNull(void *context) {
+}
+
+unsigned long timeLegacy(int numSleepers) {
+  unsigned long total = 0;
+
+  legacyBunks[0].sleepDuration = legacyBunks[0].timeToWake = HEARTBEAT;
+  for (int i = 1; i < numSleepers; i++) legacyBunks[i].sleepDuration = legacyBunks[i].timeToWake = 10000;
+
+  for (int r = 0; r < REPEATS; r++) {
+    noInterrupts();
+    startCycles();
+    legacyISR(numSleepers, HEARTBEAT);
+    total += readCycles();
+    interrupts();
+  }
+  Timer1.stop();
+  return total / REPEATS;
+}
+
+unsigned long timeHeap(int numSleepers) {
+  unsigned long total = 0;
+
+  wakeup.init();
+  wakeup.wakeMeAfter(sleeperNull, HEARTBEAT, NULL, TREAT_AS_ISR | REPEAT_COUNT);
+  for (int i = 1; i < numSleepers; i++) wakeup.wakeMeAfter(sleeperNull, 10000, NULL, TREAT_AS_ISR);
+
+  for (int r = 0; r < REPEATS; r++) {
+    noInterrupts();
+    startCycles();
+    wakeup.timerISR();
+    total += readCycles();
+    interrupts();
+  }
+  Timer1.stop();
+  return total / REPEATS;
+}
+
+void setup(void) {
+  Serial.begin(9600);
+
+  Serial.println("Sleepers\tLegacy cycles\tHeap cycles");
+  for (int i = 0; i < NUM_COUNTS; i++) {
+    if (COUNTS[i] > MAXSLEEPERS) break;
+    Serial.print(COUNTS[i]);
+    Serial.print("\t\t");
+    Serial.print(timeLegacy(COUNTS[i]));
+    Serial.print("\t\t");
+    Serial.println(timeHeap(COUNTS[i]));
+  }
+}
+
+void loop() {
+}
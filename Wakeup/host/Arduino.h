@@ -0,0 +1,58 @@
+ /*
+	*****************  WAKEUP host build  **********************
+
+	Minimal stand-in for the Arduino core, so Wakeup.cpp can be compiled and run on a PC against the virtual
+	Timer1 in WakeupHost.h.  Only what WAKEUP itself uses is here.  Kept in host/ so the Arduino IDE never sees it
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define B00000001 1
+#define B00000010 2
+#define B00000100 4
+#define B00001000 8
+#define B00001100 12
+#define B00010000 16
+#define B00011100 28
+#define B00100000 32
+#define B01000000 64
+#define B01100000 96
+#define B10000000 128
+
+// Single threaded - interrupts only ever 'happen' inside hostTimer.advance(), and only if the I bit is set
+static const byte SREG_I = 0x80;
+extern byte SREG;
+inline void cli() { SREG &= ~SREG_I; }
+inline void sei() { SREG |= SREG_I; }
+inline void noInterrupts() { cli(); }
+inline void interrupts() { sei(); }
+
+unsigned long micros();								// Simulated clock, see WakeupHost.h
+unsigned long millis();
+
+#endif
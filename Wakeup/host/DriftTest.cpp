@@ -0,0 +1,119 @@
+ /*
+	*****************  WAKEUP host build  **********************
+
+	Description
+	-----------
+
+	examples/Drift replayed against the virtual Timer1, for DAYS days of each of two schedules:
+		- mixed: a 1000ms repeating sleeper with a 7ms one alongside, so heartbeats keep changing prescaler, and a
+		  one-shot added every 10s.  Mostly the adjustPeriod path, with a restart at each one-shot
+		- restarts: the 1000ms sleeper and the one-shot every 10s alone, so heartbeats of 1000ms and of what is left
+		  before the one-shot need different prescalers and Timer1 is restarted in timerISR every time
+	Each wake's offset from the 1000ms grid started by the first is measured in simulated CPU cycles, so there is no
+	crystal or Serial to allow for, and the result is the same every run.
+
+	Fails (exit 1) if the least squares slope of the offset against time is more than SLOPE_LIMIT_US a day either
+	way - drift, however small, that a longer run would only make bigger - or if any wake is more than
+	OFFSET_LIMIT_US off the grid, or if a wake or an overflow is lost.  v1.1 drifted by several seconds a day under
+	this load, and adding Timer1 readings up across restarts about 100ms a day on the restarts schedule.  From the
+	repository root:
+
+		g++ -DWAKEUP_HOST -IWakeup/host -IWakeup Wakeup/host/DriftTest.cpp Wakeup/Wakeup.cpp Wakeup/host/WakeupHost.cpp -o drifttest
+		./drifttest
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Wakeup.h"
+#include "WakeupHost.h"
+
+static const unsigned long DAYS = 3;
+static const long long CYCLES_PER_SECOND = 16000000LL;
+static const double SLOPE_LIMIT_US = 5.0;						// A day, either way
+static const long OFFSET_LIMIT_US = 300;						// Any wake from the grid - within a couple of Timer1 ticks, and no trend
+
+long long offsetCycles;															// This wake's distance from the grid started by the first
+long long worstCycles;
+unsigned long long firstCycles;
+unsigned long wakes;
+double sumT, sumOff, sumTT, sumTOff;								// For the least squares slope - t in days, offset in uS
+
+void sleeperSecond(void *context) {
+	unsigned long long now = hostTimer.cycles();
+
+	if (wakes == 0) firstCycles = now;
+	offsetCycles = (long long)(now - firstCycles) - (long long)wakes * CYCLES_PER_SECOND;
+	if (llabs(offsetCycles) > worstCycles) worstCycles = llabs(offsetCycles);
+
+	double t = wakes / 86400.0, off = offsetCycles / 16.0;
+	sumT += t;
+	sumOff += off;
+	sumTT += t * t;
+	sumTOff += t * off;
+	wakes++;
+}
+
+void sleeperNull(void *context) {
+}
+
+int replay(const char *name, boolean companion) {
+	int fails = 0;
+
+	hostTimer.initialize();
+	wakeup.init();
+	offsetCycles = worstCycles = 0;
+	wakes = 0;
+	sumT = sumOff = sumTT = sumTOff = 0;
+	wakeup.wakeMeAfter(sleeperSecond, 1000, NULL, TREAT_AS_ISR | REPEAT_COUNT);
+	if (companion) wakeup.wakeMeAfter(sleeperNull, 7, NULL, TREAT_AS_ISR | REPEAT_COUNT);
+
+	for (unsigned long s = 0; s < DAYS * 86400; s += 10) {
+		hostTimer.advance(10000000UL);
+		wakeup.wakeMeAfter(sleeperNull, 1234, NULL, TREAT_AS_ISR);
+		if (s % 43200 == 0) printf("%-8s %3luh  offset %8.3f ms\n", name, s / 3600, offsetCycles / 16000.0);
+	}
+
+	double slope = (wakes * sumTOff - sumT * sumOff) / (wakes * sumTT - sumT * sumT);
+	printf("%-8s %lu days: %lu wakes, slope %.3f us/day, offset %.3f ms (worst %.3f ms), %lu timerISR runs, %lu overflows lost\n",
+		name, DAYS, wakes, slope, offsetCycles / 16000.0, worstCycles / 16000.0, hostTimer.isrCount, hostTimer.overflowsLost);
+
+	if (wakes != DAYS * 86400) {
+		printf("FAIL: %s: %lu wakes of the 1000ms sleeper, expected %lu\n", name, wakes, DAYS * 86400);
+		fails++;
+	}
+	if (slope > SLOPE_LIMIT_US || slope < -SLOPE_LIMIT_US) {
+		printf("FAIL: %s: drifting %.3f us a day, limit %.3f\n", name, slope, SLOPE_LIMIT_US);
+		fails++;
+	}
+	if (worstCycles > OFFSET_LIMIT_US * 16LL) {
+		printf("FAIL: %s: a wake was %.3f ms off the grid, limit %.3f ms\n", name, worstCycles / 16000.0, OFFSET_LIMIT_US / 1000.0);
+		fails++;
+	}
+	if (hostTimer.overflowsLost != 0 || wakeup.pendingOverflows() != 0) {
+		printf("FAIL: %s: %lu overflows lost, %u wakes dropped\n", name, hostTimer.overflowsLost, wakeup.pendingOverflows());
+		fails++;
+	}
+	return fails;
+}
+
+int main() {
+	int fails = replay("mixed", true) + replay("restarts", false);
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+ /*
+	*****************  WAKEUP host build  **********************
+
+	Virtual Timer1 - see WakeupHost.h
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "WakeupHost.h"
+
+static const unsigned long CYCLES_PER_US = 16;			// 16MHz Mega
+static const long RESOLUTION = 65536;								// Timer1 is 16 bit
+
+byte SREG = SREG_I;
+VirtualTimer hostTimer;
+
+unsigned long micros() {
+	return (unsigned long)(hostTimer.cycles() / CYCLES_PER_US);
+}
+
+unsigned long millis() {
+	return (unsigned long)(hostTimer.cycles() / (CYCLES_PER_US * 1000));
+}
+
+void VirtualTimer::initialize(long microseconds) {
+	_cycles = _bottom = 0;
+	_held = false;
+	_isr = 0;
+	isrLatency = 32;
+	overflowsLost = isrCount = 0;
+	setPeriod(microseconds);													// As on the chip, this starts the counter (interrupt not yet enabled)
+}
+
+void VirtualTimer::setPeriod(long microseconds) {			// Same prescaler choice and rounding as TimerOne::scaleFor()
+	unsigned char oldScale = _scale;
+	unsigned long t = ticks();
+	long cycles = (CYCLES_PER_US / 2) * microseconds;
+
+	if (cycles < RESOLUTION)              _scale = 0;
+	else if ((cycles >>= 3) < RESOLUTION) _scale = 3;
+	else if ((cycles >>= 3) < RESOLUTION) _scale = 6;
+	else if ((cycles >>= 2) < RESOLUTION) _scale = 8;
+	else if ((cycles >>= 2) < RESOLUTION) _scale = 10;
+	else        cycles = RESOLUTION - 1, _scale = 10;
+
+	_pwmPeriod = cycles;
+	if (_scale != oldScale) _bottom = _cycles - ((unsigned long long)t << _scale);		// Count carries on, now at the new prescale
+	_running = true;
+}
+
+bool VirtualTimer::adjustPeriod(long microseconds) {
+	unsigned char oldScale = _scale;
+	unsigned int oldPeriod = _pwmPeriod;
+	unsigned long t = ticks();
+
+	setPeriod(microseconds);
+	if (_scale == oldScale && t < _pwmPeriod) return true;
+
+	if (_scale != oldScale) _bottom = _cycles - ((unsigned long long)t << oldScale);		// Prescaler change, or count already past new TOP - leave as was
+	_scale = oldScale;
+	_pwmPeriod = oldPeriod;
+	return false;
+}
+
+unsigned long VirtualTimer::getPeriod() {
+	return ((unsigned long)_pwmPeriod << (_scale + 1)) / CYCLES_PER_US;
+}
+
+void VirtualTimer::start() {
+	_bottom = _cycles - (1ULL << _scale);							// TimerOne::start() sets TCNT1 to 1, and clears the overflow flag
+	_held = false;
+	_running = true;
+}
+
+void VirtualTimer::stop() {
+	_running = false;
+}
+
+void VirtualTimer::attachInterrupt(void (*isr)(), long microseconds) {
+	if (microseconds > 0) setPeriod(microseconds);
+	_isr = isr;
+	_running = true;
+}
+
+void VirtualTimer::detachInterrupt() {
+	_isr = 0;
+}
+
+unsigned long VirtualTimer::read() {								// Waits for the next tick, as TimerOne::read() does
+	unsigned long t = ticks();
+
+	_cycles = _bottom + ((unsigned long long)(t + 1) << _scale);
+	return ((unsigned long long)t << _scale) / CYCLES_PER_US;
+}
+
+bool VirtualTimer::overflowPending() {
+	latch();																					// read() may have moved time on
+	return _held;
+}
+
+void VirtualTimer::advance(unsigned long us) {
+	runTo(_cycles + (unsigned long long)us * CYCLES_PER_US);
+}
+
+void VirtualTimer::busy(unsigned long us) {
+	byte oldSREG = SREG;
+	cli();
+	advance(us);
+	SREG = oldSREG;
+	advance(0);																				// Interrupts back on (unless in an ISR) - take any overflow held meanwhile
+}
+
+unsigned long long VirtualTimer::cycles() {
+	return _cycles;
+}
+
+void VirtualTimer::runTo(unsigned long long until) {
+	for (;;) {
+		latch();
+
+		if (_held && _isr && (SREG & SREG_I)) {					// As the chip - flag cleared and interrupts disabled on entry, enabled again by reti
+			_held = false;
+			_cycles += isrLatency;
+			isrCount++;
+			cli();
+			_isr();
+			sei();
+			continue;																			// ISR took time, so more may have passed
+		}
+
+		if (_cycles >= until) return;
+		unsigned long long next = _running ? _bottom + periodCycles() : until;
+		_cycles = (next < until) ? next : until;
+	}
+}
+
+void VirtualTimer::latch() {						// Set the flag for every BOTTOM passed.  Only one flag, so a second before the first is serviced is lost
+	while (_running && _bottom + periodCycles() <= _cycles) {
+		_bottom += periodCycles();
+		if (_held) overflowsLost++; else _held = true;
+	}
+}
+
+unsigned long VirtualTimer::ticks() {
+	return _running ? (unsigned long)((_cycles - _bottom) >> _scale) : 0;
+}
+
+unsigned long long VirtualTimer::periodCycles() {
+	return (unsigned long long)_pwmPeriod << (_scale + 1);		// Up to TOP and back down
+}
@@ -0,0 +1,94 @@
+ /*
+	*****************  WAKEUP host build  **********************
+
+	Description
+	-----------
+
+	Virtual Timer1 for running WAKEUP on a PC.  Simulated time is held in CPU cycles of a 16MHz Mega, and the
+	timer copies TimerOne in phase & frequency correct mode - same prescaler choice and rounding in setPeriod(),
+	same adjustPeriod() rules, read() waits for the next tick - so the drift and catch-up behaviour seen on the
+	host is the behaviour on the board.  Nothing happens until the test program moves time on, so a whole day
+	of heartbeats replays in well under a second and every run is the same
+
+	Build with WAKEUP_HOST defined and host/ ahead of the Arduino core on the include path, eg:
+
+		g++ -DWAKEUP_HOST -IWakeup/host -IWakeup mytest.cpp Wakeup/Wakeup.cpp Wakeup/host/WakeupHost.cpp
+
+	then from the test program:
+		- hostTimer.advance(us)      move time on, running timerISR at every overflow that falls due.  With interrupts
+		                             disabled (cli, noInterrupts) overflows are held, and only one is taken once they
+		                             are enabled and time next moves (as on the chip, which has one overflow flag)
+		- hostTimer.busy(us)         move time on with interrupts disabled, then enable them again
+		- hostTimer.isrLatency       cycles from overflow to timerISR starting (default 32, interrupt entry)
+		- hostTimer.overflowsLost    overflows that arrived while one was already held
+		- micros(), millis()         simulated time, as Arduino
+
+	A sleeper can call advance() or busy() to model its own run time.  Interrupts are disabled while timerISR
+	runs, so from a TREAT_AS_ISR sleeper both just hold any overflow, as interrupts don't nest
+
+	WakeupTest.cpp is the regression suite and DriftTest.cpp replays examples/Drift, and a schedule of nothing but
+	restarts, for three days; each exits 1 on failure.  Run both after any change to Wakeup.cpp
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WakeupHost_h
+#define WakeupHost_h
+
+#include "Arduino.h"
+
+class VirtualTimer {
+public:
+	// As TimerOne
+	void initialize(long microseconds = 1000000);
+	void setPeriod(long microseconds);
+	bool adjustPeriod(long microseconds);
+	unsigned long getPeriod();
+	void start();
+	void stop();
+	void attachInterrupt(void (*isr)(), long microseconds = -1);
+	void detachInterrupt();
+	unsigned long read();
+	bool overflowPending();
+
+	// Host side
+	void advance(unsigned long us);					// Move time on, taking interrupts as they fall due
+	void busy(unsigned long us);						// Move time on with interrupts disabled
+	unsigned long long cycles();						// Simulated time since start
+
+	unsigned int isrLatency;								// Cycles from overflow to ISR
+	unsigned long overflowsLost;						// Overflows that found one already held
+	unsigned long isrCount;									// Interrupts taken
+
+private:
+	void runTo(unsigned long long until);
+	void latch();														// Note overflows passed
+	unsigned long ticks();									// Prescaled ticks since last BOTTOM
+	unsigned long long periodCycles();			// Cycles from BOTTOM to BOTTOM
+
+	unsigned long long _cycles;							// Simulated time
+	unsigned long long _bottom;							// Cycle count at last BOTTOM, or at start()
+	unsigned int _pwmPeriod;								// TOP, as ICR1
+	unsigned char _scale;										// Prescaler as shift, 0 3 6 8 10
+	boolean _running;
+	boolean _held;													// Overflow flag set but not yet serviced
+	void (*_isr)();
+};
+
+extern VirtualTimer hostTimer;
+
+#endif
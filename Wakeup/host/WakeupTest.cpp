@@ -0,0 +1,264 @@
+ /*
+	*****************  WAKEUP host build  **********************
+
+	Description
+	-----------
+
+	Regression suite for WAKEUP, run against the virtual Timer1.  Each case prints FAIL with the file and line and
+	what was seen, and the program exits 1 if any failed:
+
+		- adjustDelay units: a delay in each of ms, seconds, minutes, hours and days, up to MAX_SECONDS, MAX_MINUTES,
+		  MAX_HOURS and MAX_DAYS, wakes when it should; one more than each maximum is refused
+		- MAX_DAYS range: a daily and a 1s repeating sleeper for 60 days, across the WAKEUP clock wrapping at 49.7
+		  days - every wake happens and the daily one is still on its grid at the end
+		- catch-up bursts larger than MAXPENDING: more normal sleepers due at once than the ring holds, and
+		  CATCHUP_BURST sleepers owing more missed periods between them than that - the ring takes MAXPENDING, the
+		  rest are counted in pendingOverflows() and nothing else is lost; then each CATCHUP_ policy with timerISR
+		  held off
+		- a sleeper added while an overflow is held doesn't move the phase of a repeating one
+		- a context hook that refuses holds: each refused wake is dropped and counted, and released only if it was held
+
+	From the repository root:
+
+		g++ -DWAKEUP_HOST -IWakeup/host -IWakeup Wakeup/host/WakeupTest.cpp Wakeup/Wakeup.cpp Wakeup/host/WakeupHost.cpp -o wakeuptest
+		./wakeuptest
+
+	Licencing
+	---------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Wakeup.h"
+#include "WakeupHost.h"
+
+#define CHECK(cond, ...) do { if (!(cond)) { fails++; printf("FAIL %s:%d  ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static const double EARLY_MS = 0.1281;							// Two Timer1 ticks at the longest heartbeat - see Wakeup.cpp
+static const byte NUM_MARKS = 16;
+
+int fails;
+unsigned long long firedAt[NUM_MARKS];							// Cycle count of the last wake of each mark
+unsigned long fired[NUM_MARKS];
+
+void mark(void *context) {
+	long i = (long)context;
+
+	firedAt[i] = hostTimer.cycles();
+	fired[i]++;
+}
+
+void hog(void *context) {														// TREAT_AS_ISR sleeper that holds interrupts off for 1.9ms
+	hostTimer.advance(1900);
+}
+
+void reset() {
+	hostTimer.initialize();
+	wakeup.init();
+	memset(firedAt, 0, sizeof(firedAt));
+	memset(fired, 0, sizeof(fired));
+}
+
+double msSince(unsigned long long start, byte i) {
+	return (firedAt[i] - start) / 16000.0;
+}
+
+void advanceMs(unsigned long long ms) {							// advance() takes an unsigned long of uS, so up to 71 minutes at a time
+	unsigned long long us = ms * 1000;
+
+	while (us > 0) {
+		unsigned long step = (us > 4000000000ULL) ? 4000000000UL : (unsigned long)us;
+		hostTimer.advance(step);
+		us -= step;
+	}
+}
+
+void testUnits() {
+	static const struct {
+		unsigned long delay;
+		byte flags;
+		unsigned long long expectMs;
+	} cases[] = {
+		{ 1500,        0,             1500 },
+		{ 3,           UNITS_SECONDS, 3000 },
+		{ 2,           UNITS_MINUTES, 120000 },
+		{ 1,           UNITS_HOURS,   3600000 },
+		{ 1,           UNITS_DAYS,    86400000ULL },
+		{ MAX_SECONDS, UNITS_SECONDS, MAX_SECONDS * 1000ULL },
+		{ MAX_MINUTES, UNITS_MINUTES, MAX_MINUTES * 60000ULL },
+		{ MAX_HOURS,   UNITS_HOURS,   MAX_HOURS * 3600000ULL },
+		{ MAX_DAYS,    UNITS_DAYS,    MAX_DAYS * 86400000ULL }
+	};
+	static const struct {
+		unsigned long delay;
+		byte flags;
+	} tooLong[] = {
+		{ MAX_SECONDS + 1, UNITS_SECONDS },
+		{ MAX_MINUTES + 1, UNITS_MINUTES },
+		{ MAX_HOURS + 1,   UNITS_HOURS },
+		{ MAX_DAYS + 1,    UNITS_DAYS }
+	};
+
+	for (byte i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		reset();
+		unsigned long long start = hostTimer.cycles();
+		CHECK(wakeup.wakeMeAfter(mark, cases[i].delay, (void*)0, TREAT_AS_ISR | cases[i].flags) != NO_WAKEUP, "units case %d refused", i);
+		advanceMs(cases[i].expectMs + 5);
+		double err = msSince(start, 0) - (double)cases[i].expectMs;
+		CHECK(fired[0] == 1 && err >= -EARLY_MS && err < 1.0, "units case %d: fired %lu times, %.3fms off", i, fired[0], err);
+	}
+	for (byte i = 0; i < sizeof(tooLong) / sizeof(tooLong[0]); i++) {
+		reset();
+		CHECK(wakeup.wakeMeAfter(mark, tooLong[i].delay, (void*)0, TREAT_AS_ISR | tooLong[i].flags) == NO_WAKEUP, "out of range case %d accepted", i);
+	}
+}
+
+void testWrap() {
+	reset();
+	unsigned long long start = hostTimer.cycles();
+	wakeup.wakeMeAfter(mark, 1, (void*)1, TREAT_AS_ISR | REPEAT_COUNT | UNITS_DAYS);
+	wakeup.wakeMeAfter(mark, 1000, (void*)2, TREAT_AS_ISR | REPEAT_COUNT);
+	advanceMs(60 * 86400000ULL + 5);
+
+	double err = msSince(start, 1) - 60 * 86400000.0;
+	CHECK(fired[1] == 60, "daily sleeper woke %lu times in 60 days", fired[1]);
+	CHECK(fired[2] == 60 * 86400UL, "1s sleeper woke %lu times in 60 days", fired[2]);
+	CHECK(err >= -EARLY_MS && err < 1.0, "daily sleeper %.3fms off after 60 days", err);
+	printf("60 days: %lu timerISR runs, daily sleeper %.3fms off\n", hostTimer.isrCount, err);
+}
+
+unsigned long totalFired() {
+	unsigned long total = 0;
+
+	for (byte i = 0; i < NUM_MARKS; i++) total += fired[i];
+	return total;
+}
+
+void testBursts() {
+	// More normal sleepers due in one heartbeat than the ring holds
+	reset();
+	for (byte i = 0; i < MAXSLEEPERS; i++) wakeup.wakeMeAfter(mark, 100, (void*)(long)(i % NUM_MARKS), REPEAT_COUNT);
+	hostTimer.advance(150000);
+	unsigned int expectDropped = (MAXSLEEPERS > MAXPENDING) ? MAXSLEEPERS - MAXPENDING : 0;
+	CHECK(wakeup.pendingOverflows() == expectDropped, "%d due at once: %u dropped, expected %u", MAXSLEEPERS, wakeup.pendingOverflows(), expectDropped);
+	wakeup.runAnyPending();
+	CHECK(totalFired() == (unsigned long)(MAXSLEEPERS - expectDropped), "%d due at once: %lu ran", MAXSLEEPERS, totalFired());
+
+	// CATCHUP_BURST sleepers that between them owe more wakes than the ring holds.  There are as many as the ring
+	// holds, all due together.  The main program then holds interrupts off for 4ms while it keeps rescheduling another
+	// sleeper, so the clock catches up in one timerISR that owes each of them at least two wakes - MAXPENDING are
+	// queued, the rest are counted, and all of them carry on along their grid afterwards
+	reset();
+	unsigned long long start = hostTimer.cycles();
+	byte numBurst = (MAXPENDING < MAXSLEEPERS) ? MAXPENDING : MAXSLEEPERS - 1;
+	for (byte i = 0; i < numBurst; i++) wakeup.wakeMeAfter(mark, 2, (void*)(long)(i % NUM_MARKS), REPEAT_COUNT | CATCHUP_BURST);
+	wakeHandle other = wakeup.wakeMeAfter(mark, 5000, (void*)(long)(NUM_MARKS - 1), TREAT_AS_ISR);
+	hostTimer.advance(1900);
+	noInterrupts();
+	for (byte i = 0; i < 80; i++) {
+		hostTimer.advance(50);
+		wakeup.resetWakeup(other);
+	}
+	interrupts();
+	hostTimer.advance(100);
+	unsigned int dropped = wakeup.pendingOverflows();
+	wakeup.runAnyPending();
+	printf("Burst after 4ms held off: %lu queued, %u dropped\n", totalFired(), dropped);
+	CHECK(totalFired() == MAXPENDING && dropped >= numBurst, "burst after 4ms held off: %lu ran and %u dropped, expected %d to run and at least %d dropped", totalFired(), dropped, MAXPENDING, numBurst);
+	while (hostTimer.cycles() - start < 100 * 16000ULL) {
+		hostTimer.advance(500);
+		wakeup.runAnyPending();
+	}
+	unsigned long expect = 50UL * numBurst;							// 100ms of 2ms periods each
+	CHECK(totalFired() - fired[NUM_MARKS - 1] + wakeup.pendingOverflows() == expect, "after burst: %lu ran and %u dropped, expected %lu in all", totalFired(), wakeup.pendingOverflows(), expect);
+	for (byte i = 0; i < numBurst && i < NUM_MARKS; i++) {
+		double err = msSince(start, i) - 100.0;
+		CHECK(err >= -EARLY_MS && err < 1.0, "after burst: sleeper %d %.3fms off grid", i, err);
+	}
+
+	// Each policy with timerISR held off 1.9ms every 10ms - a 2ms sleeper loses no periods
+	static const byte policies[] = { CATCHUP_BURST, CATCHUP_COALESCE, CATCHUP_SKIP };
+	for (byte p = 0; p < sizeof(policies); p++) {
+		reset();
+		wakeup.wakeMeAfter(mark, 2, (void*)4, REPEAT_COUNT | policies[p]);
+		wakeup.wakeMeAfter(hog, 10, (void*)0, TREAT_AS_ISR | REPEAT_COUNT);
+		while (hostTimer.cycles() < 16000000ULL) {
+			hostTimer.advance(1000);
+			wakeup.runAnyPending();
+		}
+		CHECK(fired[4] >= 499 && fired[4] <= 500 && wakeup.pendingOverflows() == 0, "policy %d: 2ms sleeper ran %lu times in 1s, %u dropped", p, fired[4], wakeup.pendingOverflows());
+	}
+}
+
+void testHeldOverflow() {
+	reset();
+	unsigned long long start = hostTimer.cycles();
+	wakeup.wakeMeAfter(mark, 1000, (void*)5, TREAT_AS_ISR | REPEAT_COUNT);
+	hostTimer.advance(2999900);
+	noInterrupts();
+	hostTimer.advance(300);															// Overflow for 3000ms held
+	wakeup.wakeMeAfter(mark, 5000, (void*)6, TREAT_AS_ISR);
+	interrupts();
+	hostTimer.advance(7000000);
+
+	double err = msSince(start, 5) - 10000.0;
+	CHECK(fired[5] == 10 && err >= -EARLY_MS && err < 1.0, "repeat after add: %lu wakes, %.3fms off", fired[5], err);
+	err = msSince(start, 6) - 8000.2;										// First deadline is on the ms grid of the WAKEUP clock, so up to 1ms short
+	CHECK(fired[6] == 1 && err > -1.0 && err < 1.0, "one-shot added with overflow held: %lu wakes, %.3fms off", fired[6], err);
+}
+
+// References to one context, kept as the HA switcher keeps them - but holds are refused at HOLD_CAP, not 0xFF
+static const byte HOLD_CAP = 4;
+int refs, badReleases;
+
+boolean countRefs(void (*sleeper)(void*), void *context, boolean hold) {
+	if (hold) {
+		if (refs >= HOLD_CAP) return false;
+		refs++;
+		return true;
+	}
+	if (refs == 0) badReleases++;
+	else refs--;
+	return true;
+}
+
+void testRefusedHolds() {
+	reset();
+	wakeup.setContextHook(countRefs);
+	refs = 3;																						// Each sleeper's own, handed over by wakeMeAfter
+	badReleases = 0;
+	for (byte i = 0; i < 3; i++) wakeup.wakeMeAfter(mark, 100, (void*)7, REPEAT_COUNT);
+
+	for (byte tick = 0; tick < 10; tick++) {						// All three due together, room for only one more hold
+		advanceMs(100);
+		CHECK(refs == HOLD_CAP, "tick %d: %d refs with wakes queued", tick, refs);
+		wakeup.runAnyPending();
+	}
+	CHECK(fired[7] == 10 && wakeup.pendingOverflows() == 20, "%lu wakes run, %u dropped - expected 10 and 20", fired[7], wakeup.pendingOverflows());
+	for (byte i = 0; i < 3; i++) wakeup.cancelWakeup(mark, 100, (void*)7, REPEAT_COUNT);
+	CHECK(refs == 0 && badReleases == 0, "%d refs left, %d releases of holds never granted", refs, badReleases);
+	wakeup.setContextHook(NULL);
+}
+
+int main() {
+	testUnits();
+	testWrap();
+	testBursts();
+	testHeldOverflow();
+	testRefusedHolds();
+
+	printf("%s (%d failures)\n", fails ? "FAILED" : "PASSED", fails);
+	return fails ? 1 : 0;
+}